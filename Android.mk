@@ -55,6 +55,7 @@ LOCAL_SRC_FILES_x86_64 += \
 LOCAL_SRC_FILES += \
     base/at_exit.cc \
     base/base64.cc \
+    base/cpu.cc \
     base/environment.cc \
     base/file_descriptor_shuffle.cc \
     base/file_path.cc \
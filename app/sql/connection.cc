@@ -8,7 +8,9 @@
 
 #include "app/sql/statement.h"
 #include "base/file_path.h"
+#include "base/format_macros.h"
 #include "base/logging.h"
+#include "base/metrics/histogram.h"
 #include "base/string_util.h"
 #include "base/utf_string_conversions.h"
 #ifdef ANDROID
@@ -90,6 +92,11 @@ Connection::Connection()
       page_size_(0),
       cache_size_(0),
       exclusive_locking_(false),
+      write_ahead_logging_(false),
+      mmap_size_(0),
+      statement_cache_size_(kDefaultStatementCacheSize),
+      statement_cache_hits_(0),
+      statement_cache_misses_(0),
       transaction_nesting_(0),
       needs_rollback_(false) {
 }
@@ -110,8 +117,16 @@ bool Connection::OpenInMemory() {
   return OpenInternal(":memory:");
 }
 
+void Connection::set_statement_cache_size(size_t statement_cache_size) {
+  statement_cache_size_ = statement_cache_size;
+  if (statement_cache_size_)
+    ShrinkCacheToSize(statement_cache_size_);
+}
+
 void Connection::Close() {
+  RecordCacheMetrics();
   statement_cache_.clear();
+  statement_lru_.clear();
   DCHECK(open_statements_.empty());
   if (db_) {
     sqlite3_close(db_);
@@ -230,14 +245,18 @@ scoped_refptr<Connection::StatementRef> Connection::GetCachedStatement(
     // one invalidating cached statements, and we'll remove it from the cache
     // if we do that. Make sure we reset it before giving out the cached one in
     // case it still has some stuff bound.
-    DCHECK(i->second->is_valid());
-    sqlite3_reset(i->second->stmt());
-    return i->second;
+    DCHECK(i->second.ref->is_valid());
+    statement_cache_hits_++;
+    statement_lru_.splice(statement_lru_.begin(), statement_lru_,
+                          i->second.lru_position);
+    sqlite3_reset(i->second.ref->stmt());
+    return i->second.ref;
   }
 
+  statement_cache_misses_++;
   scoped_refptr<StatementRef> statement = GetUniqueStatement(sql);
   if (statement->is_valid())
-    statement_cache_[id] = statement;  // Only cache valid statements.
+    AddToCache(id, statement);  // Only cache valid statements.
   return statement;
 }
 
@@ -379,6 +398,22 @@ bool Connection::OpenInternal(const std::string& file_name) {
       NOTREACHED() << "Could not set cache size: " << GetErrorMessage();
   }
 
+  if (write_ahead_logging_) {
+    // In-memory databases silently keep their "memory" journal, which is
+    // fine.
+    if (!ExecuteWithTimeout("PRAGMA journal_mode=WAL", kBusyTimeout))
+      NOTREACHED() << "Could not set journal mode: " << GetErrorMessage();
+  }
+
+  if (mmap_size_ != 0) {
+    // Older versions of sqlite ignore unknown pragmas, so this can't fail
+    // just because memory-mapped I/O isn't supported.
+    const std::string sql =
+        StringPrintf("PRAGMA mmap_size=%" PRId64, mmap_size_);
+    if (!ExecuteWithTimeout(sql.c_str(), kBusyTimeout))
+      NOTREACHED() << "Could not set mmap size: " << GetErrorMessage();
+  }
+
   return true;
 }
 
@@ -403,6 +438,7 @@ void Connection::StatementRefDeleted(StatementRef* ref) {
 
 void Connection::ClearCache() {
   statement_cache_.clear();
+  statement_lru_.clear();
 
   // The cache clear will get most statements. There may be still be references
   // to some statements that are held by others (including one-shot statements).
@@ -412,6 +448,39 @@ void Connection::ClearCache() {
     (*i)->Close();
 }
 
+void Connection::AddToCache(const StatementID& id,
+                            const scoped_refptr<StatementRef>& statement) {
+  DCHECK(statement_cache_.find(id) == statement_cache_.end());
+  statement_lru_.push_front(id);
+  CachedStatement& entry = statement_cache_[id];
+  entry.ref = statement;
+  entry.lru_position = statement_lru_.begin();
+  if (statement_cache_size_)
+    ShrinkCacheToSize(statement_cache_size_);
+}
+
+void Connection::ShrinkCacheToSize(size_t max_size) {
+  // Statements still held by a sql::Statement stay valid after eviction; the
+  // cache only drops its own reference.
+  while (statement_lru_.size() > max_size) {
+    statement_cache_.erase(statement_lru_.back());
+    statement_lru_.pop_back();
+  }
+}
+
+void Connection::RecordCacheMetrics() {
+  int lookups = statement_cache_hits_ + statement_cache_misses_;
+  if (!lookups)
+    return;
+  UMA_HISTOGRAM_PERCENTAGE("Sqlite.StatementCacheHitRate",
+                           static_cast<int>(
+                               statement_cache_hits_ * 100LL / lookups));
+  UMA_HISTOGRAM_COUNTS_10000("Sqlite.StatementCacheSize",
+                             static_cast<int>(statement_cache_.size()));
+  statement_cache_hits_ = 0;
+  statement_cache_misses_ = 0;
+}
+
 int Connection::OnSqliteError(int err, sql::Statement *stmt) {
   if (error_delegate_.get())
     return error_delegate_->OnError(err, this, stmt);
@@ -6,6 +6,7 @@
 #define APP_SQL_CONNECTION_H_
 #pragma once
 
+#include <list>
 #include <map>
 #include <set>
 #include <string>
@@ -109,6 +110,11 @@ class Connection {
   Connection();
   ~Connection();
 
+  // Default bound on the number of cached statements. This is well above the
+  // number of distinct statements any of our databases runs in a session, so
+  // it only kicks in for code that generates many statement IDs.
+  static const size_t kDefaultStatementCacheSize = 256;
+
   // Pre-init configuration ----------------------------------------------------
 
   // Sets the page size that will be used when creating a new database. This
@@ -137,6 +143,29 @@ class Connection {
   // This must be called before Open() to have an effect.
   void set_exclusive_locking() { exclusive_locking_ = true; }
 
+  // Call to switch the database to write-ahead logging. Writers append to a
+  // separate -wal file instead of rewriting pages through a rollback journal,
+  // so commits need fewer fsyncs and readers are not blocked by a writer. The
+  // journal mode is persistent in the database file, and has no effect on
+  // in-memory databases.
+  //
+  // This must be called before Open() to have an effect.
+  void set_write_ahead_logging() { write_ahead_logging_ = true; }
+
+  // Sets the number of bytes of the database file that sqlite may access
+  // through a memory mapping instead of read() calls. Zero (the default) leaves
+  // the sqlite default alone. Versions of sqlite without memory-mapped I/O
+  // ignore this.
+  //
+  // This must be called before Open() to have an effect.
+  void set_mmap_size(int64 mmap_size) { mmap_size_ = mmap_size; }
+
+  // Sets the maximum number of statements kept by GetCachedStatement(). When
+  // the cache is full, the least recently used statement is finalized to make
+  // room. Zero means no limit. Can be called at any time; the default is
+  // kDefaultStatementCacheSize.
+  void set_statement_cache_size(size_t statement_cache_size);
+
   // Sets the object that will handle errors. Recomended that it should be set
   // before calling Open(). If not set, the default is to ignore errors on
   // release and assert on debug builds.
@@ -235,6 +264,12 @@ class Connection {
   scoped_refptr<StatementRef> GetCachedStatement(const StatementID& id,
                                                  const char* sql);
 
+  // Returns the number of GetCachedStatement() calls that found a compiled
+  // statement in the cache, and the number that had to compile one. These are
+  // reported to UMA and reset when the connection is closed.
+  int statement_cache_hits() const { return statement_cache_hits_; }
+  int statement_cache_misses() const { return statement_cache_misses_; }
+
   // Returns a non-cached statement for the given SQL. Use this for SQL that
   // is only executed once or only rarely (there is overhead associated with
   // keeping a statement cached).
@@ -338,6 +373,17 @@ class Connection {
   // Frees all cached statements from statement_cache_.
   void ClearCache();
 
+  // Adds |statement| to the cache as the most recently used entry, evicting
+  // the least recently used entries beyond |statement_cache_size_|.
+  void AddToCache(const StatementID& id,
+                  const scoped_refptr<StatementRef>& statement);
+
+  // Drops least recently used statements until at most |max_size| remain.
+  void ShrinkCacheToSize(size_t max_size);
+
+  // Reports the statement cache hit rate of this connection to UMA.
+  void RecordCacheMetrics();
+
   // Called by Statement objects when an sqlite function returns an error.
   // The return value is the error code reflected back to client code.
   int OnSqliteError(int err, Statement* stmt);
@@ -354,12 +400,27 @@ class Connection {
   int page_size_;
   int cache_size_;
   bool exclusive_locking_;
+  bool write_ahead_logging_;
+  int64 mmap_size_;
 
   // All cached statements. Keeping a reference to these statements means that
-  // they'll remain active.
-  typedef std::map<StatementID, scoped_refptr<StatementRef> >
-      CachedStatementMap;
+  // they'll remain active. Each entry also knows its position in
+  // |statement_lru_|, which is ordered from most to least recently used.
+  typedef std::list<StatementID> StatementLRUList;
+  struct CachedStatement {
+    scoped_refptr<StatementRef> ref;
+    StatementLRUList::iterator lru_position;
+  };
+  typedef std::map<StatementID, CachedStatement> CachedStatementMap;
   CachedStatementMap statement_cache_;
+  StatementLRUList statement_lru_;
+
+  // Maximum number of entries in |statement_cache_|, zero for no limit.
+  size_t statement_cache_size_;
+
+  // See statement_cache_hits() and statement_cache_misses().
+  int statement_cache_hits_;
+  int statement_cache_misses_;
 
   // A list of all StatementRefs we've given out. Each ref must register with
   // us when it's created or destroyed. This allows us to potentially close
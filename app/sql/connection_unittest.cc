@@ -4,8 +4,11 @@
 
 #include "app/sql/connection.h"
 #include "app/sql/statement.h"
+#include "app/sql/transaction.h"
 #include "base/file_util.h"
+#include "base/logging.h"
 #include "base/memory/scoped_temp_dir.h"
+#include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "third_party/sqlite/sqlite3.h"
 
@@ -24,6 +27,10 @@ class SQLConnectionTest : public testing::Test {
 
   sql::Connection& db() { return db_; }
 
+  FilePath GetPath(const char* name) {
+    return temp_dir_.path().AppendASCII(name);
+  }
+
  private:
   ScopedTempDir temp_dir_;
   sql::Connection db_;
@@ -104,3 +111,122 @@ TEST_F(SQLConnectionTest, GetLastInsertRowId) {
   EXPECT_EQ(12, s.ColumnInt(0));
 }
 
+
+TEST_F(SQLConnectionTest, StatementCacheLRU) {
+  // Custom statement IDs need static names.
+  sql::StatementID id1("id1");
+  sql::StatementID id2("id2");
+  sql::StatementID id3("id3");
+
+  ASSERT_TRUE(db().Execute("CREATE TABLE foo (a, b)"));
+  db().set_statement_cache_size(2);
+  int hits = db().statement_cache_hits();
+  int misses = db().statement_cache_misses();
+
+  ASSERT_TRUE(db().GetCachedStatement(id1, "SELECT a FROM foo")->is_valid());
+  ASSERT_TRUE(db().GetCachedStatement(id2, "SELECT b FROM foo")->is_valid());
+  EXPECT_EQ(misses + 2, db().statement_cache_misses());
+
+  // Using |id1| again makes |id2| the least recently used statement, so it
+  // gets evicted to make room for |id3|.
+  ASSERT_TRUE(db().GetCachedStatement(id1, "SELECT a FROM foo")->is_valid());
+  EXPECT_EQ(hits + 1, db().statement_cache_hits());
+  ASSERT_TRUE(db().GetCachedStatement(id3, "SELECT a, b FROM foo")->is_valid());
+  EXPECT_TRUE(db().HasCachedStatement(id1));
+  EXPECT_FALSE(db().HasCachedStatement(id2));
+  EXPECT_TRUE(db().HasCachedStatement(id3));
+
+  // Invalid statements are not cached, and don't evict anything.
+  EXPECT_FALSE(db().GetCachedStatement(id2, "SELECT c FROM")->is_valid());
+  EXPECT_TRUE(db().HasCachedStatement(id1));
+  EXPECT_TRUE(db().HasCachedStatement(id3));
+
+  // A statement still in use stays valid after being evicted.
+  {
+    sql::Statement s(db().GetCachedStatement(id1, "SELECT a FROM foo"));
+    db().set_statement_cache_size(1);
+    EXPECT_FALSE(db().HasCachedStatement(id3));
+    EXPECT_TRUE(db().HasCachedStatement(id1));
+    db().set_statement_cache_size(0);
+    ASSERT_TRUE(db().GetCachedStatement(id2, "SELECT b FROM foo")->is_valid());
+    ASSERT_TRUE(db().GetCachedStatement(id3, "SELECT b FROM foo")->is_valid());
+    EXPECT_TRUE(s.is_valid());
+    EXPECT_FALSE(s.Step());
+  }
+  EXPECT_TRUE(db().HasCachedStatement(id1));
+  EXPECT_TRUE(db().HasCachedStatement(id2));
+  EXPECT_TRUE(db().HasCachedStatement(id3));
+}
+
+TEST_F(SQLConnectionTest, OpenOptions) {
+  sql::Connection db;
+  db.set_write_ahead_logging();
+  db.set_mmap_size(1 << 20);
+  ASSERT_TRUE(db.Open(GetPath("SQLConnectionTestOptions.db")));
+  ASSERT_TRUE(db.Execute("CREATE TABLE foo (a, b)"));
+
+  sql::Statement s(db.GetUniqueStatement("PRAGMA journal_mode"));
+  ASSERT_TRUE(s.Step());
+  EXPECT_EQ("wal", s.ColumnString(0));
+}
+
+// Compares inserting rows one transaction each, in batches of 100 with
+// sql::BatchTransaction, and with compiling every statement from scratch.
+// Run with --v=1 to see the timings.
+TEST_F(SQLConnectionTest, InsertBenchmark) {
+  const int kAutoCommitRows = 100;
+  const int kBatchedRows = 10000;
+  ASSERT_TRUE(db().Execute("CREATE TABLE foo (a INTEGER, b TEXT)"));
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kAutoCommitRows; ++i) {
+    sql::Statement s(db().GetCachedStatement(
+        SQL_FROM_HERE, "INSERT INTO foo (a, b) VALUES (?, ?)"));
+    s.BindInt(0, i);
+    s.BindString(1, "autocommit");
+    ASSERT_TRUE(s.Run());
+  }
+  base::TimeDelta auto_commit_time = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  {
+    sql::BatchTransaction batch(&db(), 100);
+    ASSERT_TRUE(batch.Begin());
+    for (int i = 0; i < kBatchedRows; ++i) {
+      sql::Statement s(db().GetCachedStatement(
+          SQL_FROM_HERE, "INSERT INTO foo (a, b) VALUES (?, ?)"));
+      s.BindInt(0, i);
+      s.BindString(1, "batched");
+      ASSERT_TRUE(batch.Run(&s));
+    }
+    ASSERT_TRUE(batch.Commit());
+  }
+  base::TimeDelta batched_time = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  {
+    sql::Transaction transaction(&db());
+    ASSERT_TRUE(transaction.Begin());
+    for (int i = 0; i < kBatchedRows; ++i) {
+      sql::Statement s(db().GetUniqueStatement(
+          "INSERT INTO foo (a, b) VALUES (?, ?)"));
+      s.BindInt(0, i);
+      s.BindString(1, "uncached");
+      ASSERT_TRUE(s.Run());
+    }
+    ASSERT_TRUE(transaction.Commit());
+  }
+  base::TimeDelta uncached_time = base::TimeTicks::Now() - start;
+
+  sql::Statement count(db().GetUniqueStatement("SELECT count(*) FROM foo"));
+  ASSERT_TRUE(count.Step());
+  EXPECT_EQ(kAutoCommitRows + 2 * kBatchedRows, count.ColumnInt(0));
+
+  VLOG(1) << "per row: "
+          << auto_commit_time.InMicroseconds() / kAutoCommitRows
+          << "us autocommit, "
+          << batched_time.InMicroseconds() / kBatchedRows
+          << "us batched, "
+          << uncached_time.InMicroseconds() / kBatchedRows
+          << "us batched without statement cache";
+}
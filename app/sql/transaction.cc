@@ -5,6 +5,7 @@
 #include "app/sql/transaction.h"
 
 #include "app/sql/connection.h"
+#include "app/sql/statement.h"
 #include "base/logging.h"
 
 namespace sql {
@@ -48,4 +49,45 @@ bool Transaction::Commit() {
   return connection_->CommitTransaction();
 }
 
+BatchTransaction::BatchTransaction(Connection* connection,
+                                   int statements_per_commit)
+    : connection_(connection),
+      transaction_(connection),
+      statements_per_commit_(statements_per_commit),
+      pending_count_(0) {
+  DCHECK_GT(statements_per_commit_, 0);
+}
+
+BatchTransaction::~BatchTransaction() {
+}
+
+bool BatchTransaction::Begin() {
+  pending_count_ = 0;
+  return transaction_.Begin();
+}
+
+bool BatchTransaction::Run(Statement* statement) {
+  DCHECK(transaction_.is_open());
+  if (!statement->Run())
+    return false;
+
+  if (++pending_count_ < statements_per_commit_)
+    return true;
+
+  // Don't break up a transaction the caller has wrapped around us; the
+  // outermost one decides when things hit the disk.
+  if (connection_->transaction_nesting() > 1)
+    return true;
+
+  pending_count_ = 0;
+  if (!transaction_.Commit())
+    return false;
+  return transaction_.Begin();
+}
+
+bool BatchTransaction::Commit() {
+  pending_count_ = 0;
+  return transaction_.Commit();
+}
+
 }  // namespace sql
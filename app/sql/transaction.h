@@ -11,6 +11,7 @@
 namespace sql {
 
 class Connection;
+class Statement;
 
 class Transaction {
  public:
@@ -52,6 +53,57 @@ class Transaction {
   DISALLOW_COPY_AND_ASSIGN(Transaction);
 };
 
+// BatchTransaction groups a long series of writes into transactions of
+// |statements_per_commit| statements each. Committing every single write
+// costs a journal sync per statement, while one transaction around all of
+// them holds the write lock (and grows the journal) for as long as the whole
+// series runs. Usage:
+//
+//   sql::BatchTransaction batch(&db, 500);
+//   if (!batch.Begin())
+//     return false;
+//   for (...) {
+//     sql::Statement s(db.GetCachedStatement(SQL_FROM_HERE, "INSERT ..."));
+//     s.Bind...;
+//     if (!batch.Run(&s))
+//       return false;  // The uncommitted statements are rolled back.
+//   }
+//   return batch.Commit();
+//
+// Like Transaction, anything that has not been committed when this goes out of
+// scope is rolled back. Batches that were already committed by Run() stay.
+class BatchTransaction {
+ public:
+  BatchTransaction(Connection* connection, int statements_per_commit);
+  ~BatchTransaction();
+
+  // Returns true when there is a transaction that has been successfully begun.
+  bool is_open() const { return transaction_.is_open(); }
+
+  // Returns the number of statements run since the last commit.
+  int pending_count() const { return pending_count_; }
+
+  // Begins the first transaction. Returns false on failure.
+  bool Begin();
+
+  // Runs |statement|. Once |statements_per_commit| statements have run, commits
+  // them and begins a new transaction. Returns false if the statement or the
+  // commit failed.
+  bool Run(Statement* statement);
+
+  // Commits the statements run since the last commit, returning true on
+  // success. The BatchTransaction is closed afterwards.
+  bool Commit();
+
+ private:
+  Connection* connection_;
+  Transaction transaction_;
+  const int statements_per_commit_;
+  int pending_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchTransaction);
+};
+
 }  // namespace sql
 
 #endif  // APP_SQL_TRANSACTION_H_
@@ -131,3 +131,58 @@ TEST_F(SQLTransactionTest, NestedRollback) {
   EXPECT_EQ(0, db().transaction_nesting());
   EXPECT_EQ(0, CountFoo());
 }
+
+TEST_F(SQLTransactionTest, BatchTransaction) {
+  {
+    sql::BatchTransaction batch(&db(), 3);
+    EXPECT_FALSE(batch.is_open());
+    EXPECT_TRUE(batch.Begin());
+    EXPECT_TRUE(batch.is_open());
+
+    for (int i = 0; i < 7; ++i) {
+      sql::Statement s(db().GetCachedStatement(
+          SQL_FROM_HERE, "INSERT INTO foo (a, b) VALUES (?, ?)"));
+      s.BindInt(0, i);
+      s.BindInt(1, i);
+      EXPECT_TRUE(batch.Run(&s));
+    }
+    // Two batches of three were committed; the seventh row is still pending.
+    EXPECT_EQ(1, batch.pending_count());
+    EXPECT_EQ(1, db().transaction_nesting());
+  }
+
+  // The uncommitted row was rolled back with the BatchTransaction.
+  EXPECT_EQ(0, db().transaction_nesting());
+  EXPECT_EQ(6, CountFoo());
+
+  sql::BatchTransaction batch(&db(), 3);
+  EXPECT_TRUE(batch.Begin());
+  sql::Statement s(db().GetUniqueStatement(
+      "INSERT INTO foo (a, b) VALUES (1, 2)"));
+  EXPECT_TRUE(batch.Run(&s));
+  EXPECT_TRUE(batch.Commit());
+  EXPECT_FALSE(batch.is_open());
+  EXPECT_EQ(7, CountFoo());
+}
+
+// A BatchTransaction nested in another transaction leaves committing to the
+// outer one.
+TEST_F(SQLTransactionTest, NestedBatchTransaction) {
+  sql::Transaction outer(&db());
+  EXPECT_TRUE(outer.Begin());
+  {
+    sql::BatchTransaction batch(&db(), 2);
+    EXPECT_TRUE(batch.Begin());
+    for (int i = 0; i < 5; ++i) {
+      sql::Statement s(db().GetCachedStatement(
+          SQL_FROM_HERE, "INSERT INTO foo (a, b) VALUES (?, ?)"));
+      s.BindInt(0, i);
+      s.BindInt(1, i);
+      EXPECT_TRUE(batch.Run(&s));
+    }
+    EXPECT_EQ(5, batch.pending_count());
+    EXPECT_TRUE(batch.Commit());
+  }
+  outer.Rollback();
+  EXPECT_EQ(0, CountFoo());
+}
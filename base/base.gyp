@@ -111,6 +111,7 @@
         'bits_unittest.cc',
         'callback_unittest.cc',
         'command_line_unittest.cc',
+        'compact_value_unittest.cc',
         'cpu_unittest.cc',
         'debug/leak_tracker_unittest.cc',
         'debug/stack_trace_unittest.cc',
@@ -135,6 +136,7 @@
         'linked_list_unittest.cc',
         'logging_unittest.cc',
         'mac/mac_util_unittest.mm',
+        'md5_unittest.cc',
         'memory/linked_ptr_unittest.cc',
         'memory/ref_counted_unittest.cc',
         'memory/scoped_native_library_unittest.cc',
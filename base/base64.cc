@@ -1,36 +1,180 @@
-// Copyright (c) 2006-2008 The Chromium Authors. All rights reserved.
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
 #include "base/base64.h"
 
+#include "base/basictypes.h"
+#include "base/cpu.h"
+#include "base/lazy_instance.h"
+#include "build/build_config.h"
 #include "third_party/modp_b64/modp_b64.h"
 
+// The SSSE3 code needs per-function target attributes, which older compilers
+// lack.
+#if defined(ARCH_CPU_X86_FAMILY) && (defined(__clang__) || \
+    (defined(COMPILER_GCC) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define BASE64_USE_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
 namespace base {
 
+namespace {
+
+#if defined(BASE64_USE_SSSE3)
+
+// The SSSE3 codec works on 12 bytes of binary data, or 16 characters, at a
+// time, and leaves the tail of the input (including any padding) to modp_b64.
+// It accepts and rejects exactly the same inputs as modp_b64.  See
+// http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html and
+// http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html for how the
+// byte shuffles work.
+
+// Encodes groups of 12 bytes from |input| into |output| while at least 16
+// bytes can be loaded, and returns the number of input bytes consumed.
+// Writes four characters for every three bytes consumed.
+__attribute__((target("ssse3")))
+size_t EncodeSSSE3(const char* input, size_t input_size, char* output) {
+  // Spreads each group of three bytes s0 s1 s2 over a 32-bit lane as
+  // s1 s0 s2 s1, so every 6-bit index sits inside one 16-bit half.
+  const __m128i kSpread =
+      _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  // Maps the 6-bit indices to the offset to add to get their characters.
+  const __m128i kOffsets = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+  size_t consumed = 0;
+  for (; input_size - consumed >= 16; consumed += 12, output += 16) {
+    __m128i in = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(input + consumed));
+    in = _mm_shuffle_epi8(in, kSpread);
+
+    // Move the four 6-bit fields of each lane into their own bytes.
+    __m128i ac = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+                                 _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+                                 _mm_set1_epi32(0x01000010));
+    __m128i indices = _mm_or_si128(ac, bd);
+
+    // 0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10, 62 -> 11, 63 -> 12.
+    __m128i offset_index = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    offset_index = _mm_or_si128(offset_index,
+                                _mm_and_si128(upper, _mm_set1_epi8(13)));
+    __m128i chars = _mm_add_epi8(indices,
+                                 _mm_shuffle_epi8(kOffsets, offset_index));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), chars);
+  }
+  return consumed;
+}
+
+// Decodes groups of 16 characters from |input| into |output|, always leaving
+// at least the last eight characters alone, and sets |consumed| to the number
+// of characters decoded.  Writes three bytes for every four characters
+// consumed, but stores 16 bytes at a time.  Returns false on a character that
+// is not in the base64 alphabet, including '='.
+__attribute__((target("ssse3")))
+bool DecodeSSSE3(const char* input, size_t input_size, char* output,
+                 size_t* consumed) {
+  // Character classes by low and high nibble.  A character is valid when the
+  // two entries have no bit in common.
+  const __m128i kLowNibbleClasses = _mm_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i kHighNibbleClasses = _mm_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  // What to add to a character to get its 6-bit value, by high nibble, with
+  // '/' moved to slot 1.
+  const __m128i kOffsets = _mm_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  // Moves the three bytes of each 32-bit lane to the front, in order.
+  const __m128i kPack = _mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m128i kNibbleMask = _mm_set1_epi8(0x0f);
+  const __m128i kSlash = _mm_set1_epi8('/');
+
+  size_t done = 0;
+  for (; input_size - done >= 24; done += 16, output += 12) {
+    __m128i in = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(input + done));
+    __m128i high_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), kNibbleMask);
+    __m128i low_nibbles = _mm_and_si128(in, kNibbleMask);
+    __m128i invalid = _mm_and_si128(
+        _mm_shuffle_epi8(kLowNibbleClasses, low_nibbles),
+        _mm_shuffle_epi8(kHighNibbleClasses, high_nibbles));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) !=
+        0xffff) {
+      return false;
+    }
+
+    __m128i slash = _mm_cmpeq_epi8(in, kSlash);
+    __m128i values = _mm_add_epi8(
+        in, _mm_shuffle_epi8(kOffsets, _mm_add_epi8(slash, high_nibbles)));
+
+    // Merge pairs of 6-bit values into 12 bits, then pairs of those into 24.
+    __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                     _mm_shuffle_epi8(merged, kPack));
+  }
+  *consumed = done;
+  return true;
+}
+
+#endif  // defined(BASE64_USE_SSSE3)
+
+// Picks the codec once per process.
+struct Base64Dispatch {
+  Base64Dispatch() : use_ssse3(false) {
+#if defined(BASE64_USE_SSSE3)
+    CPU cpu;
+    use_ssse3 = cpu.has_ssse3() != 0;
+#endif
+  }
+
+  bool use_ssse3;
+};
+
+// Leaky, since encoding may happen without an AtExitManager.
+LazyInstance<Base64Dispatch, LeakyLazyInstanceTraits<Base64Dispatch> >
+    g_dispatch(LINKER_INITIALIZED);
+
+}  // namespace
+
 bool Base64Encode(const std::string& input, std::string* output) {
   std::string temp;
   temp.resize(modp_b64_encode_len(input.size()));  // makes room for null byte
 
+  // Bulk of the input first, if we can, then the tail with modp_b64.
+  size_t consumed = 0;
+#if defined(BASE64_USE_SSSE3)
+  if (g_dispatch.Get().use_ssse3)
+    consumed = EncodeSSSE3(input.data(), input.size(), &temp[0]);
+#endif
+  size_t encoded = consumed / 3 * 4;
+
   // null terminates result since result is base64 text!
-  int input_size = static_cast<int>(input.size());
-  int output_size= modp_b64_encode(&(temp[0]), input.data(), input_size);
+  int input_size = static_cast<int>(input.size() - consumed);
+  int output_size = modp_b64_encode(&temp[encoded], input.data() + consumed,
+                                    input_size);
   if (output_size < 0)
     return false;
 
-  temp.resize(output_size);  // strips off null byte
+  temp.resize(encoded + output_size);  // strips off null byte
   output->swap(temp);
   return true;
 }
 
 bool Base64Decode(const std::string& input, std::string* output) {
   std::string temp;
-  temp.resize(modp_b64_decode_len(input.size()));
+  temp.resize(Base64DecodeBufferSize(input.size()));
 
-  // does not null terminate result since result is binary data!
-  int input_size = static_cast<int>(input.size());
-  int output_size = modp_b64_decode(&(temp[0]), input.data(), input_size);
-  if (output_size < 0)
+  size_t output_size = 0;
+  if (!Base64DecodeToBuffer(input, &temp[0], temp.size(), &output_size))
     return false;
 
   temp.resize(output_size);
@@ -38,4 +182,35 @@ bool Base64Decode(const std::string& input, std::string* output) {
   return true;
 }
 
+size_t Base64DecodeBufferSize(size_t input_size) {
+  return modp_b64_decode_len(input_size);
+}
+
+bool Base64DecodeToBuffer(const StringPiece& input,
+                          char* output,
+                          size_t output_size,
+                          size_t* output_length) {
+  if (output_size < Base64DecodeBufferSize(input.size()))
+    return false;
+
+  size_t consumed = 0;
+#if defined(BASE64_USE_SSSE3)
+  if (g_dispatch.Get().use_ssse3 &&
+      !DecodeSSSE3(input.data(), input.size(), output, &consumed)) {
+    return false;
+  }
+#endif
+  size_t decoded = consumed / 4 * 3;
+
+  // does not null terminate result since result is binary data!
+  int input_size = static_cast<int>(input.size() - consumed);
+  int tail_size = modp_b64_decode(output + decoded, input.data() + consumed,
+                                  input_size);
+  if (tail_size < 0)
+    return false;
+
+  *output_length = decoded + tail_size;
+  return true;
+}
+
 }  // namespace base
@@ -9,6 +9,7 @@
 #include <string>
 
 #include "base/base_api.h"
+#include "base/string_piece.h"
 
 namespace base {
 
@@ -20,6 +21,20 @@ BASE_API bool Base64Encode(const std::string& input, std::string* output);
 // otherwise.  The output string is only modified if successful.
 BASE_API bool Base64Decode(const std::string& input, std::string* output);
 
+// Returns the size of the buffer Base64DecodeToBuffer() needs for
+// |input_size| base64 characters.  The decoded data may be a little shorter.
+BASE_API size_t Base64DecodeBufferSize(size_t input_size);
+
+// Like Base64Decode(), but decodes into |output|, which must be at least
+// Base64DecodeBufferSize(input.size()) bytes long, and sets |output_length|
+// to the number of bytes decoded.  Useful to decode into a reused buffer
+// without allocating.  Returns false if the input is not valid base64 or the
+// buffer is too small; the contents of |output| are then undefined.
+BASE_API bool Base64DecodeToBuffer(const StringPiece& input,
+                                   char* output,
+                                   size_t output_size,
+                                   size_t* output_length);
+
 }  // namespace base
 
 #endif  // BASE_BASE64_H__
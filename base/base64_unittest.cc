@@ -2,7 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "base/base64.h"
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace {
@@ -27,3 +34,91 @@ TEST(Base64Test, Basic) {
   EXPECT_TRUE(ok);
   EXPECT_EQ(kText, decoded);
 }
+
+TEST(Base64Test, LongInputs) {
+  // Long enough to exercise the vectorized codec on processors that have it,
+  // with every possible tail length.
+  std::string text;
+  for (int i = 0; i < 300; ++i) {
+    std::string encoded, decoded;
+    EXPECT_TRUE(base::Base64Encode(text, &encoded));
+    EXPECT_EQ((text.size() + 2) / 3 * 4, encoded.size());
+    EXPECT_TRUE(base::Base64Decode(encoded, &decoded));
+    EXPECT_EQ(text, decoded);
+    text.push_back(static_cast<char>(i * 37));
+  }
+
+  // Bytes spanning the whole alphabet, in a known encoding.
+  std::string bytes;
+  for (int i = 0; i < 48; ++i)
+    bytes.push_back(static_cast<char>(i * 5 + 16));
+  std::string encoded;
+  EXPECT_TRUE(base::Base64Encode(bytes, &encoded));
+  EXPECT_EQ("EBUaHyQpLjM4PUJHTFFWW2Blam90eX6DiI2Sl5yh"
+            "pquwtbq/xMnO09jd4ufs8fb7", encoded);
+}
+
+TEST(Base64Test, InvalidCharacters) {
+  std::string text(100, 'x');
+  std::string encoded;
+  ASSERT_TRUE(base::Base64Encode(text, &encoded));
+
+  // A bad character anywhere must be rejected, including '=' before the end.
+  const char kBadCharacters[] = { '=', ' ', '-', '_', '@', '\0', '\x80' };
+  for (size_t i = 0; i < arraysize(kBadCharacters); ++i) {
+    for (size_t position = 0; position < encoded.size() - 2; ++position) {
+      std::string bad = encoded;
+      bad[position] = kBadCharacters[i];
+      std::string decoded = "unchanged";
+      EXPECT_FALSE(base::Base64Decode(bad, &decoded)) << position;
+      EXPECT_EQ("unchanged", decoded);
+    }
+  }
+}
+
+TEST(Base64Test, DecodeToBuffer) {
+  const std::string kBase64Text = "aGVsbG8gd29ybGQ=";
+  std::vector<char> buffer(base::Base64DecodeBufferSize(kBase64Text.size()));
+  size_t length = 0;
+  ASSERT_TRUE(base::Base64DecodeToBuffer(kBase64Text, &buffer[0],
+                                         buffer.size(), &length));
+  EXPECT_EQ("hello world", std::string(&buffer[0], length));
+
+  // Too small a buffer is refused.
+  EXPECT_FALSE(base::Base64DecodeToBuffer(kBase64Text, &buffer[0],
+                                          buffer.size() - 1, &length));
+  EXPECT_FALSE(base::Base64DecodeToBuffer("aGVsbG8", &buffer[0],
+                                          buffer.size(), &length));
+}
+
+// Encodes and decodes buffers from 32 bytes to 16MB. Run with --v=1 to see
+// the throughput.
+TEST(Base64Test, Throughput) {
+  const size_t kBytesPerSize = 16 << 20;
+  const size_t kSizes[] = { 32, 1024, 64 << 10, 1 << 20, 16 << 20 };
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    std::string input(kSizes[i], '\x5a');
+    std::string encoded, decoded;
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t done = 0; done < kBytesPerSize; done += kSizes[i])
+      ASSERT_TRUE(base::Base64Encode(input, &encoded));
+    base::TimeDelta encode_time = base::TimeTicks::Now() - start;
+
+    std::vector<char> buffer(base::Base64DecodeBufferSize(encoded.size()));
+    size_t length = 0;
+    start = base::TimeTicks::Now();
+    for (size_t done = 0; done < kBytesPerSize; done += kSizes[i]) {
+      ASSERT_TRUE(base::Base64DecodeToBuffer(encoded, &buffer[0],
+                                             buffer.size(), &length));
+    }
+    base::TimeDelta decode_time = base::TimeTicks::Now() - start;
+    EXPECT_EQ(input, std::string(&buffer[0], length));
+
+    VLOG(1) << kSizes[i] << " byte buffers: "
+            << kBytesPerSize / std::max<int64>(encode_time.InMicroseconds(), 1)
+            << " MB/s encode, "
+            << kBytesPerSize / std::max<int64>(decode_time.InMicroseconds(), 1)
+            << " MB/s decode";
+  }
+}
@@ -0,0 +1,266 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/compact_value.h"
+
+#include "base/logging.h"
+#include "base/utf_string_conversions.h"
+
+namespace base {
+
+CompactValue::CompactValue() {
+  nodes_.push_back(Node());
+}
+
+CompactValue::CompactValue(const Value& root) {
+  // Lay the tree out breadth first, so that the children of each list and
+  // dictionary end up adjacent.  |values[i]| is the source of |nodes_[i]|.
+  std::vector<const Value*> values;
+  nodes_.push_back(Node());
+  values.push_back(&root);
+  for (size_t i = 0; i < values.size(); ++i) {
+    const Value* value = values[i];
+    // Work on a copy, adding children below may reallocate |nodes_|.
+    Node node = nodes_[i];
+    node.type = value->GetType();
+    switch (node.type) {
+      case Value::TYPE_NULL:
+        break;
+
+      case Value::TYPE_BOOLEAN:
+        value->GetAsBoolean(&node.boolean_value);
+        break;
+
+      case Value::TYPE_INTEGER:
+        value->GetAsInteger(&node.integer_value);
+        break;
+
+      case Value::TYPE_DOUBLE:
+        value->GetAsDouble(&node.double_value);
+        break;
+
+      case Value::TYPE_STRING: {
+        std::string string_value;
+        value->GetAsString(&string_value);
+        node.range.offset = AddString(string_value.data(),
+                                      string_value.size());
+        node.range.length = static_cast<uint32>(string_value.size());
+        break;
+      }
+
+      case Value::TYPE_BINARY: {
+        const BinaryValue* binary = static_cast<const BinaryValue*>(value);
+        node.range.offset = AddString(binary->GetBuffer(), binary->GetSize());
+        node.range.length = static_cast<uint32>(binary->GetSize());
+        break;
+      }
+
+      case Value::TYPE_LIST: {
+        const ListValue* list = static_cast<const ListValue*>(value);
+        node.range.offset = static_cast<uint32>(nodes_.size());
+        node.range.length = static_cast<uint32>(list->GetSize());
+        for (ListValue::const_iterator it = list->begin(); it != list->end();
+             ++it) {
+          nodes_.push_back(Node());
+          values.push_back(*it);
+        }
+        break;
+      }
+
+      case Value::TYPE_DICTIONARY: {
+        // The keys come out of the std::map sorted, which is the order
+        // FindChild() relies on.
+        const DictionaryValue* dictionary =
+            static_cast<const DictionaryValue*>(value);
+        node.range.offset = static_cast<uint32>(nodes_.size());
+        node.range.length = static_cast<uint32>(dictionary->size());
+        for (DictionaryValue::key_iterator it = dictionary->begin_keys();
+             it != dictionary->end_keys(); ++it) {
+          const std::string& key = *it;
+          Value* child = NULL;
+          bool rv = dictionary->GetWithoutPathExpansion(key, &child);
+          DCHECK(rv);
+          Node child_node;
+          child_node.key_offset = AddString(key.data(), key.size());
+          child_node.key_length = static_cast<uint32>(key.size());
+          nodes_.push_back(child_node);
+          values.push_back(child);
+        }
+        break;
+      }
+
+      default:
+        NOTREACHED();
+        node.type = Value::TYPE_NULL;
+        break;
+    }
+    nodes_[i] = node;
+  }
+}
+
+CompactValue::~CompactValue() {
+}
+
+Value::ValueType CompactValue::GetType() const {
+  return nodes_[0].type;
+}
+
+bool CompactValue::HasPath(const StringPiece& path) const {
+  return FindPath(path) != NULL;
+}
+
+bool CompactValue::GetBoolean(const StringPiece& path, bool* out_value) const {
+  const Node* node = FindPath(path);
+  if (!node || node->type != Value::TYPE_BOOLEAN)
+    return false;
+  *out_value = node->boolean_value;
+  return true;
+}
+
+bool CompactValue::GetInteger(const StringPiece& path, int* out_value) const {
+  const Node* node = FindPath(path);
+  if (!node || node->type != Value::TYPE_INTEGER)
+    return false;
+  *out_value = node->integer_value;
+  return true;
+}
+
+bool CompactValue::GetDouble(const StringPiece& path,
+                             double* out_value) const {
+  const Node* node = FindPath(path);
+  if (!node || node->type != Value::TYPE_DOUBLE)
+    return false;
+  *out_value = node->double_value;
+  return true;
+}
+
+bool CompactValue::GetString(const StringPiece& path,
+                             std::string* out_value) const {
+  StringPiece piece;
+  if (!GetStringPiece(path, &piece))
+    return false;
+  piece.CopyToString(out_value);
+  return true;
+}
+
+bool CompactValue::GetString(const StringPiece& path,
+                             string16* out_value) const {
+  StringPiece piece;
+  if (!GetStringPiece(path, &piece))
+    return false;
+  *out_value = UTF8ToUTF16(piece);
+  return true;
+}
+
+bool CompactValue::GetStringPiece(const StringPiece& path,
+                                  StringPiece* out_value) const {
+  const Node* node = FindPath(path);
+  if (!node || node->type != Value::TYPE_STRING)
+    return false;
+  *out_value = PayloadOf(*node);
+  return true;
+}
+
+int CompactValue::GetSize(const StringPiece& path) const {
+  const Node* node = FindPath(path);
+  if (!node || (node->type != Value::TYPE_LIST &&
+                node->type != Value::TYPE_DICTIONARY))
+    return -1;
+  return static_cast<int>(node->range.length);
+}
+
+Value* CompactValue::ToValue() const {
+  return NodeToValue(nodes_[0]);
+}
+
+size_t CompactValue::EstimateMemoryUsage() const {
+  return nodes_.capacity() * sizeof(Node) + strings_.capacity();
+}
+
+StringPiece CompactValue::KeyOf(const Node& node) const {
+  return StringPiece(strings_.data() + node.key_offset, node.key_length);
+}
+
+StringPiece CompactValue::PayloadOf(const Node& node) const {
+  return StringPiece(strings_.data() + node.range.offset, node.range.length);
+}
+
+const CompactValue::Node* CompactValue::FindChild(
+    const Node& node, const StringPiece& key) const {
+  DCHECK_EQ(Value::TYPE_DICTIONARY, node.type);
+  size_t low = node.range.offset;
+  size_t high = node.range.offset + node.range.length;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    int result = KeyOf(nodes_[middle]).compare(key);
+    if (result == 0)
+      return &nodes_[middle];
+    if (result < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return NULL;
+}
+
+const CompactValue::Node* CompactValue::FindPath(
+    const StringPiece& path) const {
+  const Node* node = &nodes_[0];
+  size_t key_start = 0;
+  while (true) {
+    if (node->type != Value::TYPE_DICTIONARY)
+      return NULL;
+    size_t delimiter_position = path.find('.', key_start);
+    if (delimiter_position == StringPiece::npos)
+      return FindChild(*node, path.substr(key_start));
+    node = FindChild(*node,
+                     path.substr(key_start, delimiter_position - key_start));
+    if (!node)
+      return NULL;
+    key_start = delimiter_position + 1;
+  }
+}
+
+uint32 CompactValue::AddString(const char* data, size_t length) {
+  size_t offset = strings_.size();
+  // Offsets and lengths are 32 bits to keep nodes small.
+  CHECK_LE(offset + length, static_cast<size_t>(kuint32max));
+  strings_.append(data, length);
+  return static_cast<uint32>(offset);
+}
+
+Value* CompactValue::NodeToValue(const Node& node) const {
+  switch (node.type) {
+    case Value::TYPE_BOOLEAN:
+      return Value::CreateBooleanValue(node.boolean_value);
+    case Value::TYPE_INTEGER:
+      return Value::CreateIntegerValue(node.integer_value);
+    case Value::TYPE_DOUBLE:
+      return Value::CreateDoubleValue(node.double_value);
+    case Value::TYPE_STRING:
+      return Value::CreateStringValue(PayloadOf(node).as_string());
+    case Value::TYPE_BINARY:
+      return BinaryValue::CreateWithCopiedBuffer(
+          strings_.data() + node.range.offset, node.range.length);
+    case Value::TYPE_LIST: {
+      ListValue* list = new ListValue;
+      for (uint32 i = 0; i < node.range.length; ++i)
+        list->Append(NodeToValue(nodes_[node.range.offset + i]));
+      return list;
+    }
+    case Value::TYPE_DICTIONARY: {
+      DictionaryValue* dictionary = new DictionaryValue;
+      for (uint32 i = 0; i < node.range.length; ++i) {
+        const Node& child = nodes_[node.range.offset + i];
+        dictionary->SetWithoutPathExpansion(KeyOf(child).as_string(),
+                                            NodeToValue(child));
+      }
+      return dictionary;
+    }
+    default:
+      return Value::CreateNullValue();
+  }
+}
+
+}  // namespace base
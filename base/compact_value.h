@@ -0,0 +1,139 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// CompactValue is a read-only, flattened copy of a Value tree.  Large trees
+// that are built once and then mostly read (policy, extension manifests,
+// default preferences) are expensive as Values: every node is a separate heap
+// object, every dictionary is a std::map with a heap-allocated node per key,
+// and each dotted-path lookup walks a chain of maps.  A CompactValue stores
+// the whole tree in two contiguous buffers:
+//
+//  - a vector of fixed-size nodes with the scalars stored inline, where the
+//    children of every list and dictionary are adjacent, and the children of a
+//    dictionary are sorted by key so they can be binary searched;
+//  - a single string pool holding all the keys and string/binary payloads.
+//
+// Copying a CompactValue is therefore two buffer copies, and lookups do not
+// allocate.  Use ToValue() to get a mutable Value tree back.
+//
+//   scoped_ptr<DictionaryValue> manifest(...);
+//   base::CompactValue compact(*manifest);
+//   std::string name;
+//   compact.GetString("browser_action.default_title", &name);
+
+#ifndef BASE_COMPACT_VALUE_H_
+#define BASE_COMPACT_VALUE_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/base_api.h"
+#include "base/basictypes.h"
+#include "base/string16.h"
+#include "base/string_piece.h"
+#include "base/values.h"
+
+namespace base {
+
+// CompactValue is copyable and assignable.
+class BASE_API CompactValue {
+ public:
+  // Creates a CompactValue holding a null value.
+  CompactValue();
+
+  // Creates a flattened copy of |root|.
+  explicit CompactValue(const Value& root);
+
+  ~CompactValue();
+
+  // Returns the type of the root value.
+  Value::ValueType GetType() const;
+
+  // Returns true if |path| names a value.  Paths have the same syntax as for
+  // DictionaryValue::Get(): "<key>" or "<key>.<key>.[...]", where each key but
+  // the last must name a dictionary.
+  bool HasPath(const StringPiece& path) const;
+
+  // These look up |path| as above and return true if the value there has the
+  // requested type, filling in |out_value|; otherwise they return false and
+  // leave |out_value| untouched, like the Value::GetAs*() methods.
+  bool GetBoolean(const StringPiece& path, bool* out_value) const;
+  bool GetInteger(const StringPiece& path, int* out_value) const;
+  bool GetDouble(const StringPiece& path, double* out_value) const;
+  bool GetString(const StringPiece& path, std::string* out_value) const;
+  bool GetString(const StringPiece& path, string16* out_value) const;
+
+  // Like GetString(), but returns a piece of the string pool instead of a
+  // copy.  The piece is valid as long as this CompactValue is not modified or
+  // destroyed.
+  bool GetStringPiece(const StringPiece& path, StringPiece* out_value) const;
+
+  // Returns the number of entries of the list or dictionary at |path|, or -1
+  // if there is no list or dictionary there.
+  int GetSize(const StringPiece& path) const;
+
+  // Converts the tree back into a Value.  The caller takes ownership.
+  Value* ToValue() const;
+
+  // Returns the number of bytes used by the two buffers, for comparison with
+  // the equivalent Value tree.
+  size_t EstimateMemoryUsage() const;
+
+ private:
+  // A span of |strings_| or |nodes_|.
+  struct Range {
+    uint32 offset;
+    uint32 length;
+  };
+
+  struct Node {
+    Node() : type(Value::TYPE_NULL), key_offset(0), key_length(0) {
+      range.offset = 0;
+      range.length = 0;
+    }
+
+    Value::ValueType type;
+
+    // Location of this node's key in |strings_|, when its parent is a
+    // dictionary.
+    uint32 key_offset;
+    uint32 key_length;
+
+    union {
+      bool boolean_value;
+      int integer_value;
+      double double_value;
+
+      // TYPE_STRING and TYPE_BINARY: the payload in |strings_|.
+      // TYPE_LIST and TYPE_DICTIONARY: the children in |nodes_|.
+      Range range;
+    };
+  };
+
+  // Returns the key of |node|.
+  StringPiece KeyOf(const Node& node) const;
+
+  // Returns the string or binary payload of |node|.
+  StringPiece PayloadOf(const Node& node) const;
+
+  // Returns the child of dictionary |node| named |key|, or NULL.
+  const Node* FindChild(const Node& node, const StringPiece& key) const;
+
+  // Resolves |path| from the root, returning NULL if it names nothing.
+  const Node* FindPath(const StringPiece& path) const;
+
+  // Appends |data| to |strings_| and returns its offset.
+  uint32 AddString(const char* data, size_t length);
+
+  // Builds a Value for |node| and its children.
+  Value* NodeToValue(const Node& node) const;
+
+  std::vector<Node> nodes_;
+  std::string strings_;
+};
+
+}  // namespace base
+
+#endif  // BASE_COMPACT_VALUE_H_
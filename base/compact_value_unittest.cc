@@ -0,0 +1,199 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/compact_value.h"
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/string16.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Shape of the tree used to compare CompactValue with DictionaryValue: 100
+// sections of 100 keys each.
+const int kSectionCount = 100;
+const int kKeysPerSection = 100;
+
+// Number of lookups timed in the benchmark.
+const int kLookupCount = 100000;
+
+DictionaryValue* BuildLargeTree() {
+  DictionaryValue* root = new DictionaryValue;
+  for (int section = 0; section < kSectionCount; ++section) {
+    DictionaryValue* dictionary = new DictionaryValue;
+    for (int key = 0; key < kKeysPerSection; ++key) {
+      std::string name = StringPrintf("key%d", key);
+      if (key % 2)
+        dictionary->SetInteger(name, section * kKeysPerSection + key);
+      else
+        dictionary->SetString(name, StringPrintf("value %d", key));
+    }
+    root->SetWithoutPathExpansion(StringPrintf("section%d", section),
+                                  dictionary);
+  }
+  return root;
+}
+
+}  // namespace
+
+TEST(CompactValueTest, Empty) {
+  CompactValue compact;
+  EXPECT_EQ(Value::TYPE_NULL, compact.GetType());
+  EXPECT_FALSE(compact.HasPath("a"));
+
+  scoped_ptr<Value> value(compact.ToValue());
+  EXPECT_TRUE(value->IsType(Value::TYPE_NULL));
+}
+
+TEST(CompactValueTest, Lookups) {
+  DictionaryValue dictionary;
+  dictionary.SetBoolean("global.enabled", true);
+  dictionary.SetInteger("global.count", 42);
+  dictionary.SetDouble("global.ratio", 0.5);
+  dictionary.SetString("global.pages.homepage", "http://scurvy.com");
+  dictionary.SetWithoutPathExpansion("dotted.key",
+                                     Value::CreateStringValue("dot"));
+  ListValue* list = new ListValue;
+  list->Append(Value::CreateIntegerValue(1));
+  list->Append(new DictionaryValue);
+  dictionary.Set("global.list", list);
+
+  CompactValue compact(dictionary);
+  EXPECT_EQ(Value::TYPE_DICTIONARY, compact.GetType());
+
+  bool enabled = false;
+  EXPECT_TRUE(compact.GetBoolean("global.enabled", &enabled));
+  EXPECT_TRUE(enabled);
+
+  int count = 0;
+  EXPECT_TRUE(compact.GetInteger("global.count", &count));
+  EXPECT_EQ(42, count);
+
+  double ratio = 0.0;
+  EXPECT_TRUE(compact.GetDouble("global.ratio", &ratio));
+  EXPECT_EQ(0.5, ratio);
+
+  std::string homepage;
+  EXPECT_TRUE(compact.GetString("global.pages.homepage", &homepage));
+  EXPECT_EQ("http://scurvy.com", homepage);
+  string16 homepage16;
+  EXPECT_TRUE(compact.GetString("global.pages.homepage", &homepage16));
+  EXPECT_EQ(ASCIIToUTF16("http://scurvy.com"), homepage16);
+  StringPiece piece;
+  EXPECT_TRUE(compact.GetStringPiece("global.pages.homepage", &piece));
+  EXPECT_EQ("http://scurvy.com", piece.as_string());
+
+  EXPECT_EQ(2, compact.GetSize("global.list"));
+  EXPECT_EQ(1, compact.GetSize("global.pages"));
+  EXPECT_EQ(-1, compact.GetSize("global.count"));
+
+  // Type mismatches and missing paths leave the output alone.
+  count = 7;
+  EXPECT_FALSE(compact.GetInteger("global.ratio", &count));
+  EXPECT_FALSE(compact.GetInteger("global.missing", &count));
+  EXPECT_FALSE(compact.GetInteger("global.count.deeper", &count));
+  EXPECT_FALSE(compact.GetInteger("", &count));
+  EXPECT_EQ(7, count);
+
+  // As with DictionaryValue, keys containing '.' are not reachable by path.
+  EXPECT_FALSE(compact.HasPath("dotted.key"));
+}
+
+TEST(CompactValueTest, RoundTrip) {
+  DictionaryValue dictionary;
+  dictionary.Set("null", Value::CreateNullValue());
+  dictionary.SetString("a.b.c", "deep");
+  dictionary.SetString("unicode", WideToUTF16(L"\x7F51\x9875"));
+  dictionary.Set("binary", BinaryValue::CreateWithCopiedBuffer("\0\1\2", 3));
+  ListValue* list = new ListValue;
+  list->Append(Value::CreateBooleanValue(false));
+  list->Append(Value::CreateDoubleValue(-1.25));
+  ListValue* nested = new ListValue;
+  nested->Append(Value::CreateStringValue("nested"));
+  list->Append(nested);
+  dictionary.Set("list", list);
+
+  CompactValue compact(dictionary);
+  scoped_ptr<Value> round_trip(compact.ToValue());
+  EXPECT_TRUE(dictionary.Equals(round_trip.get()));
+
+  // Copies are independent of the original.
+  CompactValue copy(compact);
+  compact = CompactValue();
+  round_trip.reset(copy.ToValue());
+  EXPECT_TRUE(dictionary.Equals(round_trip.get()));
+
+  // Non-dictionary roots work too.
+  CompactValue compact_list(*list);
+  EXPECT_EQ(Value::TYPE_LIST, compact_list.GetType());
+  round_trip.reset(compact_list.ToValue());
+  EXPECT_TRUE(list->Equals(round_trip.get()));
+}
+
+// Compares building, looking up and copying a tree with 10k keys as a
+// DictionaryValue and as a CompactValue.  Run with --v=1 to see the timings.
+TEST(CompactValueTest, LargeTree) {
+  TimeTicks start = TimeTicks::Now();
+  scoped_ptr<DictionaryValue> dictionary(BuildLargeTree());
+  TimeDelta value_build_time = TimeTicks::Now() - start;
+
+  start = TimeTicks::Now();
+  CompactValue compact(*dictionary);
+  TimeDelta compact_build_time = TimeTicks::Now() - start;
+
+  std::vector<std::string> paths;
+  for (int section = 0; section < kSectionCount; ++section) {
+    for (int key = 1; key < kKeysPerSection; key += 2)
+      paths.push_back(StringPrintf("section%d.key%d", section, key));
+  }
+
+  start = TimeTicks::Now();
+  int64 value_sum = 0;
+  for (int i = 0; i < kLookupCount; ++i) {
+    int value = 0;
+    ASSERT_TRUE(dictionary->GetInteger(paths[i % paths.size()], &value));
+    value_sum += value;
+  }
+  TimeDelta value_lookup_time = TimeTicks::Now() - start;
+
+  start = TimeTicks::Now();
+  int64 compact_sum = 0;
+  for (int i = 0; i < kLookupCount; ++i) {
+    int value = 0;
+    ASSERT_TRUE(compact.GetInteger(paths[i % paths.size()], &value));
+    compact_sum += value;
+  }
+  TimeDelta compact_lookup_time = TimeTicks::Now() - start;
+  EXPECT_EQ(value_sum, compact_sum);
+
+  start = TimeTicks::Now();
+  scoped_ptr<DictionaryValue> value_copy(dictionary->DeepCopy());
+  TimeDelta value_copy_time = TimeTicks::Now() - start;
+
+  start = TimeTicks::Now();
+  CompactValue compact_copy(compact);
+  TimeDelta compact_copy_time = TimeTicks::Now() - start;
+  EXPECT_EQ(kKeysPerSection, compact_copy.GetSize("section0"));
+
+  scoped_ptr<Value> round_trip(compact_copy.ToValue());
+  EXPECT_TRUE(dictionary->Equals(round_trip.get()));
+
+  VLOG(1) << "build: " << value_build_time.InMicroseconds() << "us Value, "
+          << compact_build_time.InMicroseconds() << "us CompactValue";
+  VLOG(1) << kLookupCount << " lookups: "
+          << value_lookup_time.InMicroseconds() << "us Value, "
+          << compact_lookup_time.InMicroseconds() << "us CompactValue";
+  VLOG(1) << "copy: " << value_copy_time.InMicroseconds() << "us Value, "
+          << compact_copy_time.InMicroseconds() << "us CompactValue ("
+          << compact.EstimateMemoryUsage() << " bytes)";
+}
+
+}  // namespace base
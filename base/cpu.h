@@ -33,6 +33,7 @@ class BASE_API CPU {
   int has_ssse3() const { return has_ssse3_; }
   int has_sse41() const { return has_sse41_; }
   int has_sse42() const { return has_sse42_; }
+  int has_sha() const { return has_sha_; }
 
  private:
   // Query the processor for CPUID information.
@@ -51,6 +52,7 @@ class BASE_API CPU {
   bool has_ssse3_;
   bool has_sse41_;
   bool has_sse42_;
+  bool has_sha_;  // SHA-1 and SHA-256 instructions (SHA-NI).
   std::string cpu_vendor_;
 };
 
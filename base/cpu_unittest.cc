@@ -86,6 +86,11 @@ TEST(CPU, RunExtendedInstructions) {
     // Execute an SSE 4.2 instruction.
     __asm__ __volatile__("crc32 %%eax, %%eax\n" : : : "eax");
   }
+
+  if (cpu.has_sha()) {
+    // Execute a SHA instruction.
+    __asm__ __volatile__("sha1nexte %%xmm0, %%xmm0\n" : : : "xmm0");
+  }
 #endif
 #endif
 }
@@ -45,6 +45,7 @@ typedef pthread_mutex_t* MutexHandle;
 #include <iomanip>
 #include <ostream>
 
+#include "base/atomicops.h"
 #include "base/base_switches.h"
 #include "base/command_line.h"
 #include "base/debug/debugger.h"
@@ -349,6 +350,212 @@ bool InitializeLogFileHandle() {
   return true;
 }
 
+#if defined(OS_POSIX) && !defined(OS_NACL)
+// Asynchronous logging.  Each logging thread copies its messages into a ring
+// buffer of its own, which only it writes to and only the writer thread (or a
+// flush) reads from, so logging takes no lock.  Each message is stored as its
+// length followed by its bytes.
+
+// How long the writer thread waits for more messages to batch up.
+const int kAsyncLogWriterDelayMs = 5;
+// When a round collects this much, the writer goes again without waiting.
+const size_t kAsyncLogBusyBatchSize = 16 * 1024;
+
+struct AsyncLogRing {
+  explicit AsyncLogRing(size_t size)
+      : buffer(new char[size]),
+        mask(static_cast<uint32>(size - 1)),
+        head(0),
+        tail(0),
+        dropped(0),
+        orphaned(0),
+        next(NULL) {
+  }
+
+  ~AsyncLogRing() {
+    delete[] buffer;
+  }
+
+  uint32 capacity() const { return mask + 1; }
+
+  // Copies |size| bytes from |data| in at |pos|, wrapping around.
+  void CopyIn(uint32 pos, const void* data, uint32 size) {
+    uint32 offset = pos & mask;
+    uint32 first = std::min(size, capacity() - offset);
+    memcpy(buffer + offset, data, first);
+    memcpy(buffer, static_cast<const char*>(data) + first, size - first);
+  }
+
+  // Copies |size| bytes at |pos| out to |data|, wrapping around.
+  void CopyOut(uint32 pos, void* data, uint32 size) const {
+    uint32 offset = pos & mask;
+    uint32 first = std::min(size, capacity() - offset);
+    memcpy(data, buffer + offset, first);
+    memcpy(static_cast<char*>(data) + first, buffer, size - first);
+  }
+
+  // Called on the logging thread.  Returns false if |message| doesn't fit.
+  bool Push(const std::string& message) {
+    uint32 size = static_cast<uint32>(message.size());
+    uint32 pos = static_cast<uint32>(base::subtle::NoBarrier_Load(&head));
+    uint32 free_space = capacity() -
+        (pos - static_cast<uint32>(base::subtle::Acquire_Load(&tail)));
+    if (message.size() > capacity() || sizeof(size) + size > free_space)
+      return false;
+    CopyIn(pos, &size, sizeof(size));
+    CopyIn(pos + sizeof(size), message.data(), size);
+    base::subtle::Release_Store(&head, pos + sizeof(size) + size);
+    return true;
+  }
+
+  // Appends the queued messages to |batch|.  Called with |async_rings_lock|
+  // held.
+  void DrainInto(std::string* batch) {
+    uint32 end = static_cast<uint32>(base::subtle::Acquire_Load(&head));
+    uint32 pos = static_cast<uint32>(base::subtle::NoBarrier_Load(&tail));
+    while (pos != end) {
+      uint32 size;
+      CopyOut(pos, &size, sizeof(size));
+      pos += sizeof(size);
+      size_t offset = batch->size();
+      batch->resize(offset + size);
+      CopyOut(pos, &(*batch)[offset], size);
+      pos += size;
+    }
+    base::subtle::Release_Store(&tail, pos);
+  }
+
+  char* const buffer;
+  const uint32 mask;
+
+  // Positions in the stream of bytes ever written, so the free space is
+  // simply |capacity() - (head - tail)|.  |head| is only written by the
+  // logging thread and |tail| only by whoever drains the ring.
+  base::subtle::Atomic32 head;
+  base::subtle::Atomic32 tail;
+
+  // Messages that didn't fit since the last drain.
+  base::subtle::Atomic32 dropped;
+
+  // Set once the thread has exited, after which the ring is freed as soon as
+  // it has been drained.
+  base::subtle::Atomic32 orphaned;
+
+  // Guarded by |async_rings_lock|.
+  AsyncLogRing* next;
+};
+
+base::subtle::Atomic32 async_logging_enabled = 0;
+base::subtle::Atomic32 async_writer_stop = 0;
+base::subtle::Atomic32 async_dropped_total = 0;
+size_t async_ring_size = 0;
+bool async_ring_key_created = false;
+pthread_key_t async_ring_key;
+pthread_t async_writer;
+
+// Guards |async_rings| and serializes draining and writing out the rings.
+// Logging threads only take it to register their ring.
+pthread_mutex_t async_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+AsyncLogRing* async_rings = NULL;
+
+void OrphanAsyncLogRing(void* ring) {
+  base::subtle::Release_Store(&static_cast<AsyncLogRing*>(ring)->orphaned, 1);
+}
+
+AsyncLogRing* GetAsyncLogRing() {
+  AsyncLogRing* ring =
+      static_cast<AsyncLogRing*>(pthread_getspecific(async_ring_key));
+  if (ring && ring->capacity() == async_ring_size)
+    return ring;
+  // Left over from logging started with another buffer size.
+  if (ring)
+    OrphanAsyncLogRing(ring);
+
+  ring = new AsyncLogRing(async_ring_size);
+  pthread_setspecific(async_ring_key, ring);
+  pthread_mutex_lock(&async_rings_lock);
+  ring->next = async_rings;
+  async_rings = ring;
+  pthread_mutex_unlock(&async_rings_lock);
+  return ring;
+}
+
+// Queues |message| for the writer thread.  Returns false if asynchronous
+// logging is off, in which case the caller has to write the message itself.
+bool PushAsyncLogMessage(const std::string& message) {
+  if (!base::subtle::Acquire_Load(&async_logging_enabled))
+    return false;
+  AsyncLogRing* ring = GetAsyncLogRing();
+  if (!ring->Push(message))
+    base::subtle::NoBarrier_AtomicIncrement(&ring->dropped, 1);
+  return true;
+}
+
+// Writes |batch| to where log messages go, like ~LogMessage() does.
+void WriteAsyncLogBatch(const std::string& batch) {
+  if (logging_destination == LOG_ONLY_TO_SYSTEM_DEBUG_LOG ||
+      logging_destination == LOG_TO_BOTH_FILE_AND_SYSTEM_DEBUG_LOG) {
+    fwrite(batch.data(), 1, batch.size(), stderr);
+    fflush(stderr);
+  }
+
+  if (logging_destination != LOG_NONE &&
+      logging_destination != LOG_ONLY_TO_SYSTEM_DEBUG_LOG) {
+    LoggingLock logging_lock;
+    if (InitializeLogFileHandle()) {
+      fwrite(batch.data(), 1, batch.size(), log_file);
+      fflush(log_file);
+    }
+  }
+}
+
+// Drains every ring into |batch| and writes it out.  Called with
+// |async_rings_lock| held.
+void WriteAsyncLogMessages(std::string* batch) {
+  batch->clear();
+  AsyncLogRing** link = &async_rings;
+  while (AsyncLogRing* ring = *link) {
+    // Check before draining, so that nothing can be pushed in between.
+    bool orphaned = base::subtle::Acquire_Load(&ring->orphaned) != 0;
+    ring->DrainInto(batch);
+
+    int dropped = base::subtle::NoBarrier_AtomicExchange(&ring->dropped, 0);
+    if (dropped) {
+      base::subtle::NoBarrier_AtomicIncrement(&async_dropped_total, dropped);
+      char note[64];
+      snprintf(note, sizeof(note), "[%d log messages dropped]\n", dropped);
+      batch->append(note);
+    }
+
+    if (orphaned) {
+      *link = ring->next;
+      delete ring;
+    } else {
+      link = &ring->next;
+    }
+  }
+  if (!batch->empty())
+    WriteAsyncLogBatch(*batch);
+}
+
+void* AsyncLogWriterMain(void* unused) {
+  std::string batch;
+  for (;;) {
+    bool stopping = base::subtle::Acquire_Load(&async_writer_stop) != 0;
+    pthread_mutex_lock(&async_rings_lock);
+    WriteAsyncLogMessages(&batch);
+    pthread_mutex_unlock(&async_rings_lock);
+    if (stopping)
+      break;
+    if (batch.size() < kAsyncLogBusyBatchSize) {
+      struct timespec delay = { 0, kAsyncLogWriterDelayMs * 1000 * 1000 };
+      while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {}
+    }
+  }
+  return NULL;
+}
+#endif  // defined(OS_POSIX) && !defined(OS_NACL)
+
 bool BaseInitLoggingImpl(const PathChar* new_log_file,
                          LoggingDestination logging_dest,
                          LogLockingState lock_log,
@@ -448,6 +655,64 @@ LogMessageHandlerFunction GetLogMessageHandler() {
   return log_message_handler;
 }
 
+bool StartAsyncLogging(size_t buffer_size) {
+#if defined(OS_POSIX) && !defined(OS_NACL)
+  if (base::subtle::Acquire_Load(&async_logging_enabled))
+    return true;
+
+  // The writer takes the same lock as synchronous logging.
+  LoggingLock::Init(LOCK_LOG_FILE, NULL);
+  if (!async_ring_key_created) {
+    if (pthread_key_create(&async_ring_key, OrphanAsyncLogRing) != 0)
+      return false;
+    async_ring_key_created = true;
+  }
+
+  // Round up to a power of two, so positions can simply be masked.
+  async_ring_size = 256;
+  while (async_ring_size < buffer_size)
+    async_ring_size *= 2;
+
+  base::subtle::Release_Store(&async_writer_stop, 0);
+  if (pthread_create(&async_writer, NULL, AsyncLogWriterMain, NULL) != 0)
+    return false;
+  base::subtle::Release_Store(&async_logging_enabled, 1);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void StopAsyncLogging() {
+#if defined(OS_POSIX) && !defined(OS_NACL)
+  if (!base::subtle::Acquire_Load(&async_logging_enabled))
+    return;
+  base::subtle::Release_Store(&async_logging_enabled, 0);
+  base::subtle::Release_Store(&async_writer_stop, 1);
+  pthread_join(async_writer, NULL);
+  FlushAsyncLogging();
+#endif
+}
+
+void FlushAsyncLogging() {
+#if defined(OS_POSIX) && !defined(OS_NACL)
+  if (!async_ring_key_created)
+    return;
+  std::string batch;
+  pthread_mutex_lock(&async_rings_lock);
+  WriteAsyncLogMessages(&batch);
+  pthread_mutex_unlock(&async_rings_lock);
+#endif
+}
+
+int GetAsyncLoggingDropCount() {
+#if defined(OS_POSIX) && !defined(OS_NACL)
+  return base::subtle::NoBarrier_Load(&async_dropped_total);
+#else
+  return 0;
+#endif
+}
+
 // MSVC doesn't like complex extern templates and DLLs.
 #if !defined(COMPILER_MSVC)
 // Explicit instantiations for commonly used comparisons.
@@ -573,6 +838,17 @@ LogMessage::~LogMessage() {
     return;
   }
 
+#if defined(OS_POSIX) && !defined(OS_NACL)
+  if (severity_ < kAlwaysPrintErrorLevel) {
+    if (PushAsyncLogMessage(str_newline))
+      return;
+  } else {
+    // Keep errors in order with what is queued, and don't lose anything if
+    // this is the last message before a crash.
+    FlushAsyncLogging();
+  }
+#endif
+
   if (logging_destination == LOG_ONLY_TO_SYSTEM_DEBUG_LOG ||
       logging_destination == LOG_TO_BOTH_FILE_AND_SYSTEM_DEBUG_LOG) {
 #if defined(OS_WIN)
@@ -277,6 +277,26 @@ typedef bool (*LogMessageHandlerFunction)(int severity,
 BASE_API void SetLogMessageHandler(LogMessageHandlerFunction handler);
 BASE_API LogMessageHandlerFunction GetLogMessageHandler();
 
+// Moves writing log messages to the log file and stderr onto a background
+// thread, so that logging only costs the calling thread a copy into a ring
+// buffer of its own, |buffer_size| bytes large.  The background thread writes
+// the messages out in batches.  Messages that don't fit are dropped and the
+// drops are noted in the log.  ERROR and above flush the queued messages and
+// are then written synchronously, so nothing is lost before a crash.
+// Returns false if asynchronous logging isn't supported on this platform.
+BASE_API bool StartAsyncLogging(size_t buffer_size);
+
+// Writes out the queued messages and stops the background thread.  Messages
+// logged by other threads while this runs may be lost.
+BASE_API void StopAsyncLogging();
+
+// Writes out the messages queued on all threads.
+BASE_API void FlushAsyncLogging();
+
+// Returns the number of messages dropped since asynchronous logging was first
+// started.
+BASE_API int GetAsyncLoggingDropCount();
+
 typedef int LogSeverity;
 const LogSeverity LOG_VERBOSE = -1;  // This is level 1 verbosity
 // Note: the log severities are used to index into the array of names,
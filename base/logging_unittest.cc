@@ -2,8 +2,17 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <vector>
+
 #include "base/basictypes.h"
+#include "base/file_util.h"
 #include "base/logging.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "base/time.h"
 
 #include "testing/gmock/include/gmock/gmock.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -245,6 +254,192 @@ TEST_F(LoggingTest, DcheckReleaseBehavior) {
   DCHECK_EQ(some_variable, 1) << "test";
 }
 
+#if defined(OS_POSIX)
+// Sends log messages to a file of their own.  Afterwards logging goes to
+// stderr only, the POSIX default, since the previous log file can't be
+// restored.
+class AsyncLoggingTest : public LoggingTest {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    log_path_ = temp_dir_.path().AppendASCII("async.log");
+    ASSERT_TRUE(InitLogging(log_path_.value().c_str(), LOG_ONLY_TO_FILE,
+                            LOCK_LOG_FILE, DELETE_OLD_LOG_FILE,
+                            DISABLE_DCHECK_FOR_NON_OFFICIAL_RELEASE_BUILDS));
+  }
+
+  virtual void TearDown() {
+    RestoreLogging();
+  }
+
+  void RestoreLogging() {
+    StopAsyncLogging();
+    InitLogging(NULL, LOG_ONLY_TO_SYSTEM_DEBUG_LOG, LOCK_LOG_FILE,
+                APPEND_TO_OLD_LOG_FILE,
+                DISABLE_DCHECK_FOR_NON_OFFICIAL_RELEASE_BUILDS);
+  }
+
+  std::string ReadLog() {
+    std::string contents;
+    EXPECT_TRUE(file_util::ReadFileToString(log_path_, &contents));
+    return contents;
+  }
+
+  // Returns the numbers of the "async <tag> <number>" messages in the log,
+  // in the order they appear.
+  std::vector<int> LoggedNumbers(const std::string& tag) {
+    std::vector<int> numbers;
+    std::string log = ReadLog();
+    std::string prefix = "async " + tag + " ";
+    for (size_t pos = log.find(prefix); pos != std::string::npos;
+         pos = log.find(prefix, pos + 1)) {
+      numbers.push_back(atoi(log.c_str() + pos + prefix.size()));
+    }
+    return numbers;
+  }
+
+ private:
+  ScopedTempDir temp_dir_;
+  FilePath log_path_;
+};
+
+// Logs numbered messages.  If |times| is given, the time each message took
+// to log is recorded in it.
+class LoggingThread : public base::DelegateSimpleThread::Delegate {
+ public:
+  LoggingThread(const std::string& tag, int count,
+                std::vector<base::TimeDelta>* times)
+      : tag_(tag), count_(count), times_(times) {
+  }
+
+  virtual void Run() {
+    for (int i = 0; i < count_; ++i) {
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      LOG(INFO) << "async " << tag_ << " " << i
+                << " some payload to make the message a realistic length";
+      if (times_)
+        times_->push_back(base::TimeTicks::HighResNow() - start);
+    }
+  }
+
+ private:
+  std::string tag_;
+  int count_;
+  std::vector<base::TimeDelta>* times_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoggingThread);
+};
+
+TEST_F(AsyncLoggingTest, KeepsOrderPerThread) {
+  ASSERT_TRUE(StartAsyncLogging(1024 * 1024));
+  int dropped = GetAsyncLoggingDropCount();
+
+  const int kThreads = 4;
+  const int kMessages = 1000;
+  std::vector<LoggingThread*> loggers;
+  std::vector<base::DelegateSimpleThread*> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    loggers.push_back(new LoggingThread(base::StringPrintf("t%d", i),
+                                        kMessages, NULL));
+    threads.push_back(new base::DelegateSimpleThread(loggers.back(),
+                                                     "logging"));
+    threads.back()->Start();
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    threads[i]->Join();
+    delete threads[i];
+    delete loggers[i];
+  }
+  StopAsyncLogging();
+
+  EXPECT_EQ(dropped, GetAsyncLoggingDropCount());
+  for (int i = 0; i < kThreads; ++i) {
+    std::vector<int> numbers = LoggedNumbers(base::StringPrintf("t%d", i));
+    ASSERT_EQ(static_cast<size_t>(kMessages), numbers.size());
+    for (int j = 0; j < kMessages; ++j)
+      EXPECT_EQ(j, numbers[j]);
+  }
+}
+
+TEST_F(AsyncLoggingTest, CountsDroppedMessages) {
+  // A ring too small to hold more than a couple of messages.
+  ASSERT_TRUE(StartAsyncLogging(256));
+  int dropped = GetAsyncLoggingDropCount();
+
+  const int kMessages = 1000;
+  LoggingThread logger("drop", kMessages, NULL);
+  base::DelegateSimpleThread thread(&logger, "logging");
+  thread.Start();
+  thread.Join();
+  StopAsyncLogging();
+
+  dropped = GetAsyncLoggingDropCount() - dropped;
+  EXPECT_GT(dropped, 0);
+  EXPECT_EQ(kMessages, static_cast<int>(LoggedNumbers("drop").size()) +
+                       dropped);
+  EXPECT_NE(std::string::npos, ReadLog().find("log messages dropped"));
+}
+
+TEST_F(AsyncLoggingTest, ErrorsFlushQueuedMessages) {
+  ASSERT_TRUE(StartAsyncLogging(64 * 1024));
+  LOG(INFO) << "async flush 1";
+  LOG(ERROR) << "async flush 2";
+  // Both are written by now, in order, without waiting for the writer.
+  std::vector<int> numbers = LoggedNumbers("flush");
+  ASSERT_EQ(2u, numbers.size());
+  EXPECT_EQ(1, numbers[0]);
+  EXPECT_EQ(2, numbers[1]);
+}
+
+// Compares what logging costs the thread doing it, while other threads log
+// too, with and without the async writer.  Run with --v=1 to see the results.
+TEST_F(AsyncLoggingTest, Benchmark) {
+  const int kMessages = 20000;
+  const int kBackgroundThreads = 3;
+  std::string results;
+  for (int async = 0; async < 2; ++async) {
+    if (async)
+      ASSERT_TRUE(StartAsyncLogging(1024 * 1024));
+    int dropped = GetAsyncLoggingDropCount();
+
+    std::vector<LoggingThread*> loggers;
+    std::vector<base::DelegateSimpleThread*> threads;
+    for (int i = 0; i < kBackgroundThreads; ++i) {
+      loggers.push_back(new LoggingThread("background", kMessages, NULL));
+      threads.push_back(new base::DelegateSimpleThread(loggers.back(),
+                                                       "logging"));
+      threads.back()->Start();
+    }
+
+    std::vector<base::TimeDelta> times;
+    times.reserve(kMessages);
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    LoggingThread("io", kMessages, &times).Run();
+    base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+
+    for (int i = 0; i < kBackgroundThreads; ++i) {
+      threads[i]->Join();
+      delete threads[i];
+      delete loggers[i];
+    }
+    StopAsyncLogging();
+
+    std::sort(times.begin(), times.end());
+    results += base::StringPrintf(
+        "%s: %.2f us/message, p99 %d us, max %d us, %d dropped\n",
+        async ? "async" : "sync",
+        static_cast<double>(elapsed.InMicroseconds()) / kMessages,
+        static_cast<int>(times[times.size() * 99 / 100].InMicroseconds()),
+        static_cast<int>(times.back().InMicroseconds()),
+        GetAsyncLoggingDropCount() - dropped);
+  }
+
+  RestoreLogging();
+  VLOG(1) << "Logging from 1 + " << kBackgroundThreads << " threads, "
+          << kMessages << " messages each:\n" << results;
+}
+#endif  // defined(OS_POSIX)
+
 }  // namespace
 
 }  // namespace logging
@@ -23,6 +23,7 @@
 #include "base/md5.h"
 
 #include "base/basictypes.h"
+#include "build/build_config.h"
 
 struct Context {
   uint32 buf[4];
@@ -33,9 +34,14 @@ struct Context {
   };
 };
 
+#if defined(ARCH_CPU_LITTLE_ENDIAN)
 /*
- * Note: this code is harmless on little-endian machines.
+ * The input bytes are already in the order MD5Transform() wants them, so
+ * don't spend a pass over every block converting them.
  */
+static inline void byteReverse(unsigned char *buf, unsigned longs){
+}
+#else
 static void byteReverse(unsigned char *buf, unsigned longs){
         uint32 t;
         do {
@@ -45,6 +51,7 @@ static void byteReverse(unsigned char *buf, unsigned longs){
                 buf += 4;
         } while (--longs);
 }
+#endif
 /* The four core functions - F1 is optimized somewhat */
 
 /* #define F1(x, y, z) (x & y | ~x & z) */
@@ -0,0 +1,78 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/md5.h"
+#include "base/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+TEST(MD5Test, RFC1321) {
+  // Test suite from appendix A.5 of RFC 1321.
+  const struct {
+    const char* input;
+    const char* expected;
+  } kCases[] = {
+    { "", "d41d8cd98f00b204e9800998ecf8427e" },
+    { "a", "0cc175b9c0f1b6a831c399e269772661" },
+    { "abc", "900150983cd24fb0d6963f7d28e17f72" },
+    { "message digest", "f96b697d7cb7938d525a2f31aaf161d0" },
+    { "abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b" },
+    { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+      "d174ab98d277d9f5a5611c2c9f419d9f" },
+    { "1234567890123456789012345678901234567890"
+      "1234567890123456789012345678901234567890",
+      "57edf4a22be3c955ac49da2e2107b67a" },
+  };
+
+  for (size_t i = 0; i < arraysize(kCases); ++i) {
+    MD5Digest digest;
+    MD5Sum(kCases[i].input, strlen(kCases[i].input), &digest);
+    EXPECT_EQ(kCases[i].expected, MD5DigestToBase16(digest));
+  }
+}
+
+TEST(MD5Test, PartialUpdates) {
+  std::string input;
+  for (int i = 0; i < 4096; ++i)
+    input.push_back(static_cast<char>(i * 7));
+  MD5Digest expected;
+  MD5Sum(input.data(), input.size(), &expected);
+
+  const size_t kChunkSizes[] = { 1, 3, 63, 64, 65, 200, 1000 };
+  for (size_t i = 0; i < arraysize(kChunkSizes); ++i) {
+    MD5Context ctx;
+    MD5Init(&ctx);
+    for (size_t offset = 0; offset < input.size(); offset += kChunkSizes[i]) {
+      MD5Update(&ctx, input.data() + offset,
+                std::min(kChunkSizes[i], input.size() - offset));
+    }
+    MD5Digest digest;
+    MD5Final(&digest, &ctx);
+    EXPECT_EQ(MD5DigestToBase16(expected), MD5DigestToBase16(digest))
+        << kChunkSizes[i];
+  }
+}
+
+// Hashes messages from 32 bytes to 16MB. Run with --v=1 to see the
+// throughput.
+TEST(MD5Test, Throughput) {
+  const size_t kBytesPerSize = 16 << 20;
+  const size_t kSizes[] = { 32, 1024, 64 << 10, 1 << 20, 16 << 20 };
+  std::string input(kSizes[arraysize(kSizes) - 1], 'a');
+  MD5Digest digest;
+
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t hashed = 0; hashed < kBytesPerSize; hashed += kSizes[i])
+      MD5Sum(input.data(), kSizes[i], &digest);
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    VLOG(1) << kSizes[i] << " byte messages: "
+            << kBytesPerSize / std::max<int64>(elapsed.InMicroseconds(), 1)
+            << " MB/s";
+  }
+}
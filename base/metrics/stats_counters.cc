@@ -42,24 +42,22 @@ int* StatsCounter::GetPtr() {
     return NULL;
 
   // If counter_id_ is -1, then we haven't looked it up yet.
-  if (counter_id_ == -1) {
+  if (counter_id_ == -1)
     counter_id_ = table->FindCounter(name_);
-    if (table->GetSlot() == 0) {
-      if (!table->RegisterThread("")) {
-        // There is no room for this thread.  This thread
-        // cannot use counters.
-        counter_id_ = 0;
-        return NULL;
-      }
-    }
-  }
 
-  // If counter_id_ is > 0, then we have a valid counter.
-  if (counter_id_ > 0)
-    return table->GetLocation(counter_id_, table->GetSlot());
+  // counter_id_ is zero if the table is full.
+  if (counter_id_ <= 0)
+    return NULL;
 
-  // counter_id_ was zero, which means the table is full.
-  return NULL;
+  // The counter may be used from several threads, each of which needs a
+  // slot of its own.
+  int slot = table->GetSlot();
+  if (!slot && !(slot = table->RegisterThread(""))) {
+    // There is no room for this thread.  This thread
+    // cannot use counters.
+    return NULL;
+  }
+  return table->GetLocation(counter_id_, slot);
 }
 
 
@@ -37,7 +37,9 @@ namespace base {
 // +-------------------------------------------+
 //
 // The data layout is a grid, where the columns are the thread_ids and the
-// rows are the counter_ids.
+// rows are the counter_ids.  The grid is stored column by column, and each
+// column is padded to a whole number of cache lines, so that threads
+// incrementing the same counter don't write to the same cache line.
 //
 // If the first character of the thread_name is '\0', then that column is
 // empty.
@@ -72,7 +74,10 @@ namespace {
 
 // An internal version in case we ever change the format of this
 // file, and so that we can identify our table.
-const int kTableVersion = 0x13131313;
+const int kTableVersion = 0x13131314;
+
+// The size of the cache lines that thread columns are padded to.
+const int kCacheLineSize = 64;
 
 // The name for un-named counters and threads in the table.
 const char kUnknownName[] = "<unknown>";
@@ -86,6 +91,25 @@ inline int AlignedSize(int size) {
   return size + AlignOffset(size);
 }
 
+inline int CacheLineAlignedSize(int size) {
+  return (size + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+}
+
+// The number of ints in a column of the data grid, including the padding.
+inline int ColumnStride(int max_counters) {
+  return CacheLineAlignedSize(max_counters * sizeof(int)) / sizeof(int);
+}
+
+// FNV-1a, for the counter id cache.
+inline uint32 HashCounterName(const std::string& name) {
+  uint32 hash = 2166136261u;
+  for (size_t i = 0; i < name.size(); ++i) {
+    hash ^= static_cast<uint8>(name[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
 }  // namespace
 
 // The StatsTable::Private maintains convenience pointers into the
@@ -130,8 +154,8 @@ class StatsTable::Private {
     return &counter_names_table_[
       (counter_id-1) * (StatsTable::kMaxCounterNameLength)];
   }
-  int* row(int counter_id) const {
-    return &data_table_[(counter_id-1) * max_threads()];
+  int* column(int slot_id) const {
+    return &data_table_[(slot_id-1) * ColumnStride(max_counters())];
   }
 
  private:
@@ -234,8 +258,10 @@ void StatsTable::Private::ComputeMappedPointers(void* memory) {
             max_counters() * StatsTable::kMaxCounterNameLength;
   offset += AlignOffset(offset);
 
+  // The mapping is page aligned, so this aligns the columns to cache lines.
+  offset = CacheLineAlignedSize(offset);
   data_table_ = reinterpret_cast<int*>(data + offset);
-  offset += sizeof(int) * max_threads() * max_counters();
+  offset += sizeof(int) * max_threads() * ColumnStride(max_counters());
 
   DCHECK_EQ(offset, size());
 }
@@ -257,19 +283,33 @@ StatsTable* StatsTable::global_table_ = NULL;
 StatsTable::StatsTable(const std::string& name, int max_threads,
                        int max_counters)
     : impl_(NULL),
+      row_cache_mask_(0),
       tls_index_(SlotReturnFunction) {
   int table_size =
     AlignedSize(sizeof(Private::TableHeader)) +
     AlignedSize((max_counters * sizeof(char) * kMaxCounterNameLength)) +
     AlignedSize((max_threads * sizeof(char) * kMaxThreadNameLength)) +
     AlignedSize(max_threads * sizeof(int)) +
-    AlignedSize(max_threads * sizeof(int)) +
-    AlignedSize((sizeof(int) * (max_counters * max_threads)));
+    AlignedSize(max_threads * sizeof(int));
+  table_size = CacheLineAlignedSize(table_size) +
+    sizeof(int) * max_threads * ColumnStride(max_counters);
 
   impl_ = Private::New(name, table_size, max_threads, max_counters);
 
-  if (!impl_)
+  if (!impl_) {
     PLOG(ERROR) << "StatsTable did not initialize";
+    return;
+  }
+
+  // Size the cache for the table we actually got, which may have been
+  // created by another process, and keep it at most half full.
+  int cache_size = 1;
+  while (cache_size < 2 * impl_->max_counters())
+    cache_size *= 2;
+  row_cache_.reset(new base::subtle::Atomic32[cache_size]);
+  for (int i = 0; i < cache_size; ++i)
+    row_cache_[i] = 0;
+  row_cache_mask_ = cache_size - 1;
 }
 
 StatsTable::~StatsTable() {
@@ -355,6 +395,10 @@ int StatsTable::FindCounter(const std::string& name) {
   if (!impl_)
     return 0;
 
+  int counter_id = FindCachedCounter(name);
+  if (counter_id)
+    return counter_id;
+
   // Create a scope for our auto-lock.
   {
     AutoLock scoped_lock(counters_lock_);
@@ -373,11 +417,11 @@ int StatsTable::FindCounter(const std::string& name) {
 int* StatsTable::GetLocation(int counter_id, int slot_id) const {
   if (!impl_)
     return NULL;
-  if (slot_id > impl_->max_threads())
+  if (slot_id < 1 || slot_id > impl_->max_threads())
     return NULL;
 
-  int* row = impl_->row(counter_id);
-  return &(row[slot_id-1]);
+  int* column = impl_->column(slot_id);
+  return &(column[counter_id-1]);
 }
 
 const char* StatsTable::GetRowName(int index) const {
@@ -396,14 +440,27 @@ int StatsTable::GetRowValue(int index, int pid) const {
     return 0;
 
   int rv = 0;
-  int* row = impl_->row(index);
-  for (int slot_id = 0; slot_id < impl_->max_threads(); slot_id++) {
+  for (int slot_id = 1; slot_id <= impl_->max_threads(); slot_id++) {
     if (pid == 0 || *impl_->thread_pid(slot_id) == pid)
-      rv += row[slot_id];
+      rv += impl_->column(slot_id)[index-1];
   }
   return rv;
 }
 
+void StatsTable::GetRowValues(std::vector<int>* values) const {
+  values->clear();
+  if (!impl_)
+    return;
+
+  int max_counters = impl_->max_counters();
+  values->resize(max_counters);
+  for (int slot_id = 1; slot_id <= impl_->max_threads(); slot_id++) {
+    const int* column = impl_->column(slot_id);
+    for (int index = 0; index < max_counters; index++)
+      (*values)[index] += column[index];
+  }
+}
+
 int StatsTable::GetCounterValue(const std::string& name) {
   return GetCounterValue(name, 0);
 }
@@ -554,11 +611,43 @@ int StatsTable::AddCounter(const std::string& name) {
   {
     AutoLock lock(counters_lock_);
     counters_[name] = counter_id;
+    CacheCounter(name, counter_id);
   }
   return counter_id;
 #endif
 }
 
+int StatsTable::FindCachedCounter(const std::string& name) const {
+  uint32 index = HashCounterName(name);
+  for (int probes = 0; probes <= row_cache_mask_; probes++, index++) {
+    int counter_id =
+        base::subtle::Acquire_Load(&row_cache_[index & row_cache_mask_]);
+    if (!counter_id)
+      return 0;
+    if (!strncmp(impl_->counter_name(counter_id), name.c_str(),
+                 kMaxCounterNameLength))
+      return counter_id;
+  }
+  return 0;
+}
+
+void StatsTable::CacheCounter(const std::string& name, int counter_id) {
+  counters_lock_.AssertAcquired();
+  uint32 index = HashCounterName(name);
+  for (int probes = 0; probes <= row_cache_mask_; probes++, index++) {
+    base::subtle::Atomic32* entry = &row_cache_[index & row_cache_mask_];
+    int cached_id = base::subtle::NoBarrier_Load(entry);
+    if (cached_id == counter_id)
+      return;
+    if (!cached_id) {
+      // Publishes the entry only once the id can be read, together with the
+      // name it points at.
+      base::subtle::Release_Store(entry, counter_id);
+      return;
+    }
+  }
+}
+
 StatsTable::TLSData* StatsTable::GetTLSData() const {
   TLSData* data =
     static_cast<TLSData*>(tls_index_.Get());
@@ -22,10 +22,13 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
+#include "base/atomicops.h"
 #include "base/base_api.h"
 #include "base/basictypes.h"
 #include "base/hash_tables.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/thread_local_storage.h"
 
@@ -103,6 +106,11 @@ class BASE_API StatsTable {
   // Gets the sum of the values for a particular row for a given pid.
   int GetRowValue(int index, int pid) const;
 
+  // Gets the sums of the values of all rows, with the value for row |index|
+  // at |(*values)[index - 1]|.  This reads the table in a single pass, so it
+  // is much cheaper than calling GetRowValue() for every row.
+  void GetRowValues(std::vector<int>* values) const;
+
   // Gets the sum of the values for a particular counter.  If the counter
   // does not exist, creates the counter.
   int GetCounterValue(const std::string& name);
@@ -159,6 +167,13 @@ class BASE_API StatsTable {
   // shared_memory_lock when calling this function.
   int FindCounterOrEmptyRow(const std::string& name) const;
 
+  // Looks |name| up in |row_cache_|.  Returns 0 if it isn't there.
+  int FindCachedCounter(const std::string& name) const;
+
+  // Adds |counter_id| to |row_cache_|.  The caller must hold
+  // counters_lock_.
+  void CacheCounter(const std::string& name, int counter_id);
+
   // Internal function to add a counter to the StatsTable.  Assumes that
   // the counter does not already exist in the table.
   //
@@ -184,6 +199,13 @@ class BASE_API StatsTable {
   // we don't have a counter in our hash table, another process may
   // have created it.
   CountersMap counters_;
+
+  // Counter ids by hash of their name, with open addressing, so that looking
+  // up a known counter takes no lock.  Entries are only ever added (under
+  // counters_lock_), and are checked against the name in the table.
+  scoped_array<base::subtle::Atomic32> row_cache_;
+  int row_cache_mask_;
+
   ThreadLocalStorage::Slot tls_index_;
 
   static StatsTable* global_table_;
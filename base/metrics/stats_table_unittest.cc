@@ -2,11 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "base/logging.h"
 #include "base/metrics/stats_counters.h"
 #include "base/metrics/stats_table.h"
+#include "base/process_util.h"
 #include "base/shared_memory.h"
 #include "base/string_piece.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
 #include "base/test/multiprocess_test.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/simple_thread.h"
@@ -290,6 +293,96 @@ TEST_F(StatsTableTest, StatsCounter) {
   DeleteShmem(kTableName);
 }
 
+// Increments a counter, which may be shared with other threads.
+class CounterIncrementThread : public SimpleThread {
+ public:
+  CounterIncrementThread(StatsCounter* counter, int count)
+      : SimpleThread("CounterIncrementThread"),
+        counter_(counter),
+        count_(count) {}
+
+  virtual void Run() {
+    for (int index = 0; index < count_; index++)
+      counter_->Increment();
+  }
+
+ private:
+  StatsCounter* counter_;
+  int count_;
+};
+
+// A StatsCounter can be shared by threads, each of which writes to its own
+// slot.
+TEST_F(StatsTableTest, SharedStatsCounter) {
+  const std::string kTableName = "SharedCounterStatTable";
+  const int kMaxThreads = 8;
+  const int kMaxCounter = 5;
+  const int kThreads = 4;
+  const int kIncrements = 1000;
+  DeleteShmem(kTableName);
+  StatsTable table(kTableName, kMaxThreads, kMaxCounter);
+  StatsTable::set_current(&table);
+
+  StatsCounter counter("shared");
+  CounterIncrementThread* threads[kThreads];
+  for (int index = 0; index < kThreads; index++) {
+    threads[index] = new CounterIncrementThread(&counter, kIncrements);
+    threads[index]->Start();
+  }
+  for (int index = 0; index < kThreads; index++) {
+    threads[index]->Join();
+    delete threads[index];
+  }
+
+  EXPECT_EQ(kThreads * kIncrements, table.GetCounterValue("c:shared"));
+  EXPECT_EQ(kThreads * kIncrements,
+            table.GetCounterValue("c:shared", GetCurrentProcId()));
+
+  std::vector<int> values;
+  table.GetRowValues(&values);
+  ASSERT_EQ(static_cast<size_t>(kMaxCounter), values.size());
+  EXPECT_EQ(kThreads * kIncrements, values[table.FindCounter("c:shared") - 1]);
+
+  DeleteShmem(kTableName);
+}
+
+// Measures what an increment costs as more threads increment the same
+// counter.  Run with --v=1 to see the results.
+TEST_F(StatsTableTest, IncrementBenchmark) {
+  const std::string kTableName = "IncrementBenchmarkStatTable";
+  const int kMaxThreads = 64;
+  const int kMaxCounter = 8;
+  const int kIncrements = 200000;
+  DeleteShmem(kTableName);
+  StatsTable table(kTableName, kMaxThreads, kMaxCounter);
+  StatsTable::set_current(&table);
+
+  for (int num_threads = 1; num_threads <= 32; num_threads *= 2) {
+    std::string name = StringPrintf("bench%d", num_threads);
+    StatsCounter counter(name);
+    std::vector<CounterIncrementThread*> threads;
+    TimeTicks start = TimeTicks::Now();
+    for (int index = 0; index < num_threads; index++) {
+      threads.push_back(new CounterIncrementThread(&counter, kIncrements));
+      threads.back()->Start();
+    }
+    for (int index = 0; index < num_threads; index++) {
+      threads[index]->Join();
+      delete threads[index];
+    }
+    TimeDelta elapsed = TimeTicks::Now() - start;
+
+    EXPECT_EQ(num_threads * kIncrements, table.GetCounterValue("c:" + name));
+    VLOG(1) << num_threads << " threads: "
+            << elapsed.InMicroseconds() * 1000.0 / kIncrements / num_threads
+            << " ns per increment, "
+            << elapsed.InMicroseconds() * 1000.0 / kIncrements
+            << " ns per increment per thread";
+  }
+
+  DeleteShmem(kTableName);
+}
+
 class MockStatsCounterTimer : public StatsCounterTimer {
  public:
   explicit MockStatsCounterTimer(const std::string& name)
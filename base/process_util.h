@@ -628,9 +628,35 @@ class BASE_API ProcessMetrics {
   int last_cpu_;
 #endif  // defined(OS_MACOSX)
 
+#if defined(OS_LINUX)
+  // The /proc/<pid> files read by the methods above, opened on first use and
+  // kept open, so that sampling the same process again only costs a pread().
+  // They also stay tied to |process_| if its pid is reused.  -1 when not
+  // opened yet or when opening failed.
+  mutable int stat_fd_;
+  mutable int smaps_fd_;
+  mutable int statm_fd_;
+
+  // Reads the thread group's fields of /proc/<pid>/stat, up to and including
+  // the resident set size.  Returns false if they could not be read.
+  bool ReadProcStats(int64* fields) const;
+#endif  // defined(OS_LINUX)
+
   DISALLOW_COPY_AND_ASSIGN(ProcessMetrics);
 };
 
+#if defined(OS_LINUX)
+// Fills |usages| with the working set of each of |processes|, as
+// ProcessMetrics::GetWorkingSetKBytes() would, without creating a
+// ProcessMetrics for each.  Meant for one-off sweeps over many processes such
+// as about:memory; keep ProcessMetrics around to sample the same processes
+// repeatedly.  Processes that cannot be read get zeroed entries.  Returns the
+// number of processes that could be read.
+BASE_API size_t GetWorkingSetKBytesForProcesses(
+    const std::vector<ProcessHandle>& processes,
+    std::vector<WorkingSetKBytes>* usages);
+#endif  // defined(OS_LINUX)
+
 // Returns the memory commited by the system in KBytes.
 // Returns 0 if it can't compute the commit charge.
 BASE_API size_t GetSystemCommitCharge();
@@ -9,44 +9,25 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "base/eintr_wrapper.h"
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/string_number_conversions.h"
 #include "base/string_split.h"
-#include "base/string_tokenizer.h"
 #include "base/string_util.h"
 #include "base/sys_info.h"
 #include "base/threading/thread_restrictions.h"
 
 namespace {
 
-enum ParsingState {
-  KEY_NAME,
-  KEY_VALUE
-};
-
-// Reads /proc/<pid>/stat and populates |proc_stats| with the values split by
-// spaces. Returns true if successful.
-bool GetProcStats(pid_t pid, std::vector<std::string>* proc_stats) {
-  // Synchronously reading files in /proc is safe.
-  base::ThreadRestrictions::ScopedAllowIO allow_io;
-
-  FilePath stat_file("/proc");
-  stat_file = stat_file.Append(base::IntToString(pid));
-  stat_file = stat_file.Append("stat");
-  std::string mem_stats;
-  if (!file_util::ReadFileToString(stat_file, &mem_stats))
-    return false;
-  base::SplitString(mem_stats, ' ', proc_stats);
-  return true;
-}
-
 // Reads /proc/<pid>/cmdline and populates |proc_cmd_line_args| with the command
 // line arguments. Returns true if successful.
 // Note: /proc/<pid>/cmdline contains command line arguments separated by single
@@ -68,76 +49,302 @@ bool GetProcCmdline(pid_t pid, std::vector<std::string>* proc_cmd_line_args) {
   return true;
 }
 
-// Get the total CPU of a single process.  Return value is number of jiffies
-// on success or -1 on error.
-int GetProcessCPU(pid_t pid) {
+// Indices of the /proc/<pid>/stat fields used below, as listed in proc(5)
+// less one.
+enum ProcStatsFields {
+  VM_UTIME = 13,  // Time spent in user mode, in jiffies.
+  VM_STIME = 14,  // Time spent in kernel mode, in jiffies.
+  VM_VSIZE = 22,  // Virtual memory size, in bytes.
+  VM_RSS = 23,    // Resident set size, in pages.
+  VM_NUM_FIELDS
+};
+
+// /proc/<pid>/stat fits in here up to and including VM_RSS.
+const size_t kProcStatBufferSize = 1024;
+
+// Buffer through which /proc/<pid>/smaps is scanned a few lines at a time.
+const size_t kSmapsBufferSize = 4096;
+
+// Opens /proc/<pid>/<name> for reading.  The descriptor may be kept open for
+// a long time, so it is not passed on to child processes.  Returns -1 on
+// failure.
+int OpenProcFile(pid_t pid, const char* name) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+  return HANDLE_EINTR(open(path, O_RDONLY | O_CLOEXEC));
+}
+
+void CloseProcFile(int* fd) {
+  if (*fd < 0)
+    return;
+  if (HANDLE_EINTR(close(*fd)) < 0)
+    PLOG(ERROR) << "close";
+  *fd = -1;
+}
+
+// Reads the /proc file open as |fd| from the start into |buffer|, filling it
+// if the file is larger.  /proc regenerates the contents on each read from
+// offset 0, so the same descriptor can be read again for a fresh sample.
+// Returns the number of bytes read, or -1 on failure.
+ssize_t ReadProcFile(int fd, char* buffer, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    ssize_t bytes = HANDLE_EINTR(pread(fd, buffer + total, size - total,
+                                       total));
+    if (bytes < 0)
+      return -1;
+    if (bytes == 0)
+      break;
+    total += bytes;
+  }
+  return total;
+}
+
+// Parses the decimal number, possibly negative, starting at |*p| and leaves
+// |*p| past it.  Stops at the first character that is not a digit.
+int64 ScanNumber(const char** p, const char* end) {
+  bool negative = false;
+  if (*p != end && **p == '-') {
+    negative = true;
+    ++*p;
+  }
+  uint64 value = 0;
+  for (; *p != end && **p >= '0' && **p <= '9'; ++*p)
+    value = value * 10 + (**p - '0');
+  return negative ? -static_cast<int64>(value) : static_cast<int64>(value);
+}
+
+// Reads /proc/<pid>/<name>, a file of "Key:  value" lines such as status or
+// io, and stores the number following each of the |num_keys| |keys| in
+// |values|.  Values of keys that are not found are left alone.  Returns false
+// if the file could not be read.
+bool ReadProcKeyValues(pid_t pid, const char* name, const char* const* keys,
+                       int64* values, size_t num_keys) {
   // Synchronously reading files in /proc is safe.
   base::ThreadRestrictions::ScopedAllowIO allow_io;
 
-  // Use /proc/<pid>/task to find all threads and parse their /stat file.
-  FilePath path = FilePath(StringPrintf("/proc/%d/task/", pid));
+  int fd = OpenProcFile(pid, name);
+  if (fd < 0)
+    return false;
+  // The keys used here come early in the file.
+  char buffer[4096];
+  ssize_t length = ReadProcFile(fd, buffer, sizeof(buffer));
+  CloseProcFile(&fd);
+  if (length <= 0)
+    return false;
 
-  DIR* dir = opendir(path.value().c_str());
-  if (!dir) {
-    PLOG(ERROR) << "opendir(" << path.value() << ")";
-    return -1;
+  const char* end = buffer + length;
+  for (const char* line = buffer; line < end;) {
+    const char* eol = static_cast<const char*>(memchr(line, '\n', end - line));
+    if (!eol)
+      eol = end;
+    const char* colon =
+        static_cast<const char*>(memchr(line, ':', eol - line));
+    if (colon) {
+      size_t key_length = colon - line;
+      for (size_t i = 0; i < num_keys; ++i) {
+        if (strlen(keys[i]) != key_length ||
+            memcmp(line, keys[i], key_length) != 0)
+          continue;
+        const char* p = colon + 1;
+        while (p != eol && (*p == ' ' || *p == '\t'))
+          ++p;
+        values[i] = ScanNumber(&p, eol);
+        break;
+      }
+    }
+    line = eol + 1;
   }
+  return true;
+}
 
-  int total_cpu = 0;
-  while (struct dirent* ent = readdir(dir)) {
-    if (ent->d_name[0] == '.')
-      continue;
+// Scans the contents of /proc/<pid>/stat in |data| into the first
+// |num_fields| entries of |fields|, indexed like ProcStatsFields.  The name
+// and the state, which are not numbers, are stored as 0.  The name is in
+// parens and may itself contain spaces and parens, so the fields following it
+// are found from the last ')'.  Returns false if there are fewer fields.
+bool ScanProcStats(const char* data, size_t length, int64* fields,
+                   size_t num_fields) {
+  const char* end = data + length;
+  const char* p = end;
+  while (p != data && p[-1] != ')')
+    --p;
+  if (p == data)
+    return false;
 
-    FilePath stat_path = path.AppendASCII(ent->d_name).AppendASCII("stat");
-    std::string stat;
-    if (file_util::ReadFileToString(stat_path, &stat)) {
-      int cpu = base::ParseProcStatCPU(stat);
-      if (cpu > 0)
-        total_cpu += cpu;
+  const char* pid = data;
+  fields[0] = ScanNumber(&pid, end);
+  if (num_fields > 1)
+    fields[1] = 0;
+  if (num_fields > 2) {
+    // The state is a single letter.
+    if (end - p < 2 || p[0] != ' ')
+      return false;
+    p += 2;
+    fields[2] = 0;
+  }
+  for (size_t i = 3; i < num_fields; ++i) {
+    if (p == end || *p != ' ')
+      return false;
+    ++p;
+    const char* start = p;
+    fields[i] = ScanNumber(&p, end);
+    if (p == start)
+      return false;
+  }
+  return true;
+}
+
+// Compares the start of the line at |line| with |prefix|.
+bool LineStartsWith(const char* line, const char* end, const char* prefix,
+                    size_t prefix_length) {
+  return static_cast<size_t>(end - line) >= prefix_length &&
+         memcmp(line, prefix, prefix_length) == 0;
+}
+
+// Adds the value of a "Key:   123 kB" line of /proc/<pid>/smaps to the
+// matching total.
+void ScanSmapsLine(const char* line, const char* end, int* private_kb,
+                   int* pss_kb, bool* have_pss) {
+  static const char kPrivatePrefix[] = "Private_";
+  static const char kPssPrefix[] = "Pss:";
+  int* total;
+  if (LineStartsWith(line, end, kPrivatePrefix, sizeof(kPrivatePrefix) - 1)) {
+    total = private_kb;
+  } else if (LineStartsWith(line, end, kPssPrefix, sizeof(kPssPrefix) - 1)) {
+    *have_pss = true;
+    total = pss_kb;
+  } else {
+    return;
+  }
+  const char* p = static_cast<const char*>(memchr(line, ':', end - line));
+  if (!p)
+    return;
+  ++p;
+  while (p != end && *p == ' ')
+    ++p;
+  *total += ScanNumber(&p, end);
+}
+
+// Sums the private and proportional set sizes listed in the
+// /proc/<pid>/smaps open as |fd|.  smaps can run to hundreds of kilobytes, so
+// it is read through a fixed buffer rather than into one string.  Returns
+// false if it could not be read or is empty, as it is for processes in the
+// SUID sandbox.
+bool ScanSmaps(int fd, base::WorkingSetKBytes* ws_usage) {
+  char buffer[kSmapsBufferSize];
+  int private_kb = 0;
+  int pss_kb = 0;
+  bool have_pss = false;
+  off_t offset = 0;
+  // Bytes of an incomplete line kept at the start of |buffer|.
+  size_t kept = 0;
+  // Whether the start of the current line did not fit in |buffer|.  Only the
+  // mapping headers can be that long, and they are not needed.
+  bool skipping = false;
+  for (;;) {
+    ssize_t bytes = HANDLE_EINTR(pread(fd, buffer + kept,
+                                       sizeof(buffer) - kept, offset));
+    if (bytes < 0)
+      return false;
+    if (bytes == 0)
+      break;
+    offset += bytes;
+
+    const char* line = buffer;
+    const char* end = buffer + kept + bytes;
+    while (const char* eol = static_cast<const char*>(
+               memchr(line, '\n', end - line))) {
+      if (!skipping)
+        ScanSmapsLine(line, eol, &private_kb, &pss_kb, &have_pss);
+      skipping = false;
+      line = eol + 1;
+    }
+    kept = end - line;
+    if (kept == sizeof(buffer)) {
+      skipping = true;
+      kept = 0;
+    } else {
+      memmove(buffer, line, kept);
     }
   }
-  closedir(dir);
+  if (offset == 0)
+    return false;
 
-  return total_cpu;
+  ws_usage->priv = private_kb;
+  ws_usage->shared = have_pss ? pss_kb : 0;
+  return true;
 }
 
-}  // namespace
+// Estimates the private set size from the /proc/<pid>/statm open as |fd|, for
+// when smaps is not available.
+bool ScanStatm(int fd, base::WorkingSetKBytes* ws_usage) {
+  int page_size_kb = sysconf(_SC_PAGE_SIZE) / 1024;
+  if (page_size_kb <= 0)
+    return false;
 
-namespace base {
+  char buffer[256];
+  ssize_t length = ReadProcFile(fd, buffer, sizeof(buffer));
+  if (length <= 0)
+    return false;
 
-ProcessId GetParentProcessId(ProcessHandle process) {
+  // size resident shared text lib data dt, all in pages.
+  const size_t kStatmFields = 7;
+  int64 statm[kStatmFields];
+  const char* p = buffer;
+  const char* end = buffer + length;
+  for (size_t i = 0; i < kStatmFields; ++i) {
+    if (i > 0) {
+      if (p == end || *p != ' ')
+        return false;  // Not the format we expect.
+      ++p;
+    }
+    const char* start = p;
+    statm[i] = ScanNumber(&p, end);
+    if (p == start)
+      return false;
+  }
+
+  ws_usage->priv = (statm[1] - statm[2]) * page_size_kb;
+  ws_usage->shared = 0;
+  return true;
+}
+
+// Private and Shared working set sizes are obtained from /proc/<pid>/smaps.
+// When that's not available, use the values from /proc<pid>/statm as a
+// close approximation.
+// See http://www.pixelbeat.org/scripts/ps_mem.py
+// |smaps_fd| and |statm_fd| are opened for |pid| if they are -1.
+bool ReadWorkingSetKBytes(pid_t pid, int* smaps_fd, int* statm_fd,
+                          base::WorkingSetKBytes* ws_usage) {
   // Synchronously reading files in /proc is safe.
   base::ThreadRestrictions::ScopedAllowIO allow_io;
 
-  FilePath stat_file("/proc");
-  stat_file = stat_file.Append(base::IntToString(process));
-  stat_file = stat_file.Append("status");
-  std::string status;
-  if (!file_util::ReadFileToString(stat_file, &status))
-    return -1;
+  // Sharable is not calculated, as it does not provide interesting data.
+  ws_usage->shareable = 0;
 
-  StringTokenizer tokenizer(status, ":\n");
-  ParsingState state = KEY_NAME;
-  std::string last_key_name;
-  while (tokenizer.GetNext()) {
-    switch (state) {
-      case KEY_NAME:
-        last_key_name = tokenizer.token();
-        state = KEY_VALUE;
-        break;
-      case KEY_VALUE:
-        DCHECK(!last_key_name.empty());
-        if (last_key_name == "PPid") {
-          int ppid;
-          base::StringToInt(tokenizer.token(), &ppid);
-          return ppid;
-        }
-        state = KEY_NAME;
-        break;
-    }
-  }
-  NOTREACHED();
-  return -1;
+  if (*smaps_fd < 0)
+    *smaps_fd = OpenProcFile(pid, "smaps");
+  if (*smaps_fd >= 0 && ScanSmaps(*smaps_fd, ws_usage))
+    return true;
+
+  // Try statm if smaps is empty because of the SUID sandbox.
+  if (*statm_fd < 0)
+    *statm_fd = OpenProcFile(pid, "statm");
+  return *statm_fd >= 0 && ScanStatm(*statm_fd, ws_usage);
+}
+
+}  // namespace
+
+namespace base {
+
+ProcessId GetParentProcessId(ProcessHandle process) {
+  static const char* const kKeys[] = { "PPid" };
+  int64 ppid = -1;
+  if (!ReadProcKeyValues(process, "status", kKeys, &ppid, arraysize(kKeys)))
+    return -1;
+  DCHECK_NE(-1, ppid);
+  return ppid;
 }
 
 FilePath GetProcessExecutablePath(ProcessHandle process) {
@@ -264,60 +471,42 @@ ProcessMetrics* ProcessMetrics::CreateProcessMetrics(ProcessHandle process) {
   return new ProcessMetrics(process);
 }
 
+ProcessMetrics::~ProcessMetrics() {
+  CloseProcFile(&stat_fd_);
+  CloseProcFile(&smaps_fd_);
+  CloseProcFile(&statm_fd_);
+}
+
 // On linux, we return vsize.
 size_t ProcessMetrics::GetPagefileUsage() const {
-  std::vector<std::string> proc_stats;
-  if (!GetProcStats(process_, &proc_stats))
-    LOG(WARNING) << "Failed to get process stats.";
-  const size_t kVmSize = 22;
-  if (proc_stats.size() > kVmSize) {
-    int vm_size;
-    base::StringToInt(proc_stats[kVmSize], &vm_size);
-    return static_cast<size_t>(vm_size);
-  }
-  return 0;
+  int64 proc_stats[VM_NUM_FIELDS];
+  if (!ReadProcStats(proc_stats))
+    return 0;
+  return static_cast<size_t>(proc_stats[VM_VSIZE]);
 }
 
 // On linux, we return the high water mark of vsize.
 size_t ProcessMetrics::GetPeakPagefileUsage() const {
-  std::vector<std::string> proc_stats;
-  if (!GetProcStats(process_, &proc_stats))
-    LOG(WARNING) << "Failed to get process stats.";
-  const size_t kVmPeak = 21;
-  if (proc_stats.size() > kVmPeak) {
-    int vm_peak;
-    if (base::StringToInt(proc_stats[kVmPeak], &vm_peak))
-      return vm_peak;
-  }
-  return 0;
+  static const char* const kKeys[] = { "VmPeak" };
+  int64 vm_peak_kb = 0;
+  ReadProcKeyValues(process_, "status", kKeys, &vm_peak_kb, arraysize(kKeys));
+  return static_cast<size_t>(vm_peak_kb) * 1024;
 }
 
 // On linux, we return RSS.
 size_t ProcessMetrics::GetWorkingSetSize() const {
-  std::vector<std::string> proc_stats;
-  if (!GetProcStats(process_, &proc_stats))
-    LOG(WARNING) << "Failed to get process stats.";
-  const size_t kVmRss = 23;
-  if (proc_stats.size() > kVmRss) {
-    int num_pages;
-    if (base::StringToInt(proc_stats[kVmRss], &num_pages))
-      return static_cast<size_t>(num_pages) * getpagesize();
-  }
-  return 0;
+  int64 proc_stats[VM_NUM_FIELDS];
+  if (!ReadProcStats(proc_stats))
+    return 0;
+  return static_cast<size_t>(proc_stats[VM_RSS]) * getpagesize();
 }
 
 // On linux, we return the high water mark of RSS.
 size_t ProcessMetrics::GetPeakWorkingSetSize() const {
-  std::vector<std::string> proc_stats;
-  if (!GetProcStats(process_, &proc_stats))
-    LOG(WARNING) << "Failed to get process stats.";
-  const size_t kVmHwm = 23;
-  if (proc_stats.size() > kVmHwm) {
-    int num_pages;
-    base::StringToInt(proc_stats[kVmHwm], &num_pages);
-    return static_cast<size_t>(num_pages) * getpagesize();
-  }
-  return 0;
+  static const char* const kKeys[] = { "VmHWM" };
+  int64 vm_hwm_kb = 0;
+  ReadProcKeyValues(process_, "status", kKeys, &vm_hwm_kb, arraysize(kKeys));
+  return static_cast<size_t>(vm_hwm_kb) * 1024;
 }
 
 bool ProcessMetrics::GetMemoryBytes(size_t* private_bytes,
@@ -335,93 +524,8 @@ bool ProcessMetrics::GetMemoryBytes(size_t* private_bytes,
   return true;
 }
 
-// Private and Shared working set sizes are obtained from /proc/<pid>/smaps.
-// When that's not available, use the values from /proc<pid>/statm as a
-// close approximation.
-// See http://www.pixelbeat.org/scripts/ps_mem.py
 bool ProcessMetrics::GetWorkingSetKBytes(WorkingSetKBytes* ws_usage) const {
-  // Synchronously reading files in /proc is safe.
-  base::ThreadRestrictions::ScopedAllowIO allow_io;
-
-  FilePath proc_dir = FilePath("/proc").Append(base::IntToString(process_));
-  std::string smaps;
-  int private_kb = 0;
-  int pss_kb = 0;
-  bool have_pss = false;
-  bool ret;
-
-  {
-    FilePath smaps_file = proc_dir.Append("smaps");
-    // Synchronously reading files in /proc is safe.
-    base::ThreadRestrictions::ScopedAllowIO allow_io;
-    ret = file_util::ReadFileToString(smaps_file, &smaps);
-  }
-  if (ret && smaps.length() > 0) {
-    const std::string private_prefix = "Private_";
-    const std::string pss_prefix = "Pss";
-    StringTokenizer tokenizer(smaps, ":\n");
-    StringPiece last_key_name;
-    ParsingState state = KEY_NAME;
-    while (tokenizer.GetNext()) {
-      switch (state) {
-        case KEY_NAME:
-          last_key_name = tokenizer.token_piece();
-          state = KEY_VALUE;
-          break;
-        case KEY_VALUE:
-          if (last_key_name.empty()) {
-            NOTREACHED();
-            return false;
-          }
-          if (last_key_name.starts_with(private_prefix)) {
-            int cur;
-            base::StringToInt(tokenizer.token(), &cur);
-            private_kb += cur;
-          } else if (last_key_name.starts_with(pss_prefix)) {
-            have_pss = true;
-            int cur;
-            base::StringToInt(tokenizer.token(), &cur);
-            pss_kb += cur;
-          }
-          state = KEY_NAME;
-          break;
-      }
-    }
-  } else {
-    // Try statm if smaps is empty because of the SUID sandbox.
-    // First we need to get the page size though.
-    int page_size_kb = sysconf(_SC_PAGE_SIZE) / 1024;
-    if (page_size_kb <= 0)
-      return false;
-
-    std::string statm;
-    {
-      FilePath statm_file = proc_dir.Append("statm");
-      // Synchronously reading files in /proc is safe.
-      base::ThreadRestrictions::ScopedAllowIO allow_io;
-      ret = file_util::ReadFileToString(statm_file, &statm);
-    }
-    if (!ret || statm.length() == 0)
-      return false;
-
-    std::vector<std::string> statm_vec;
-    base::SplitString(statm, ' ', &statm_vec);
-    if (statm_vec.size() != 7)
-      return false;  // Not the format we expect.
-
-    int statm1, statm2;
-    base::StringToInt(statm_vec[1], &statm1);
-    base::StringToInt(statm_vec[2], &statm2);
-    private_kb = (statm1 - statm2) * page_size_kb;
-  }
-  ws_usage->priv = private_kb;
-  // Sharable is not calculated, as it does not provide interesting data.
-  ws_usage->shareable = 0;
-
-  ws_usage->shared = 0;
-  if (have_pss)
-    ws_usage->shared = pss_kb;
-  return true;
+  return ReadWorkingSetKBytes(process_, &smaps_fd_, &statm_fd_, ws_usage);
 }
 
 double ProcessMetrics::GetCPUUsage() {
@@ -441,10 +545,17 @@ double ProcessMetrics::GetCPUUsage() {
     return 0;
   int64 time = TimeValToMicroseconds(now);
 
+  // The thread group's times in /proc/<pid>/stat include those of all its
+  // threads, past and present.
+  int64 proc_stats[VM_NUM_FIELDS];
+  int cpu = -1;
+  if (ReadProcStats(proc_stats))
+    cpu = proc_stats[VM_UTIME] + proc_stats[VM_STIME];
+
   if (last_time_ == 0) {
     // First call, just set the last values.
     last_time_ = time;
-    last_cpu_ = GetProcessCPU(process_);
+    last_cpu_ = cpu;
     return 0;
   }
 
@@ -453,8 +564,6 @@ double ProcessMetrics::GetCPUUsage() {
   if (time_delta == 0)
     return 0;
 
-  int cpu = GetProcessCPU(process_);
-
   // We have the number of jiffies in the time period.  Convert to percentage.
   // Note this means we will go *over* 100 in the case where multiple threads
   // are together adding to more than one CPU's worth.
@@ -470,47 +579,17 @@ double ProcessMetrics::GetCPUUsage() {
 // To have /proc/self/io file you must enable CONFIG_TASK_IO_ACCOUNTING
 // in your kernel configuration.
 bool ProcessMetrics::GetIOCounters(IoCounters* io_counters) const {
-  // Synchronously reading files in /proc is safe.
-  base::ThreadRestrictions::ScopedAllowIO allow_io;
-
-  std::string proc_io_contents;
-  FilePath io_file("/proc");
-  io_file = io_file.Append(base::IntToString(process_));
-  io_file = io_file.Append("io");
-  if (!file_util::ReadFileToString(io_file, &proc_io_contents))
+  static const char* const kKeys[] = { "syscr", "syscw", "rchar", "wchar" };
+  int64 values[arraysize(kKeys)] = { 0 };
+  if (!ReadProcKeyValues(process_, "io", kKeys, values, arraysize(kKeys)))
     return false;
 
-  (*io_counters).OtherOperationCount = 0;
-  (*io_counters).OtherTransferCount = 0;
-
-  StringTokenizer tokenizer(proc_io_contents, ": \n");
-  ParsingState state = KEY_NAME;
-  std::string last_key_name;
-  while (tokenizer.GetNext()) {
-    switch (state) {
-      case KEY_NAME:
-        last_key_name = tokenizer.token();
-        state = KEY_VALUE;
-        break;
-      case KEY_VALUE:
-        DCHECK(!last_key_name.empty());
-        if (last_key_name == "syscr") {
-          base::StringToInt64(tokenizer.token(),
-              reinterpret_cast<int64*>(&(*io_counters).ReadOperationCount));
-        } else if (last_key_name == "syscw") {
-          base::StringToInt64(tokenizer.token(),
-              reinterpret_cast<int64*>(&(*io_counters).WriteOperationCount));
-        } else if (last_key_name == "rchar") {
-          base::StringToInt64(tokenizer.token(),
-              reinterpret_cast<int64*>(&(*io_counters).ReadTransferCount));
-        } else if (last_key_name == "wchar") {
-          base::StringToInt64(tokenizer.token(),
-              reinterpret_cast<int64*>(&(*io_counters).WriteTransferCount));
-        }
-        state = KEY_NAME;
-        break;
-    }
-  }
+  io_counters->ReadOperationCount = values[0];
+  io_counters->WriteOperationCount = values[1];
+  io_counters->OtherOperationCount = 0;
+  io_counters->ReadTransferCount = values[2];
+  io_counters->WriteTransferCount = values[3];
+  io_counters->OtherTransferCount = 0;
   return true;
 }
 
@@ -518,31 +597,56 @@ ProcessMetrics::ProcessMetrics(ProcessHandle process)
     : process_(process),
       last_time_(0),
       last_system_time_(0),
-      last_cpu_(0) {
+      last_cpu_(0),
+      stat_fd_(-1),
+      smaps_fd_(-1),
+      statm_fd_(-1) {
   processor_count_ = base::SysInfo::NumberOfProcessors();
 }
 
+bool ProcessMetrics::ReadProcStats(int64* fields) const {
+  // Synchronously reading files in /proc is safe.
+  base::ThreadRestrictions::ScopedAllowIO allow_io;
+
+  if (stat_fd_ < 0)
+    stat_fd_ = OpenProcFile(process_, "stat");
+  char buffer[kProcStatBufferSize];
+  ssize_t length = -1;
+  if (stat_fd_ >= 0)
+    length = ReadProcFile(stat_fd_, buffer, sizeof(buffer));
+  if (length <= 0 || !ScanProcStats(buffer, length, fields, VM_NUM_FIELDS)) {
+    LOG(WARNING) << "Failed to get process stats.";
+    return false;
+  }
+  return true;
+}
+
+size_t GetWorkingSetKBytesForProcesses(
+    const std::vector<ProcessHandle>& processes,
+    std::vector<WorkingSetKBytes>* usages) {
+  usages->assign(processes.size(), WorkingSetKBytes());
+  size_t read = 0;
+  for (size_t i = 0; i < processes.size(); ++i) {
+    int smaps_fd = -1;
+    int statm_fd = -1;
+    if (ReadWorkingSetKBytes(processes[i], &smaps_fd, &statm_fd,
+                             &(*usages)[i])) {
+      ++read;
+    } else {
+      (*usages)[i] = WorkingSetKBytes();
+    }
+    CloseProcFile(&smaps_fd);
+    CloseProcFile(&statm_fd);
+  }
+  return read;
+}
 
 // Exposed for testing.
 int ParseProcStatCPU(const std::string& input) {
-  // /proc/<pid>/stat contains the process name in parens.  In case the
-  // process name itself contains parens, skip past them.
-  std::string::size_type rparen = input.rfind(')');
-  if (rparen == std::string::npos)
-    return -1;
-
-  // From here, we expect a bunch of space-separated fields, where the
-  // 0-indexed 11th and 12th are utime and stime.  On two different machines
-  // I found 42 and 39 fields, so let's just expect the ones we need.
-  std::vector<std::string> fields;
-  base::SplitString(input.substr(rparen + 2), ' ', &fields);
-  if (fields.size() < 13)
+  int64 fields[VM_STIME + 1];
+  if (!ScanProcStats(input.data(), input.size(), fields, arraysize(fields)))
     return -1;  // Output not in the format we expect.
-
-  int fields11, fields12;
-  base::StringToInt(fields[11], &fields11);
-  base::StringToInt(fields[12], &fields12);
-  return fields11 + fields12;
+  return fields[VM_UTIME] + fields[VM_STIME];
 }
 
 namespace {
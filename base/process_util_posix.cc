@@ -661,7 +661,9 @@ bool LaunchApp(const CommandLine& cl,
   return LaunchApp(cl.argv(), no_files, wait, process_handle);
 }
 
+#if !defined(OS_LINUX)
 ProcessMetrics::~ProcessMetrics() { }
+#endif
 
 void EnableTerminationOnHeapCorruption() {
   // On POSIX, there nothing to do AFAIK.
@@ -13,9 +13,11 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/path_service.h"
 #include "base/process_util.h"
+#include "base/stl_util-inl.h"
 #include "base/test/multiprocess_test.h"
 #include "base/test/test_timeouts.h"
 #include "base/threading/platform_thread.h"
+#include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/multiprocess_func_list.h"
@@ -682,6 +684,123 @@ TEST_F(ProcessUtilTest, ParseProcStatCPU) {
       "3221224832 3221224344 3086339742 0 0 0 0 0 0 0 17 0 0 0";
 
   EXPECT_EQ(0, base::ParseProcStatCPU(kSelfStat));
+
+  // The name may contain spaces and parens.
+  const char kOddNameStat[] = "42 (a) b (c)) S 1 42 42 0 -1 "
+      "4202496 471 0 0 0 "
+      "3 4 0 0 "
+      "20 0 1 0 121946157 15077376 314";
+  EXPECT_EQ(3 + 4, base::ParseProcStatCPU(kOddNameStat));
+
+  EXPECT_EQ(-1, base::ParseProcStatCPU("42 (short) S 1 42"));
+  EXPECT_EQ(-1, base::ParseProcStatCPU("no name"));
+}
+
+TEST_F(ProcessUtilTest, ProcessMetricsSelf) {
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(base::GetCurrentProcId()));
+  EXPECT_GT(metrics->GetPagefileUsage(), 0u);
+  EXPECT_GE(metrics->GetPagefileUsage(), metrics->GetWorkingSetSize());
+  EXPECT_GT(metrics->GetWorkingSetSize(), 0u);
+
+  base::WorkingSetKBytes ws_usage;
+  ASSERT_TRUE(metrics->GetWorkingSetKBytes(&ws_usage));
+  EXPECT_GT(ws_usage.priv, 0u);
+
+  // Sampling again reuses the open files and still sees changes.
+  size_t before = metrics->GetWorkingSetSize();
+  const size_t kSize = 32 * 1024 * 1024;
+  scoped_array<char> touched(new char[kSize]);
+  // Written through a volatile pointer so that the stores are not optimized
+  // away along with the otherwise unused buffer.
+  volatile char* pages = touched.get();
+  for (size_t i = 0; i < kSize; i += 1024)
+    pages[i] = 1;
+  EXPECT_GT(metrics->GetWorkingSetSize(), before);
+  EXPECT_GE(metrics->GetPeakWorkingSetSize(), metrics->GetWorkingSetSize());
+  EXPECT_GE(metrics->GetPeakPagefileUsage(), metrics->GetPagefileUsage());
+
+  base::IoCounters io_counters;
+  EXPECT_TRUE(metrics->GetIOCounters(&io_counters));
+  EXPECT_GT(io_counters.ReadOperationCount, 0u);
+
+  std::vector<base::ProcessHandle> processes(2, base::GetCurrentProcId());
+  std::vector<base::WorkingSetKBytes> usages;
+  EXPECT_EQ(2u, base::GetWorkingSetKBytesForProcesses(processes, &usages));
+  ASSERT_EQ(2u, usages.size());
+  EXPECT_GT(usages[0].priv, ws_usage.priv);
+}
+
+TEST_F(ProcessUtilTest, ProcessMetricsExitedProcess) {
+  base::ProcessHandle handle = this->SpawnChild("SimpleChildProcess", false);
+  ASSERT_NE(base::kNullProcessHandle, handle);
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(handle));
+  base::WorkingSetKBytes ws_usage;
+  metrics->GetWorkingSetKBytes(&ws_usage);
+  metrics->GetWorkingSetSize();
+  EXPECT_TRUE(base::WaitForSingleProcess(handle, 5000));
+  base::CloseProcessHandle(handle);
+
+  // Once reaped, the process is gone even if its pid is reused.
+  EXPECT_EQ(0u, metrics->GetWorkingSetSize());
+  EXPECT_FALSE(metrics->GetWorkingSetKBytes(&ws_usage));
+
+  std::vector<base::ProcessHandle> processes(1, handle);
+  std::vector<base::WorkingSetKBytes> usages;
+  EXPECT_EQ(0u, base::GetWorkingSetKBytesForProcesses(processes, &usages));
+  ASSERT_EQ(1u, usages.size());
+  EXPECT_EQ(0u, usages[0].priv);
+}
+
+// Samples 200 processes the way the task manager refreshes once a second:
+// memory and CPU usage from ProcessMetrics kept between refreshes.  Compared
+// with a ProcessMetrics created for every refresh, as about:memory does, and
+// with GetWorkingSetKBytesForProcesses().  Run with --v=1 to see the results.
+TEST_F(ProcessUtilTest, ProcessMetricsBenchmark) {
+  const int kProcesses = 200;
+  const int kRefreshes = 10;
+  std::vector<base::ProcessHandle> processes(kProcesses,
+                                             base::GetCurrentProcId());
+  std::vector<base::ProcessMetrics*> kept;
+  for (int i = 0; i < kProcesses; ++i)
+    kept.push_back(base::ProcessMetrics::CreateProcessMetrics(processes[i]));
+
+  base::TimeDelta kept_time;
+  base::TimeDelta created_time;
+  base::TimeDelta batch_time;
+  std::vector<base::WorkingSetKBytes> usages;
+  for (int refresh = 0; refresh < kRefreshes; ++refresh) {
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (int i = 0; i < kProcesses; ++i) {
+      base::WorkingSetKBytes ws_usage;
+      EXPECT_TRUE(kept[i]->GetWorkingSetKBytes(&ws_usage));
+      EXPECT_GT(kept[i]->GetWorkingSetSize(), 0u);
+      kept[i]->GetCPUUsage();
+    }
+    base::TimeTicks kept_done = base::TimeTicks::HighResNow();
+    for (int i = 0; i < kProcesses; ++i) {
+      scoped_ptr<base::ProcessMetrics> metrics(
+          base::ProcessMetrics::CreateProcessMetrics(processes[i]));
+      base::WorkingSetKBytes ws_usage;
+      EXPECT_TRUE(metrics->GetWorkingSetKBytes(&ws_usage));
+      EXPECT_GT(metrics->GetWorkingSetSize(), 0u);
+    }
+    base::TimeTicks created_done = base::TimeTicks::HighResNow();
+    EXPECT_EQ(static_cast<size_t>(kProcesses),
+              base::GetWorkingSetKBytesForProcesses(processes, &usages));
+    base::TimeTicks batch_done = base::TimeTicks::HighResNow();
+
+    kept_time += kept_done - start;
+    created_time += created_done - kept_done;
+    batch_time += batch_done - created_done;
+  }
+  STLDeleteElements(&kept);
+
+  VLOG(1) << "Sampling " << kProcesses << " processes: kept "
+          << kept_time.InMillisecondsF() / kRefreshes << " ms, created "
+          << created_time.InMillisecondsF() / kRefreshes << " ms, batch "
+          << batch_time.InMillisecondsF() / kRefreshes << " ms";
 }
 #endif  // defined(OS_LINUX)
 
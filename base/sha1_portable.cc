@@ -6,7 +6,21 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include "base/basictypes.h"
+#include "base/cpu.h"
+#include "base/lazy_instance.h"
+#include "build/build_config.h"
+
+// The SHA extension intrinsics need per-function target attributes, which
+// older compilers lack.
+#if defined(ARCH_CPU_X86_FAMILY) && (defined(__clang__) || \
+    (defined(COMPILER_GCC) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SHA1_USE_SHA_NI 1
+#include <immintrin.h>
+#endif
 
 namespace base {
 
@@ -31,39 +45,18 @@ namespace base {
 // implementation using each platform's crypto library.  See
 // http://crbug.com/47218
 
-class SecureHashAlgorithm {
- public:
-  SecureHashAlgorithm() { Init(); }
-
-  static const int kDigestSizeBytes;
-
-  void Init();
-  void Update(const void* data, size_t nbytes);
-  void Final();
+// The compression function runs on whole 64-byte blocks, straight out of the
+// caller's buffer when possible. Processors with the SHA extensions get a
+// version using those instructions, picked once at runtime.
 
-  // 20 bytes of message digest.
-  const unsigned char* Digest() const {
-    return reinterpret_cast<const unsigned char*>(H);
-  }
-
- private:
-  void Pad();
-  void Process();
-
-  uint32 A, B, C, D, E;
-
-  uint32 H[5];
+namespace {
 
-  union {
-    uint32 W[80];
-    uint8 M[64];
-  };
+// Runs the compression function over |num_blocks| 64-byte blocks at |data|,
+// updating the intermediate hash |H|.
+typedef void (*ProcessBlocksFunction)(uint32* H, const uint8* data,
+                                      size_t num_blocks);
 
-  uint32 cursor;
-  uint32 l;
-};
-
-static inline uint32 f(uint32 t, uint32 B, uint32 C, uint32 D) {
+inline uint32 f(uint32 t, uint32 B, uint32 C, uint32 D) {
   if (t < 20) {
     return (B & C) | ((~B) & D);
   } else if (t < 40) {
@@ -75,11 +68,11 @@ static inline uint32 f(uint32 t, uint32 B, uint32 C, uint32 D) {
   }
 }
 
-static inline uint32 S(uint32 n, uint32 X) {
+inline uint32 S(uint32 n, uint32 X) {
   return (X << n) | (X >> (32-n));
 }
 
-static inline uint32 K(uint32 t) {
+inline uint32 K(uint32 t) {
   if (t < 20) {
     return 0x5a827999;
   } else if (t < 40) {
@@ -91,21 +84,246 @@ static inline uint32 K(uint32 t) {
   }
 }
 
-static inline void swapends(uint32* t) {
+inline void swapends(uint32* t) {
   *t = ((*t & 0xff000000) >> 24) |
        ((*t & 0xff0000) >> 8) |
        ((*t & 0xff00) << 8) |
        ((*t & 0xff) << 24);
 }
 
+void ProcessBlocksPortable(uint32* H, const uint8* data, size_t num_blocks) {
+  uint32 W[80];
+  uint32 t;
+
+  for (; num_blocks; --num_blocks, data += 64) {
+    // Each a...e corresponds to a section in the FIPS 180-3 algorithm.
+
+    // a.
+    for (t = 0; t < 16; ++t) {
+      W[t] = (static_cast<uint32>(data[4 * t]) << 24) |
+             (static_cast<uint32>(data[4 * t + 1]) << 16) |
+             (static_cast<uint32>(data[4 * t + 2]) << 8) |
+             static_cast<uint32>(data[4 * t + 3]);
+    }
+
+    // b.
+    for (t = 16; t < 80; ++t)
+      W[t] = S(1, W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16]);
+
+    // c.
+    uint32 A = H[0];
+    uint32 B = H[1];
+    uint32 C = H[2];
+    uint32 D = H[3];
+    uint32 E = H[4];
+
+    // d.
+    for (t = 0; t < 80; ++t) {
+      uint32 TEMP = S(5, A) + f(t, B, C, D) + E + W[t] + K(t);
+      E = D;
+      D = C;
+      C = S(30, B);
+      B = A;
+      A = TEMP;
+    }
+
+    // e.
+    H[0] += A;
+    H[1] += B;
+    H[2] += C;
+    H[3] += D;
+    H[4] += E;
+  }
+}
+
+#if defined(SHA1_USE_SHA_NI)
+
+// Four rounds of SHA-1 with the SHA extensions. sha1nexte derives this
+// group's E from |e_in| (A from four rounds back) and adds in |msg|; A of the
+// current state is saved in |e_out| for the next group. |group| selects the
+// round function and constant and must be a compile-time constant.
+#define SHA1_ROUNDS4(e_in, e_out, msg, group)        \
+  e_in = _mm_sha1nexte_epu32(e_in, msg);             \
+  e_out = abcd;                                      \
+  abcd = _mm_sha1rnds4_epu32(abcd, e_in, group)
+
+// Message schedule for the words four rounds ahead: msg2 finishes the next
+// group, msg1 starts the group three ahead and the xor feeds the one in
+// between.
+#define SHA1_MSG1(target, msg) target = _mm_sha1msg1_epu32(target, msg)
+#define SHA1_MSG2(target, msg) target = _mm_sha1msg2_epu32(target, msg)
+#define SHA1_XOR(target, msg) target = _mm_xor_si128(target, msg)
+
+__attribute__((target("sha,sse4.1")))
+void ProcessBlocksSHANI(uint32* H, const uint8* data, size_t num_blocks) {
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+  __m128i abcd = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(H)), 0x1b);
+  __m128i e0 = _mm_set_epi32(H[4], 0, 0, 0);
+
+  for (; num_blocks; --num_blocks, data += 64) {
+    const __m128i abcd_save = abcd;
+    const __m128i e0_save = e0;
+    __m128i e1;
+
+    const __m128i* block = reinterpret_cast<const __m128i*>(data);
+    __m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128(block), kByteSwap);
+    __m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128(block + 1), kByteSwap);
+    __m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128(block + 2), kByteSwap);
+    __m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128(block + 3), kByteSwap);
+
+    // Rounds 0-3.
+    e0 = _mm_add_epi32(e0, msg0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    // Rounds 4-15.
+    SHA1_ROUNDS4(e1, e0, msg1, 0);
+    SHA1_MSG1(msg0, msg1);
+    SHA1_ROUNDS4(e0, e1, msg2, 0);
+    SHA1_MSG1(msg1, msg2);
+    SHA1_XOR(msg0, msg2);
+    SHA1_ROUNDS4(e1, e0, msg3, 0);
+    SHA1_MSG2(msg0, msg3);
+    SHA1_MSG1(msg2, msg3);
+    SHA1_XOR(msg1, msg3);
+
+    // Rounds 16-63: the schedule repeats every four groups.
+    SHA1_ROUNDS4(e0, e1, msg0, 0);
+    SHA1_MSG2(msg1, msg0);
+    SHA1_MSG1(msg3, msg0);
+    SHA1_XOR(msg2, msg0);
+    SHA1_ROUNDS4(e1, e0, msg1, 1);
+    SHA1_MSG2(msg2, msg1);
+    SHA1_MSG1(msg0, msg1);
+    SHA1_XOR(msg3, msg1);
+    SHA1_ROUNDS4(e0, e1, msg2, 1);
+    SHA1_MSG2(msg3, msg2);
+    SHA1_MSG1(msg1, msg2);
+    SHA1_XOR(msg0, msg2);
+    SHA1_ROUNDS4(e1, e0, msg3, 1);
+    SHA1_MSG2(msg0, msg3);
+    SHA1_MSG1(msg2, msg3);
+    SHA1_XOR(msg1, msg3);
+
+    SHA1_ROUNDS4(e0, e1, msg0, 1);
+    SHA1_MSG2(msg1, msg0);
+    SHA1_MSG1(msg3, msg0);
+    SHA1_XOR(msg2, msg0);
+    SHA1_ROUNDS4(e1, e0, msg1, 1);
+    SHA1_MSG2(msg2, msg1);
+    SHA1_MSG1(msg0, msg1);
+    SHA1_XOR(msg3, msg1);
+    SHA1_ROUNDS4(e0, e1, msg2, 2);
+    SHA1_MSG2(msg3, msg2);
+    SHA1_MSG1(msg1, msg2);
+    SHA1_XOR(msg0, msg2);
+    SHA1_ROUNDS4(e1, e0, msg3, 2);
+    SHA1_MSG2(msg0, msg3);
+    SHA1_MSG1(msg2, msg3);
+    SHA1_XOR(msg1, msg3);
+
+    SHA1_ROUNDS4(e0, e1, msg0, 2);
+    SHA1_MSG2(msg1, msg0);
+    SHA1_MSG1(msg3, msg0);
+    SHA1_XOR(msg2, msg0);
+    SHA1_ROUNDS4(e1, e0, msg1, 2);
+    SHA1_MSG2(msg2, msg1);
+    SHA1_MSG1(msg0, msg1);
+    SHA1_XOR(msg3, msg1);
+    SHA1_ROUNDS4(e0, e1, msg2, 2);
+    SHA1_MSG2(msg3, msg2);
+    SHA1_MSG1(msg1, msg2);
+    SHA1_XOR(msg0, msg2);
+    SHA1_ROUNDS4(e1, e0, msg3, 3);
+    SHA1_MSG2(msg0, msg3);
+    SHA1_MSG1(msg2, msg3);
+    SHA1_XOR(msg1, msg3);
+
+    // Rounds 64-79: the remaining words only need finishing.
+    SHA1_ROUNDS4(e0, e1, msg0, 3);
+    SHA1_MSG2(msg1, msg0);
+    SHA1_MSG1(msg3, msg0);
+    SHA1_XOR(msg2, msg0);
+    SHA1_ROUNDS4(e1, e0, msg1, 3);
+    SHA1_MSG2(msg2, msg1);
+    SHA1_XOR(msg3, msg1);
+    SHA1_ROUNDS4(e0, e1, msg2, 3);
+    SHA1_MSG2(msg3, msg2);
+    SHA1_ROUNDS4(e1, e0, msg3, 3);
+
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(H),
+                   _mm_shuffle_epi32(abcd, 0x1b));
+  H[4] = _mm_extract_epi32(e0, 3);
+}
+
+#undef SHA1_ROUNDS4
+#undef SHA1_MSG1
+#undef SHA1_MSG2
+#undef SHA1_XOR
+
+#endif  // defined(SHA1_USE_SHA_NI)
+
+// Picks the fastest compression function for this processor.
+struct ProcessBlocksDispatch {
+  ProcessBlocksDispatch() : function(&ProcessBlocksPortable) {
+#if defined(SHA1_USE_SHA_NI)
+    CPU cpu;
+    if (cpu.has_sha() && cpu.has_sse41())
+      function = &ProcessBlocksSHANI;
+#endif
+  }
+
+  ProcessBlocksFunction function;
+};
+
+// Leaky, since hashing may happen without an AtExitManager.
+LazyInstance<ProcessBlocksDispatch,
+             LeakyLazyInstanceTraits<ProcessBlocksDispatch> >
+    g_process_blocks(LINKER_INITIALIZED);
+
+}  // namespace
+
+class SecureHashAlgorithm {
+ public:
+  SecureHashAlgorithm() : process_blocks_(g_process_blocks.Get().function) {
+    Init();
+  }
+
+  static const int kDigestSizeBytes;
+
+  void Init();
+  void Update(const void* data, size_t nbytes);
+  void Final();
+
+  // 20 bytes of message digest.
+  const unsigned char* Digest() const {
+    return reinterpret_cast<const unsigned char*>(H);
+  }
+
+ private:
+  void Pad();
+
+  ProcessBlocksFunction process_blocks_;
+
+  uint32 H[5];
+
+  // Buffered input, used for partial blocks and padding.
+  uint8 M[64];
+
+  uint32 cursor;
+  uint64 l;
+};
+
 const int SecureHashAlgorithm::kDigestSizeBytes = 20;
 
 void SecureHashAlgorithm::Init() {
-  A = 0;
-  B = 0;
-  C = 0;
-  D = 0;
-  E = 0;
   cursor = 0;
   l = 0;
   H[0] = 0x67452301;
@@ -117,7 +335,8 @@ void SecureHashAlgorithm::Init() {
 
 void SecureHashAlgorithm::Final() {
   Pad();
-  Process();
+  process_blocks_(H, M, 1);
+  cursor = 0;
 
   for (int t = 0; t < 5; ++t)
     swapends(&H[t]);
@@ -125,12 +344,31 @@ void SecureHashAlgorithm::Final() {
 
 void SecureHashAlgorithm::Update(const void* data, size_t nbytes) {
   const uint8* d = reinterpret_cast<const uint8*>(data);
-  while (nbytes--) {
-    M[cursor++] = *d++;
-    if (cursor >= 64)
-      Process();
-    l += 8;
+  l += static_cast<uint64>(nbytes) * 8;
+
+  // Top up a partially filled block first.
+  if (cursor) {
+    size_t n = std::min(nbytes, static_cast<size_t>(64 - cursor));
+    memcpy(M + cursor, d, n);
+    cursor += n;
+    d += n;
+    nbytes -= n;
+    if (cursor < 64)
+      return;
+    process_blocks_(H, M, 1);
+    cursor = 0;
+  }
+
+  // Whole blocks are hashed in place.
+  size_t num_blocks = nbytes / 64;
+  if (num_blocks) {
+    process_blocks_(H, d, num_blocks);
+    d += num_blocks * 64;
+    nbytes -= num_blocks * 64;
   }
+
+  memcpy(M, d, nbytes);
+  cursor = nbytes;
 }
 
 void SecureHashAlgorithm::Pad() {
@@ -141,59 +379,15 @@ void SecureHashAlgorithm::Pad() {
     while (cursor < 64)
       M[cursor++] = 0;
 
-    Process();
+    process_blocks_(H, M, 1);
+    cursor = 0;
   }
 
-  while (cursor < 64-4)
+  while (cursor < 64-8)
     M[cursor++] = 0;
 
-  M[64-4] = (l & 0xff000000) >> 24;
-  M[64-3] = (l & 0xff0000) >> 16;
-  M[64-2] = (l & 0xff00) >> 8;
-  M[64-1] = (l & 0xff);
-}
-
-void SecureHashAlgorithm::Process() {
-  uint32 t;
-
-  // Each a...e corresponds to a section in the FIPS 180-3 algorithm.
-
-  // a.
-  //
-  // W and M are in a union, so no need to memcpy.
-  // memcpy(W, M, sizeof(M));
-  for (t = 0; t < 16; ++t)
-    swapends(&W[t]);
-
-  // b.
-  for (t = 16; t < 80; ++t)
-    W[t] = S(1, W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16]);
-
-  // c.
-  A = H[0];
-  B = H[1];
-  C = H[2];
-  D = H[3];
-  E = H[4];
-
-  // d.
-  for (t = 0; t < 80; ++t) {
-    uint32 TEMP = S(5, A) + f(t, B, C, D) + E + W[t] + K(t);
-    E = D;
-    D = C;
-    C = S(30, B);
-    B = A;
-    A = TEMP;
-  }
-
-  // e.
-  H[0] += A;
-  H[1] += B;
-  H[2] += C;
-  H[3] += D;
-  H[4] += E;
-
-  cursor = 0;
+  for (int i = 0; i < 8; ++i)
+    M[64-1-i] = static_cast<uint8>(l >> (8 * i));
 }
 
 std::string SHA1HashString(const std::string& str) {
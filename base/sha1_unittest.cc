@@ -4,9 +4,12 @@
 
 #include "base/sha1.h"
 
+#include <algorithm>
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 TEST(SHA1Test, Test1) {
@@ -106,3 +109,42 @@ TEST(SHA1Test, Test3Bytes) {
   for (size_t i = 0; i < base::SHA1_LENGTH; i++)
     EXPECT_EQ(expected[i], output[i]);
 }
+
+TEST(SHA1Test, UnalignedAndPartialBlocks) {
+  // Example A.2 from FIPS 180-2 again, starting at every offset into a buffer
+  // so whole blocks get hashed from unaligned addresses.
+  const char kInput[] =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  const std::string expected = base::SHA1HashString(kInput);
+  for (size_t offset = 0; offset < 16; ++offset) {
+    std::string buffer(offset, 'x');
+    buffer.append(kInput);
+    unsigned char output[base::SHA1_LENGTH];
+    base::SHA1HashBytes(
+        reinterpret_cast<const unsigned char*>(buffer.data()) + offset,
+        buffer.size() - offset, output);
+    EXPECT_EQ(expected, std::string(reinterpret_cast<char*>(output),
+                                    sizeof(output)));
+  }
+}
+
+// Hashes messages from 32 bytes to 16MB. Run with --v=1 to see the
+// throughput.
+TEST(SHA1Test, Throughput) {
+  const size_t kBytesPerSize = 16 << 20;
+  const size_t kSizes[] = { 32, 1024, 64 << 10, 1 << 20, 16 << 20 };
+  std::string input(kSizes[arraysize(kSizes) - 1], 'a');
+  unsigned char output[base::SHA1_LENGTH];
+
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t hashed = 0; hashed < kBytesPerSize; hashed += kSizes[i]) {
+      base::SHA1HashBytes(reinterpret_cast<const unsigned char*>(input.data()),
+                          kSizes[i], output);
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    VLOG(1) << kSizes[i] << " byte messages: "
+            << kBytesPerSize / std::max<int64>(elapsed.InMicroseconds(), 1)
+            << " MB/s";
+  }
+}
@@ -339,24 +339,33 @@ void DictionaryValue::Set(const std::string& path, Value* in_value) {
   DCHECK(IsStringUTF8(path));
   DCHECK(in_value);
 
-  std::string current_path(path);
+  // Walk the path in place rather than repeatedly erasing the consumed
+  // prefix; |key| is reused for every component.
+  std::string key;
+  size_t key_start = 0;
   DictionaryValue* current_dictionary = this;
-  for (size_t delimiter_position = current_path.find('.');
+  for (size_t delimiter_position = path.find('.');
        delimiter_position != std::string::npos;
-       delimiter_position = current_path.find('.')) {
+       delimiter_position = path.find('.', key_start)) {
     // Assume that we're indexing into a dictionary.
-    std::string key(current_path, 0, delimiter_position);
+    key.assign(path, key_start, delimiter_position - key_start);
     DictionaryValue* child_dictionary = NULL;
-    if (!current_dictionary->GetDictionary(key, &child_dictionary)) {
+    if (!current_dictionary->GetDictionaryWithoutPathExpansion(
+            key, &child_dictionary)) {
       child_dictionary = new DictionaryValue;
       current_dictionary->SetWithoutPathExpansion(key, child_dictionary);
     }
 
     current_dictionary = child_dictionary;
-    current_path.erase(0, delimiter_position + 1);
+    key_start = delimiter_position + 1;
   }
 
-  current_dictionary->SetWithoutPathExpansion(current_path, in_value);
+  if (key_start == 0) {
+    current_dictionary->SetWithoutPathExpansion(path, in_value);
+    return;
+  }
+  key.assign(path, key_start, std::string::npos);
+  current_dictionary->SetWithoutPathExpansion(key, in_value);
 }
 
 void DictionaryValue::SetBoolean(const std::string& path, bool in_value) {
@@ -395,21 +404,27 @@ void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
 
 bool DictionaryValue::Get(const std::string& path, Value** out_value) const {
   DCHECK(IsStringUTF8(path));
-  std::string current_path(path);
+  std::string key;
+  size_t key_start = 0;
   const DictionaryValue* current_dictionary = this;
-  for (size_t delimiter_position = current_path.find('.');
+  for (size_t delimiter_position = path.find('.');
        delimiter_position != std::string::npos;
-       delimiter_position = current_path.find('.')) {
+       delimiter_position = path.find('.', key_start)) {
+    key.assign(path, key_start, delimiter_position - key_start);
     DictionaryValue* child_dictionary = NULL;
-    if (!current_dictionary->GetDictionary(
-            current_path.substr(0, delimiter_position), &child_dictionary))
+    if (!current_dictionary->GetDictionaryWithoutPathExpansion(
+            key, &child_dictionary))
       return false;
 
     current_dictionary = child_dictionary;
-    current_path.erase(0, delimiter_position + 1);
+    key_start = delimiter_position + 1;
   }
 
-  return current_dictionary->GetWithoutPathExpansion(current_path, out_value);
+  // Most lookups are a single key, which needs no copy at all.
+  if (key_start == 0)
+    return current_dictionary->GetWithoutPathExpansion(path, out_value);
+  key.assign(path, key_start, std::string::npos);
+  return current_dictionary->GetWithoutPathExpansion(key, out_value);
 }
 
 bool DictionaryValue::GetBoolean(const std::string& path,
@@ -107,24 +107,29 @@
 #if defined(_M_X64) || defined(__x86_64__)
 #define ARCH_CPU_X86_FAMILY 1
 #define ARCH_CPU_X86_64 1
+#define ARCH_CPU_LITTLE_ENDIAN 1
 #define ARCH_CPU_64_BITS 1
 #elif defined(_M_IX86) || defined(__i386__)
 #define ARCH_CPU_X86_FAMILY 1
 #define ARCH_CPU_X86 1
+#define ARCH_CPU_LITTLE_ENDIAN 1
 #define ARCH_CPU_32_BITS 1
 #elif defined(__ARMEL__)
 #define ARCH_CPU_ARM_FAMILY 1
 #define ARCH_CPU_ARMEL 1
+#define ARCH_CPU_LITTLE_ENDIAN 1
 #define ARCH_CPU_32_BITS 1
 #define WCHAR_T_IS_UNSIGNED 1
 #elif defined(__aarch64__)
 #define ARCH_CPU_ARM64_FAMILY 1
 #define ARCH_CPU_ARM64EL 1
+#define ARCH_CPU_LITTLE_ENDIAN 1
 #define ARCH_CPU_64_BITS 1
 #define WCHAR_T_IS_UNSIGNED 1
 #elif defined(__MIPSEL__)
 #define ARCH_CPU_MIPS_FAMILY 1
 #define ARCH_CPU_MIPSEL 1
+#define ARCH_CPU_LITTLE_ENDIAN 1
 #define ARCH_CPU_32_BITS 1
 #define WCHAR_T_IS_UNSIGNED 0
 #else
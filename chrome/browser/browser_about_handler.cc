@@ -30,6 +30,7 @@
 #include "chrome/browser/defaults.h"
 #include "chrome/browser/memory_details.h"
 #include "chrome/browser/metrics/histogram_synchronizer.h"
+#include "chrome/browser/metrics/thread_watcher.h"
 #include "chrome/browser/net/predictor_api.h"
 #include "chrome/browser/platform_util.h"
 #include "chrome/browser/profiles/profile.h"
@@ -661,6 +662,7 @@ void AboutMemory(AboutSource* source, int request_id) {
 static std::string AboutObjects(const std::string& query) {
   std::string data;
   tracked_objects::ThreadData::WriteHTML(query, &data);
+  ThreadWatcherList::WriteSlowTasksHTML(&data);
   return data;
 }
 #endif  // TRACK_ALL_TASK_OBJECTS
@@ -701,6 +703,9 @@ std::string AboutStats(const std::string& query) {
     root.Set("timers", timers);
   }
 
+  std::vector<int> values;
+  table->GetRowValues(&values);
+
   // NOTE: Counters start at index 1.
   for (int index = 1; index <= table->GetMaxCounters(); index++) {
     // Get the counter's full name
@@ -740,7 +745,7 @@ std::string AboutStats(const std::string& query) {
     switch (counter_type) {
       case 'c':
         {
-          int new_value = table->GetRowValue(index);
+          int new_value = values[index - 1];
           int prior_value = 0;
           int delta = 0;
           if (counter->GetInteger("value", &prior_value)) {
@@ -757,7 +762,7 @@ std::string AboutStats(const std::string& query) {
         break;
       case 't':
         {
-          int time = table->GetRowValue(index);
+          int time = values[index - 1];
           counter->SetInteger("time", time);
 
           // Store this on the timers list as well.
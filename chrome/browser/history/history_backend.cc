@@ -308,6 +308,7 @@ SegmentID HistoryBackend::GetLastSegmentID(VisitID from_visit) {
 }
 
 SegmentID HistoryBackend::UpdateSegments(const GURL& url,
+                                         URLID url_id,
                                          VisitID from_visit,
                                          VisitID visit_id,
                                          PageTransition::Type transition_type,
@@ -326,7 +327,6 @@ SegmentID HistoryBackend::UpdateSegments(const GURL& url,
   if (t == PageTransition::TYPED || t == PageTransition::AUTO_BOOKMARK) {
     // If so, create or get the segment.
     std::string segment_name = db_->ComputeSegmentName(url);
-    URLID url_id = db_->GetRowForURL(url, NULL);
     if (!url_id)
       return 0;
 
@@ -412,8 +412,8 @@ void HistoryBackend::AddPage(scoped_refptr<HistoryAddPageArgs> request) {
     // result in changing most visited, so we don't update segments (most
     // visited db).
     if (!is_keyword_generated) {
-      UpdateSegments(request->url, from_visit_id, last_ids.second, t,
-                     last_recorded_time_);
+      UpdateSegments(request->url, last_ids.first, from_visit_id,
+                     last_ids.second, t, last_recorded_time_);
     }
   } else {
     // Redirect case. Add the redirect chain.
@@ -476,7 +476,7 @@ void HistoryBackend::AddPage(scoped_refptr<HistoryAddPageArgs> request) {
                               t, request->visit_source);
       if (t & PageTransition::CHAIN_START) {
         // Update the segment for this visit.
-        UpdateSegments(request->redirects[redirect_index],
+        UpdateSegments(request->redirects[redirect_index], last_ids.first,
                        from_visit_id, last_ids.second, t, last_recorded_time_);
       }
 
@@ -339,6 +339,7 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, DeleteThumbnailsDatabaseTest);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, AddPageVisitSource);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, AddPageArgsSource);
+  FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, AddManyVisits);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, AddVisitsSource);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, RemoveVisitsSource);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, MigrationVisitSource);
@@ -435,8 +436,10 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   SegmentID GetLastSegmentID(VisitID from_visit);
 
   // Update the segment information. This is called internally when a page is
-  // added. Return the segment id of the segment that has been updated.
+  // added. |url_id| is the row of |url|, as returned by AddPageVisit(). Return
+  // the segment id of the segment that has been updated.
   SegmentID UpdateSegments(const GURL& url,
+                           URLID url_id,
                            VisitID from_visit,
                            VisitID visit_id,
                            PageTransition::Type transition_type,
@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <math.h>
+
 #include <set>
 #include <vector>
 
@@ -11,13 +13,17 @@
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/path_service.h"
+#include "base/stl_util-inl.h"
 #include "base/string16.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/bookmarks/bookmark_model.h"
 #include "chrome/browser/history/history_backend.h"
 #include "chrome/browser/history/history_notifications.h"
 #include "chrome/browser/history/in_memory_database.h"
 #include "chrome/browser/history/in_memory_history_backend.h"
+#include "chrome/browser/history/page_usage_data.h"
 #include "chrome/common/chrome_constants.h"
 #include "chrome/common/chrome_paths.h"
 #include "chrome/common/thumbnail_score.h"
@@ -692,6 +698,49 @@ TEST_F(HistoryBackendTest, AddPageArgsSource) {
   EXPECT_EQ(history::SOURCE_SYNCED, visit_sources.begin()->second);
 }
 
+// Adds a large number of typed visits spread over a set of pages, the way a
+// session restore followed by heavy browsing does, and checks that the
+// coalesced segment visit counts and URL rows come out right.
+TEST_F(HistoryBackendTest, AddManyVisits) {
+  ASSERT_TRUE(backend_.get());
+
+  const int kURLCount = 100;
+  const int kVisitCount = 100000;
+  const Time visit_time = Time::Now();
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kVisitCount; ++i) {
+    GURL url(base::StringPrintf("http://www.example%d.com/", i % kURLCount));
+    scoped_refptr<HistoryAddPageArgs> request(
+        new HistoryAddPageArgs(url, visit_time, NULL, 0, GURL(),
+                               history::RedirectList(), PageTransition::TYPED,
+                               history::SOURCE_BROWSED, false));
+    backend_->AddPage(request);
+  }
+  backend_->Commit();
+  VLOG(1) << "Added " << kVisitCount << " visits in "
+          << (base::TimeTicks::Now() - start).InMilliseconds() << " ms";
+
+  for (int i = 0; i < kURLCount; ++i) {
+    URLRow row;
+    ASSERT_TRUE(backend_->db()->GetRowForURL(
+        GURL(base::StringPrintf("http://www.example%d.com/", i)), &row));
+    EXPECT_EQ(kVisitCount / kURLCount, row.visit_count());
+    EXPECT_EQ(kVisitCount / kURLCount, row.typed_count());
+  }
+
+  // Every page is its own segment, visited the same number of times today.
+  std::vector<PageUsageData*> results;
+  backend_->db_->QuerySegmentUsage(visit_time - base::TimeDelta::FromDays(1),
+                                   kURLCount * 2, &results);
+  ASSERT_EQ(static_cast<size_t>(kURLCount), results.size());
+  const double expected_score =
+      3.0 * (1.0 + log(static_cast<double>(kVisitCount / kURLCount)));
+  for (size_t i = 0; i < results.size(); ++i)
+    EXPECT_NEAR(expected_score, results[i]->GetScore(), 0.01);
+  STLDeleteElements(&results);
+}
+
 TEST_F(HistoryBackendTest, AddVisitsSource) {
   ASSERT_TRUE(backend_.get());
 
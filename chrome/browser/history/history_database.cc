@@ -64,6 +64,8 @@ HistoryDatabase::HistoryDatabase()
 }
 
 HistoryDatabase::~HistoryDatabase() {
+  if (db_.is_open())
+    FlushSegmentVisitCounts();
 }
 
 sql::InitStatus HistoryDatabase::Init(const FilePath& history_name,
@@ -145,6 +147,10 @@ void HistoryDatabase::BeginTransaction() {
 }
 
 void HistoryDatabase::CommitTransaction() {
+  // Segment visit counts are buffered in memory; make sure they are part of
+  // the transaction being committed.
+  if (db_.transaction_nesting() == 1)
+    FlushSegmentVisitCounts();
   db_.CommitTransaction();
 }
 
@@ -35,6 +35,11 @@ std::string ConvertStringForIndexer(const string16& input) {
 // haven't gotten a title and/or body.
 const int kExpirationSec = 20;
 
+// The number of completed pages we will buffer inside a transaction before
+// writing them to the full text index. Page bodies can be large, so this
+// bounds the memory held by the buffer.
+const size_t kMaxPendingPages = 50;
+
 }  // namespace
 
 // TextDatabaseManager::ChangeSet ----------------------------------------------
@@ -83,6 +88,7 @@ TextDatabaseManager::TextDatabaseManager(const FilePath& dir,
       url_database_(url_database),
       visit_database_(visit_database),
       recent_changes_(RecentChangeList::NO_AUTO_EVICT),
+      pending_pages_(RecentChangeList::NO_AUTO_EVICT),
       transaction_nesting_(0),
       db_cache_(DBCache::NO_AUTO_EVICT),
       present_databases_loaded_(false),
@@ -128,6 +134,10 @@ void TextDatabaseManager::BeginTransaction() {
 
 void TextDatabaseManager::CommitTransaction() {
   DCHECK(transaction_nesting_);
+  if (transaction_nesting_ == 1) {
+    // Buffered pages belong to this transaction.
+    FlushPendingPages();
+  }
   transaction_nesting_--;
   if (transaction_nesting_)
     return;  // Still more nesting of transactions before committing.
@@ -194,6 +204,10 @@ void TextDatabaseManager::AddPageTitle(const GURL& url,
     //
     // To solve this problem, we'll just associate the most recent visit with
     // the new title and index that using the regular code path.
+    //
+    // The page may still be waiting in the buffer, write it first so the
+    // checks below see its indexed state.
+    FlushPendingPages();
     URLRow url_row;
     if (!url_database_->GetRowForURL(url, &url_row))
       return;  // URL is unknown, give up.
@@ -221,8 +235,8 @@ void TextDatabaseManager::AddPageTitle(const GURL& url,
   PageInfo& info = found->second;
   if (info.has_body()) {
     // This info is complete, write to the database.
-    AddPageData(url, info.url_id(), info.visit_id(), info.visit_time(),
-                title, info.body());
+    info.set_title(title);
+    QueuePageData(url, info);
     recent_changes_.Erase(found);
     return;
   }
@@ -241,6 +255,7 @@ void TextDatabaseManager::AddPageContents(const GURL& url,
     //
     // As a fallback, set the most recent visit's contents using the input, and
     // use the last set title in the URL table as the title to index.
+    FlushPendingPages();
     URLRow url_row;
     if (!url_database_->GetRowForURL(url, &url_row))
       return;  // URL is unknown, give up.
@@ -257,8 +272,8 @@ void TextDatabaseManager::AddPageContents(const GURL& url,
   PageInfo& info = found->second;
   if (info.has_title()) {
     // This info is complete, write to the database.
-    AddPageData(url, info.url_id(), info.visit_id(), info.visit_time(),
-                info.title(), body);
+    info.set_body(body);
+    QueuePageData(url, info);
     recent_changes_.Erase(found);
     return;
   }
@@ -326,6 +341,30 @@ bool TextDatabaseManager::AddPageData(const GURL& url,
   return success;
 }
 
+void TextDatabaseManager::QueuePageData(const GURL& url,
+                                        const PageInfo& info) {
+  if (!transaction_nesting_) {
+    AddPageData(url, info.url_id(), info.visit_id(), info.visit_time(),
+                info.title(), info.body());
+    return;
+  }
+
+  pending_pages_.Put(url, info);
+  if (pending_pages_.size() >= kMaxPendingPages)
+    FlushPendingPages();
+}
+
+void TextDatabaseManager::FlushPendingPages() {
+  // Write the oldest pages first, the same order they would have been indexed
+  // in without buffering.
+  RecentChangeList::reverse_iterator i = pending_pages_.rbegin();
+  while (i != pending_pages_.rend()) {
+    AddPageData(i->first, i->second.url_id(), i->second.visit_id(),
+                i->second.visit_time(), i->second.title(), i->second.body());
+    i = pending_pages_.Erase(i);
+  }
+}
+
 void TextDatabaseManager::DeletePageData(Time time, const GURL& url,
                                          ChangeSet* change_set) {
   TextDatabase::DBIdent db_ident = TimeToID(time);
@@ -372,11 +411,25 @@ void TextDatabaseManager::DeleteFromUncommitted(
         ++cur;
     }
   }
+
+  // Pages waiting to be written are ordered by when they completed rather than
+  // by visit time, so check all of them. There are at most kMaxPendingPages.
+  RecentChangeList::iterator pending = pending_pages_.begin();
+  while (pending != pending_pages_.end()) {
+    Time visit_time = pending->second.visit_time();
+    if ((restrict_urls.empty() ||
+         restrict_urls.find(pending->first) != restrict_urls.end()) &&
+        visit_time >= begin && (end.is_null() || visit_time < end))
+      pending = pending_pages_.Erase(pending);
+    else
+      ++pending;
+  }
 }
 
 void TextDatabaseManager::DeleteAll() {
   DCHECK_EQ(0, transaction_nesting_) << "Calling deleteAll in a transaction.";
 
+  pending_pages_.Clear();
   InitDBList();
 
   // Close all open databases.
@@ -416,6 +469,9 @@ void TextDatabaseManager::GetTextMatches(
     Time* first_time_searched) {
   results->clear();
 
+  // Make sure recently completed pages can be found.
+  FlushPendingPages();
+
   InitDBList();
   if (present_databases_.empty()) {
     // Nothing to search.
@@ -547,8 +603,7 @@ void TextDatabaseManager::FlushOldChangesForTime(TimeTicks now) {
   // things until we get something too new.
   RecentChangeList::reverse_iterator i = recent_changes_.rbegin();
   while (i != recent_changes_.rend() && i->second.Expired(now)) {
-    AddPageData(i->first, i->second.url_id(), i->second.visit_id(),
-                i->second.visit_time(), i->second.title(), i->second.body());
+    QueuePageData(i->first, i->second);
     i = recent_changes_.Erase(i);
   }
 
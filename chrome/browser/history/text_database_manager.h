@@ -37,6 +37,12 @@ class VisitDatabase;
 // This allows us to minimize inserts and modifications, which are slow for the
 // full text database, since each page's information is added exactly once.
 //
+// Completed pages are not written right away while a transaction is open.
+// They are buffered and indexed together when the transaction is committed,
+// before a query, or when the buffer gets large. If a page is visited again
+// before its data is written, only the most recent visit is indexed, which is
+// what indexing each visit in turn would have left in the database anyway.
+//
 // Note: be careful to delete the relevant entries from this uncommitted list
 // when clearing history or this information may get added to the database soon
 // after the clear.
@@ -162,6 +168,7 @@ class TextDatabaseManager {
   // These tests call ExpireRecentChangesForTime to force expiration.
   FRIEND_TEST_ALL_PREFIXES(TextDatabaseManagerTest, InsertPartial);
   FRIEND_TEST_ALL_PREFIXES(TextDatabaseManagerTest, PartialComplete);
+  FRIEND_TEST_ALL_PREFIXES(TextDatabaseManagerTest, BufferedIndexing);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, DeleteURLAndFavicon);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, FlushRecentURLsUnstarred);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest,
@@ -230,6 +237,14 @@ class TextDatabaseManager {
   TextDatabase* GetDB(TextDatabase::DBIdent id, bool for_writing);
   TextDatabase* GetDBForTime(base::Time time, bool for_writing);
 
+  // Adds the page described by |info| to the full text index. While a
+  // transaction is open, this only buffers the page in pending_pages_ (see
+  // FlushPendingPages()); otherwise the page is written right away.
+  void QueuePageData(const GURL& url, const PageInfo& info);
+
+  // Writes all the pages buffered by QueuePageData() to the databases.
+  void FlushPendingPages();
+
   // Populates the present_databases_ list based on which files are on disk.
   // When the list is already initialized, this will do nothing, so you can
   // call it whenever you want to ensure the present_databases_ set is filled.
@@ -265,6 +280,11 @@ class TextDatabaseManager {
   typedef MRUCache<GURL, PageInfo> RecentChangeList;
   RecentChangeList recent_changes_;
 
+  // Pages with complete (or expired) data that have not been written to the
+  // full text databases yet. Keying by URL means a page visited several times
+  // before the next flush is only written for its latest visit.
+  RecentChangeList pending_pages_;
+
   // Nesting levels of transactions. Since sqlite only allows one open
   // transaction, we simulate nested transactions by mapping the outermost one
   // to a real transaction. Since this object never needs to do ROLLBACK, losing
@@ -0,0 +1,147 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "app/sql/connection.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/format_macros.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/text_database_manager.h"
+#include "chrome/browser/history/visit_database.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::Time;
+using base::TimeDelta;
+
+namespace history {
+
+namespace {
+
+// Size of the synthetic corpus.
+const int kPageCount = 100000;
+
+// Number of pages added between two commits, about what the history backend
+// sees in its commit interval while restoring a large session.
+const int kPagesPerTransaction = 100;
+
+// Number of words in each page body.
+const int kWordsPerPage = 200;
+
+// Number of times each query is run.
+const int kQueryRepeatCount = 20;
+
+// Words the page bodies are made of. The first ones are used much more often
+// than the last ones, so queries hit both common and rare terms.
+const char* const kVocabulary[] = {
+  "the", "chromium", "browser", "history", "search", "index", "page", "visit",
+  "network", "cache", "database", "render", "tab", "window", "bookmark",
+  "download", "extension", "plugin", "cookie", "proxy", "socket", "thread",
+  "memory", "profile", "sync", "theme", "omnibox", "favicon", "thumbnail",
+  "session", "restore", "printing", "spelling", "autofill", "password",
+  "geolocation", "notification", "accessibility", "translate", "zeitgeist",
+};
+
+// Same as InMemDB in text_database_manager_unittest.cc.
+class InMemDB : public URLDatabase, public VisitDatabase {
+ public:
+  InMemDB() {
+    EXPECT_TRUE(db_.OpenInMemory());
+    CreateURLTable(false);
+    InitVisitTable();
+  }
+  ~InMemDB() {
+  }
+
+ private:
+  virtual sql::Connection& GetDB() { return db_; }
+
+  sql::Connection db_;
+
+  DISALLOW_COPY_AND_ASSIGN(InMemDB);
+};
+
+// Returns the body of synthetic page |page|.
+string16 PageBody(int page) {
+  std::string body;
+  uint32 seed = static_cast<uint32>(page) * 2654435761U;
+  for (int i = 0; i < kWordsPerPage; ++i) {
+    seed = seed * 1103515245U + 12345U;
+    // Squaring skews the distribution towards the start of the vocabulary.
+    uint32 r = (seed >> 16) % arraysize(kVocabulary);
+    body.append(kVocabulary[(r * r) / arraysize(kVocabulary)]);
+    body.push_back(' ');
+  }
+  return UTF8ToUTF16(body);
+}
+
+class TextDatabaseManagerPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(file_util::CreateNewTempDirectory(
+        FILE_PATH_LITERAL("TextDatabaseManagerPerfTest"), &dir_));
+  }
+
+  virtual void TearDown() {
+    file_util::Delete(dir_, true);
+  }
+
+  MessageLoop message_loop_;
+  FilePath dir_;
+};
+
+}  // namespace
+
+TEST_F(TextDatabaseManagerPerfTest, IndexAndQuery) {
+  printf("\n");
+  InMemDB visit_db;
+  TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+  ASSERT_TRUE(manager.Init(NULL));
+
+  // Spread the visits over the last year so they land in a dozen databases.
+  const Time now = Time::Now();
+  const TimeDelta spacing = TimeDelta::FromDays(365) / kPageCount;
+
+  PerfTimeLogger index_timer("text_database_manager_index_100k");
+  manager.BeginTransaction();
+  for (int i = 0; i < kPageCount; ++i) {
+    if (i % kPagesPerTransaction == 0) {
+      manager.CommitTransaction();
+      manager.BeginTransaction();
+    }
+    GURL url(base::StringPrintf("http://www.example%d.com/page%d",
+                                i % 1000, i));
+    manager.AddPageURL(url, 0, 0, now - spacing * (kPageCount - i));
+    manager.AddPageTitle(url, UTF8ToUTF16(base::StringPrintf("Page %d", i)));
+    manager.AddPageContents(url, PageBody(i));
+  }
+  manager.CommitTransaction();
+  index_timer.Done();
+
+  const char* const kQueries[] = { "browser", "zeitgeist", "cache thread",
+                                   "pag*" };
+  for (size_t q = 0; q < arraysize(kQueries); ++q) {
+    QueryOptions options;
+    options.max_count = 100;
+    std::vector<TextDatabase::Match> results;
+    Time first_time_searched;
+
+    PerfTimeLogger query_timer(base::StringPrintf(
+        "text_database_manager_query_%" PRIuS, q).c_str());
+    for (int i = 0; i < kQueryRepeatCount; ++i) {
+      manager.GetTextMatches(UTF8ToUTF16(kQueries[q]), options,
+                             &results, &first_time_searched);
+    }
+    query_timer.Done();
+    EXPECT_FALSE(results.empty()) << kQueries[q];
+  }
+}
+
+}  // namespace history
@@ -368,6 +368,56 @@ TEST_F(TextDatabaseManagerTest, PartialComplete) {
   EXPECT_EQ(1U, results.size());
 }
 
+// Tests that pages completed inside a transaction are buffered, and that only
+// the latest visit of a page visited twice before the flush gets indexed.
+TEST_F(TextDatabaseManagerTest, BufferedIndexing) {
+  ASSERT_TRUE(Init());
+  InMemDB visit_db;
+  TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+  ASSERT_TRUE(manager.Init(NULL));
+
+  VisitRow visit1;
+  visit1.url_id = 1;
+  visit1.visit_time = Time::Now() - TimeDelta::FromMinutes(1);
+  visit1.transition = PageTransition::LINK;
+  visit_db.AddVisit(&visit1, SOURCE_BROWSED);
+  VisitRow visit2(visit1);
+  visit2.visit_time = Time::Now();
+  visit_db.AddVisit(&visit2, SOURCE_BROWSED);
+
+  const GURL url(kURL1);
+  manager.BeginTransaction();
+  manager.AddPageURL(url, visit1.url_id, visit1.visit_id, visit1.visit_time);
+  manager.AddPageTitle(url, UTF8ToUTF16(kTitle1));
+  manager.AddPageContents(url, UTF8ToUTF16(kBody1));
+  manager.AddPageURL(url, visit2.url_id, visit2.visit_id, visit2.visit_time);
+  manager.AddPageTitle(url, UTF8ToUTF16(kTitle2));
+  manager.AddPageContents(url, UTF8ToUTF16(kBody2));
+
+  // Both visits are complete, but nothing has been written yet.
+  EXPECT_EQ(1U, manager.pending_pages_.size());
+  VisitRow out_visit;
+  ASSERT_TRUE(visit_db.GetRowForVisit(visit2.visit_id, &out_visit));
+  EXPECT_FALSE(out_visit.is_indexed);
+
+  manager.CommitTransaction();
+  EXPECT_EQ(0U, manager.pending_pages_.size());
+
+  // Only the second visit should have been indexed.
+  QueryOptions options;
+  std::vector<TextDatabase::Match> results;
+  Time first_time_searched;
+  manager.GetTextMatches(UTF8ToUTF16("FOO"), options,
+                         &results, &first_time_searched);
+  ASSERT_EQ(1U, results.size());
+  EXPECT_EQ(kTitle2, UTF16ToUTF8(results[0].title));
+
+  ASSERT_TRUE(visit_db.GetRowForVisit(visit1.visit_id, &out_visit));
+  EXPECT_FALSE(out_visit.is_indexed);
+  ASSERT_TRUE(visit_db.GetRowForVisit(visit2.visit_id, &out_visit));
+  EXPECT_TRUE(out_visit.is_indexed);
+}
+
 // Tests that changes get properly committed to disk.
 TEST_F(TextDatabaseManagerTest, Writing) {
   ASSERT_TRUE(Init());
@@ -101,6 +101,9 @@ bool VisitSegmentDatabase::InitSegmentTables() {
 }
 
 bool VisitSegmentDatabase::DropSegmentTables() {
+  // Visits that have not been written yet go away with the tables.
+  pending_segment_visits_.clear();
+
   // Dropping the tables will implicitly delete the indices.
   return GetDB().Execute("DROP TABLE segments") &&
          GetDB().Execute("DROP TABLE segment_usage");
@@ -191,15 +194,35 @@ SegmentID VisitSegmentDatabase::CreateSegment(URLID url_id,
 bool VisitSegmentDatabase::IncreaseSegmentVisitCount(SegmentID segment_id,
                                                      base::Time ts,
                                                      int amount) {
-  base::Time t = ts.LocalMidnight();
+  // Most visits land in a handful of segments on the current day, so rather
+  // than a SELECT and an UPDATE per visit we accumulate the increments and
+  // write each (segment, day) pair once per flush.
+  int64 time_slot = ts.LocalMidnight().ToInternalValue();
+  pending_segment_visits_[std::make_pair(segment_id, time_slot)] += amount;
+  return true;
+}
 
+bool VisitSegmentDatabase::FlushSegmentVisitCounts() {
+  bool success = true;
+  for (PendingSegmentVisits::const_iterator i = pending_segment_visits_.begin();
+       i != pending_segment_visits_.end(); ++i) {
+    if (!WriteSegmentVisitCount(i->first.first, i->first.second, i->second))
+      success = false;
+  }
+  pending_segment_visits_.clear();
+  return success;
+}
+
+bool VisitSegmentDatabase::WriteSegmentVisitCount(SegmentID segment_id,
+                                                  int64 time_slot,
+                                                  int amount) {
   sql::Statement select(GetDB().GetCachedStatement(SQL_FROM_HERE,
       "SELECT id, visit_count FROM segment_usage "
       "WHERE time_slot = ? AND segment_id = ?"));
   if (!select)
     return false;
 
-  select.BindInt64(0, t.ToInternalValue());
+  select.BindInt64(0, time_slot);
   select.BindInt64(1, segment_id);
   if (select.Step()) {
     sql::Statement update(GetDB().GetCachedStatement(SQL_FROM_HERE,
@@ -219,7 +242,7 @@ bool VisitSegmentDatabase::IncreaseSegmentVisitCount(SegmentID segment_id,
       return false;
 
     insert.BindInt64(0, segment_id);
-    insert.BindInt64(1, t.ToInternalValue());
+    insert.BindInt64(1, time_slot);
     insert.BindInt64(2, static_cast<int64>(amount));
     return insert.Run();
   }
@@ -237,6 +260,8 @@ void VisitSegmentDatabase::QuerySegmentUsage(
   // used to lock results into position.  But the rest of our code currently
   // does as well.
 
+  FlushSegmentVisitCounts();
+
   // Gather all the segment scores.
   sql::Statement statement(GetDB().GetCachedStatement(SQL_FROM_HERE,
       "SELECT segment_id, time_slot, visit_count "
@@ -317,6 +342,8 @@ void VisitSegmentDatabase::QuerySegmentUsage(
 }
 
 void VisitSegmentDatabase::DeleteSegmentData(base::Time older_than) {
+  FlushSegmentVisitCounts();
+
   sql::Statement statement(GetDB().GetCachedStatement(SQL_FROM_HERE,
       "DELETE FROM segment_usage WHERE time_slot < ?"));
   if (!statement)
@@ -343,6 +370,8 @@ void VisitSegmentDatabase::SetSegmentPresentationIndex(SegmentID segment_id,
 }
 
 bool VisitSegmentDatabase::DeleteSegmentForURL(URLID url_id) {
+  FlushSegmentVisitCounts();
+
   sql::Statement select(GetDB().GetCachedStatement(SQL_FROM_HERE,
       "SELECT id FROM segments WHERE url_id = ?"));
   if (!select)
@@ -6,6 +6,9 @@
 #define CHROME_BROWSER_HISTORY_VISITSEGMENT_DATABASE_H_
 #pragma once
 
+#include <map>
+#include <utility>
+
 #include "base/basictypes.h"
 #include "chrome/browser/history/history_types.h"
 
@@ -47,10 +50,17 @@ class VisitSegmentDatabase {
   SegmentID CreateSegment(URLID url_id, const std::string& segment_name);
 
   // Increase the segment visit count by the provided amount. Return true on
-  // success.
+  // success. Increments are coalesced in memory per segment and day, and are
+  // only written to the segment_usage table by FlushSegmentVisitCounts().
   bool IncreaseSegmentVisitCount(SegmentID segment_id, base::Time ts,
                                  int amount);
 
+  // Writes the visit count increments accumulated by
+  // IncreaseSegmentVisitCount() to the segment_usage table. This is called
+  // before anything reads or deletes segment usage data, and should be called
+  // before committing the transaction. Returns true on success.
+  bool FlushSegmentVisitCounts();
+
   // Compute the segment usage since |from_time| using the provided aggregator.
   // A PageUsageData is added in |result| for the highest-scored segments up to
   // |max_result_count|.
@@ -81,6 +91,17 @@ class VisitSegmentDatabase {
   bool DropSegmentTables();
 
  private:
+  // Maps a (segment ID, internal value of the day's local midnight) pair to the
+  // number of visits not yet written to the segment_usage table.
+  typedef std::map<std::pair<SegmentID, int64>, int> PendingSegmentVisits;
+
+  // Adds |amount| to the stored visit count of |segment_id| for the day
+  // starting at |time_slot|, creating the segment_usage row if needed.
+  bool WriteSegmentVisitCount(SegmentID segment_id, int64 time_slot,
+                              int amount);
+
+  PendingSegmentVisits pending_segment_visits_;
+
   DISALLOW_COPY_AND_ASSIGN(VisitSegmentDatabase);
 };
 
@@ -147,11 +147,12 @@ static BrowserType GetBrowserType(const std::string& process_name) {
 // and append a record to |out|
 static void GetProcessDataMemoryInformation(
     const std::vector<pid_t>& pids, ProcessData* out) {
-  for (std::vector<pid_t>::const_iterator
-       i = pids.begin(); i != pids.end(); ++i) {
+  std::vector<base::WorkingSetKBytes> working_sets;
+  base::GetWorkingSetKBytesForProcesses(pids, &working_sets);
+  for (size_t i = 0; i < pids.size(); ++i) {
     ProcessMemoryInformation pmi;
 
-    pmi.pid = *i;
+    pmi.pid = pids[i];
     pmi.num_processes = 1;
 
     if (pmi.pid == base::GetCurrentProcId())
@@ -159,10 +160,7 @@ static void GetProcessDataMemoryInformation(
     else
       pmi.type = ChildProcessInfo::UNKNOWN_PROCESS;
 
-    base::ProcessMetrics* metrics =
-        base::ProcessMetrics::CreateProcessMetrics(*i);
-    metrics->GetWorkingSetKBytes(&pmi.working_set);
-    delete metrics;
+    pmi.working_set = working_sets[i];
 
     out->processes.push_back(pmi);
   }
@@ -2,11 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "base/stringprintf.h"
 #include "base/threading/thread_restrictions.h"
 #include "build/build_config.h"
 #include "chrome/browser/metrics/metrics_service.h"
 #include "chrome/browser/metrics/thread_watcher.h"
 #include "content/common/notification_service.h"
+#include "net/base/escape.h"
 
 #if defined(OS_WIN)
 #include <Objbase.h>
@@ -15,6 +17,96 @@
 // static
 const int ThreadWatcher::kPingCount = 3;
 
+// The maximum number of distinct slow tasks remembered by ThreadWatcherList.
+static const size_t kMaxSlowTasks = 100;
+
+// This class is attached to the message loop of a watched thread, and remembers
+// the birth place and start time of the task being run, so that the
+// WatchDogThread can find out what is keeping the watched thread busy.
+class ThreadWatcher::RunningTaskObserver
+    : public base::RefCountedThreadSafe<RunningTaskObserver>,
+      public MessageLoop::TaskObserver {
+ public:
+  RunningTaskObserver()
+      : attached_(false),
+        function_name_(NULL),
+        file_name_(NULL),
+        line_number_(-1) {
+  }
+
+  // Attaches the observer to the current thread's message loop.
+  void AttachToCurrentThread() {
+    if (attached_)
+      return;
+    attached_ = true;
+    MessageLoop::current()->AddTaskObserver(this);
+  }
+
+  // Detaches the observer from the current thread's message loop.
+  void DetachFromCurrentThread() {
+    if (!attached_)
+      return;
+    attached_ = false;
+    MessageLoop::current()->RemoveTaskObserver(this);
+    base::AutoLock auto_lock(lock_);
+    function_name_ = NULL;
+  }
+
+  virtual void WillProcessTask(const Task* task) {
+    const tracked_objects::Location location = task->GetBirthPlace();
+    base::AutoLock auto_lock(lock_);
+    // The location strings are string literals, so they outlive the task.
+    function_name_ = location.function_name();
+    file_name_ = location.file_name();
+    line_number_ = location.line_number();
+    start_time_ = base::TimeTicks::Now();
+  }
+
+  virtual void DidProcessTask(const Task* task) {
+    base::AutoLock auto_lock(lock_);
+    function_name_ = NULL;
+  }
+
+  // Returns false if the watched thread is not running a task. Otherwise
+  // returns the birth place of the task being run, and how long it has been
+  // running. This method is accessible on any thread.
+  bool GetRunningTask(const char** function_name,
+                      const char** file_name,
+                      int* line_number,
+                      base::TimeDelta* running_time) {
+    base::AutoLock auto_lock(lock_);
+    if (!function_name_)
+      return false;
+    *function_name = function_name_;
+    *file_name = file_name_;
+    *line_number = line_number_;
+    *running_time = base::TimeTicks::Now() - start_time_;
+    return true;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<RunningTaskObserver>;
+
+  virtual ~RunningTaskObserver() {}
+
+  // True while the observer is attached. Only accessed on the watched thread.
+  bool attached_;
+
+  // Protects the description of the running task below.
+  base::Lock lock_;
+
+  // Birth place of the running task. function_name_ is NULL when the watched
+  // thread is not running a task.
+  const char* function_name_;
+  const char* file_name_;
+  int line_number_;
+
+  // The time the running task started.
+  base::TimeTicks start_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunningTaskObserver);
+};
+
 // ThreadWatcher methods and members.
 ThreadWatcher::ThreadWatcher(const BrowserThread::ID& thread_id,
                              const std::string& thread_name,
@@ -29,11 +121,21 @@ ThreadWatcher::ThreadWatcher(const BrowserThread::ID& thread_id,
       active_(false),
       ping_count_(kPingCount),
       histogram_(NULL),
+      running_task_histogram_(NULL),
+      task_observer_(new RunningTaskObserver),
       ALLOW_THIS_IN_INITIALIZER_LIST(method_factory_(this)) {
   Initialize();
 }
 
-ThreadWatcher::~ThreadWatcher() {}
+ThreadWatcher::~ThreadWatcher() {
+  // The posted task holds a reference to |task_observer_|, which keeps it alive
+  // until it has been detached from the watched thread's message loop.
+  BrowserThread::PostTask(
+      thread_id_,
+      FROM_HERE,
+      NewRunnableMethod(task_observer_.get(),
+                        &RunningTaskObserver::DetachFromCurrentThread));
+}
 
 // static
 void ThreadWatcher::StartWatching(const BrowserThread::ID& thread_id,
@@ -72,6 +174,13 @@ void ThreadWatcher::ActivateThreadWatching() {
   if (active_) return;
   active_ = true;
   ping_count_ = kPingCount;
+  // Start tracking the tasks run by the watched thread. This is posted before
+  // the first ping, so it is in place once the watched thread has responded.
+  BrowserThread::PostTask(
+      thread_id_,
+      FROM_HERE,
+      NewRunnableMethod(task_observer_.get(),
+                        &RunningTaskObserver::AttachToCurrentThread));
   MessageLoop::current()->PostTask(
       FROM_HERE,
       method_factory_.NewRunnableMethod(&ThreadWatcher::PostPingMessage));
@@ -82,6 +191,11 @@ void ThreadWatcher::DeActivateThreadWatching() {
   active_ = false;
   ping_count_ = 0;
   method_factory_.RevokeAll();
+  BrowserThread::PostTask(
+      thread_id_,
+      FROM_HERE,
+      NewRunnableMethod(task_observer_.get(),
+                        &RunningTaskObserver::DetachFromCurrentThread));
 }
 
 void ThreadWatcher::WakeUp() {
@@ -163,7 +277,26 @@ bool ThreadWatcher::OnCheckResponsiveness(uint64 ping_sequence_number) {
   // If the latest ping_sequence_number_ is not same as the ping_sequence_number
   // that is passed in, then we can assume OnPongMessage was called.
   // OnPongMessage increments ping_sequence_number_.
-  return ping_sequence_number_ != ping_sequence_number;
+  if (ping_sequence_number_ != ping_sequence_number)
+    return true;
+  RecordRunningTask();
+  return false;
+}
+
+void ThreadWatcher::RecordRunningTask() {
+  DCHECK(WatchDogThread::CurrentlyOnWatchDogThread());
+  const char* function_name;
+  const char* file_name;
+  int line_number;
+  base::TimeDelta running_time;
+  if (!task_observer_->GetRunningTask(&function_name, &file_name, &line_number,
+                                      &running_time))
+    return;
+  running_task_histogram_->AddTime(running_time);
+  ThreadWatcherList::RecordSlowTask(
+      thread_name_,
+      tracked_objects::Location(function_name, file_name, line_number),
+      running_time);
 }
 
 void ThreadWatcher::Initialize() {
@@ -175,6 +308,13 @@ void ThreadWatcher::Initialize() {
       base::TimeDelta::FromMilliseconds(1),
       base::TimeDelta::FromSeconds(100), 50,
       base::Histogram::kUmaTargetedHistogramFlag);
+  const std::string running_task_histogram_name =
+      "ThreadWatcher.UnresponsiveTaskTime." + thread_name_;
+  running_task_histogram_ = base::Histogram::FactoryTimeGet(
+      running_task_histogram_name,
+      base::TimeDelta::FromMilliseconds(1),
+      base::TimeDelta::FromSeconds(100), 50,
+      base::Histogram::kUmaTargetedHistogramFlag);
 }
 
 // static
@@ -190,6 +330,13 @@ void ThreadWatcher::OnPingMessage(const BrowserThread::ID& thread_id,
 // static
 ThreadWatcherList* ThreadWatcherList::global_ = NULL;
 
+ThreadWatcherList::SlowTask::SlowTask()
+    : line_number(-1),
+      count(0) {
+}
+
+ThreadWatcherList::SlowTask::~SlowTask() {}
+
 ThreadWatcherList::ThreadWatcherList()
     : last_wakeup_time_(base::TimeTicks::Now()) {
   // Assert we are not running on WATCHDOG thread. Would be ideal to assert we
@@ -283,6 +430,78 @@ void ThreadWatcherList::RemoveNotifications() {
   global_->registrar_.RemoveAll();
 }
 
+// static
+void ThreadWatcherList::RecordSlowTask(
+    const std::string& thread_name,
+    const tracked_objects::Location& location,
+    base::TimeDelta running_time) {
+  if (!global_)
+    return;
+  base::AutoLock auto_lock(global_->lock_);
+  SlowTaskList& slow_tasks = global_->slow_tasks_;
+  SlowTask* slow_task = NULL;
+  for (SlowTaskList::iterator it = slow_tasks.begin();
+       it != slow_tasks.end(); ++it) {
+    if (it->thread_name == thread_name &&
+        it->line_number == location.line_number() &&
+        it->function_name == location.function_name() &&
+        it->file_name == location.file_name()) {
+      slow_task = &(*it);
+      break;
+    }
+  }
+  if (!slow_task) {
+    if (slow_tasks.size() >= kMaxSlowTasks)
+      return;
+    slow_tasks.push_back(SlowTask());
+    slow_task = &slow_tasks.back();
+    slow_task->thread_name = thread_name;
+    slow_task->function_name = location.function_name();
+    slow_task->file_name = location.file_name();
+    slow_task->line_number = location.line_number();
+  }
+  ++slow_task->count;
+  if (running_time > slow_task->max_running_time)
+    slow_task->max_running_time = running_time;
+}
+
+// static
+void ThreadWatcherList::GetSlowTasks(SlowTaskList* slow_tasks) {
+  slow_tasks->clear();
+  if (!global_)
+    return;
+  base::AutoLock auto_lock(global_->lock_);
+  *slow_tasks = global_->slow_tasks_;
+}
+
+// static
+void ThreadWatcherList::WriteSlowTasksHTML(std::string* output) {
+  SlowTaskList slow_tasks;
+  GetSlowTasks(&slow_tasks);
+  if (slow_tasks.empty())
+    return;
+
+  output->append("<h2>Tasks running on unresponsive threads</h2>");
+  output->append("<table border>");
+  output->append("<tr><th>Thread</th><th>Count</th>"
+                 "<th>Max running time (ms)</th><th>Birth place</th></tr>");
+  for (SlowTaskList::const_iterator it = slow_tasks.begin();
+       it != slow_tasks.end(); ++it) {
+    base::StringAppendF(output,
+                        "<tr><td>%s</td><td>%d</td><td>%d</td>",
+                        EscapeForHTML(it->thread_name).c_str(),
+                        it->count,
+                        static_cast<int>(
+                            it->max_running_time.InMilliseconds()));
+    base::StringAppendF(output,
+                        "<td>%s [%s:%d]</td></tr>",
+                        EscapeForHTML(it->function_name).c_str(),
+                        EscapeForHTML(it->file_name).c_str(),
+                        it->line_number);
+  }
+  output->append("</table>");
+}
+
 void ThreadWatcherList::DeleteAll() {
   DCHECK(WatchDogThread::CurrentlyOnWatchDogThread());
   base::AutoLock auto_lock(lock_);
@@ -10,7 +10,14 @@
 //
 // ThreadWatcher class sends ping message to the watched thread and the watched
 // thread responds back with a pong message. It uploads response time
-// (difference between ping and pong times) as a histogram.
+// (difference between ping and pong times) as a histogram. Since the ping
+// message waits in the watched thread's queue behind all other tasks, the
+// response time is a sample of that thread's queueing delay.
+//
+// ThreadWatcher also observes which task the watched thread is running. When
+// the watched thread fails to respond within unresponsive_time, the birth place
+// of the running task (as recorded with TRACK_ALL_TASK_OBJECTS) and how long it
+// has been running are recorded in ThreadWatcherList, and shown in about:tasks.
 //
 // TODO(raman): ThreadWatcher can detect hung threads. If a hung thread is
 // detected, we should probably just crash, and allow the crash system to gather
@@ -127,23 +134,32 @@ class ThreadWatcher {
   // This method will determine if the watched thread is responsive or not. If
   // the latest ping_sequence_number_ is not same as the ping_sequence_number
   // that is passed in, then we can assume that watched thread has responded
-  // with a pong message.
+  // with a pong message. If the watched thread is not responsive, the task
+  // that it is running is recorded in ThreadWatcherList.
   // This method is accessible on WatchDogThread.
   virtual bool OnCheckResponsiveness(uint64 ping_sequence_number);
 
  private:
   friend class ThreadWatcherList;
 
+  class RunningTaskObserver;
+
   // Allow tests to access our innards for testing purposes.
   FRIEND_TEST_ALL_PREFIXES(ThreadWatcherTest, Registration);
   FRIEND_TEST_ALL_PREFIXES(ThreadWatcherTest, ThreadResponding);
   FRIEND_TEST_ALL_PREFIXES(ThreadWatcherTest, ThreadNotResponding);
   FRIEND_TEST_ALL_PREFIXES(ThreadWatcherTest, MultipleThreadsResponding);
   FRIEND_TEST_ALL_PREFIXES(ThreadWatcherTest, MultipleThreadsNotResponding);
+  FRIEND_TEST_ALL_PREFIXES(ThreadWatcherTest, SlowTaskAttribution);
 
   // Post constructor initialization.
   void Initialize();
 
+  // Records the task that the watched thread is currently running (if any) as
+  // the cause of the watched thread not responding.
+  // This method is accessible on WatchDogThread.
+  void RecordRunningTask();
+
   // Watched thread does nothing except post callback_task to the WATCHDOG
   // Thread. This method is called on watched thread.
   static void OnPingMessage(const BrowserThread::ID& thread_id,
@@ -188,6 +204,14 @@ class ThreadWatcher {
   // Histogram that keeps track of response times for the watched thread.
   base::Histogram* histogram_;
 
+  // Histogram that keeps track of how long the task running on an unresponsive
+  // watched thread had been running.
+  base::Histogram* running_task_histogram_;
+
+  // Tracks the task being run by the watched thread. It is attached to the
+  // watched thread's message loop while thread watching is active.
+  scoped_refptr<RunningTaskObserver> task_observer_;
+
   // We use this factory to create callback tasks for ThreadWatcher object. We
   // use this during ping-pong messaging between WatchDog thread and watched
   // thread.
@@ -205,6 +229,24 @@ class ThreadWatcherList : public NotificationObserver {
   // A map from BrowserThread to the actual instances.
   typedef std::map<BrowserThread::ID, ThreadWatcher*> RegistrationList;
 
+  // A task that was found running on a watched thread when that thread did not
+  // respond to a ping in time.
+  struct SlowTask {
+    SlowTask();
+    ~SlowTask();
+
+    std::string thread_name;
+    // Birth place of the task.
+    std::string function_name;
+    std::string file_name;
+    int line_number;
+    // Number of times the task was found running on an unresponsive thread.
+    int count;
+    // The longest time the task was observed to have been running.
+    base::TimeDelta max_running_time;
+  };
+  typedef std::vector<SlowTask> SlowTaskList;
+
   // This singleton holds the global list of registered ThreadWatchers.
   ThreadWatcherList();
   // Destructor deletes all registered ThreadWatcher instances.
@@ -231,6 +273,22 @@ class ThreadWatcherList : public NotificationObserver {
   // This method is accessible on UI thread.
   static void RemoveNotifications();
 
+  // Records that the task born at |location| had been running for
+  // |running_time| on the thread named |thread_name| when that thread was found
+  // to be unresponsive.
+  // This method is accessible on any thread.
+  static void RecordSlowTask(const std::string& thread_name,
+                             const tracked_objects::Location& location,
+                             base::TimeDelta running_time);
+
+  // Returns a copy of all the slow tasks that have been recorded.
+  // This method is accessible on any thread.
+  static void GetSlowTasks(SlowTaskList* slow_tasks);
+
+  // Appends an HTML table of the recorded slow tasks to |output|.
+  // This method is accessible on any thread.
+  static void WriteSlowTasksHTML(std::string* output);
+
  private:
   // Allow tests to access our innards for testing purposes.
   FRIEND_TEST_ALL_PREFIXES(ThreadWatcherTest, Registration);
@@ -268,6 +326,10 @@ class ThreadWatcherList : public NotificationObserver {
   // Map of all registered watched threads, from thread_id to ThreadWatcher.
   RegistrationList registered_;
 
+  // List of tasks that were running on unresponsive watched threads. Guarded by
+  // lock_.
+  SlowTaskList slow_tasks_;
+
   // The registrar that holds NotificationTypes to be observed.
   NotificationRegistrar registrar_;
 
@@ -463,3 +463,56 @@ TEST_F(ThreadWatcherTest, MultipleThreadsNotResponding) {
   // Wait for the io_watcher_'s VeryLongMethod to finish.
   io_watcher_->WaitForWaitStateChange(kUnresponsiveTime * 10, ALL_DONE);
 }
+
+// Test that when a watched thread is busy running a slow task, the birth place
+// of that task is recorded as the cause of the thread not responding.
+TEST_F(ThreadWatcherTest, SlowTaskAttribution) {
+  // Activate thread watching, and wait for a pong so that the watched thread is
+  // known to be tracking the tasks it runs.
+  WatchDogThread::PostTask(
+      FROM_HERE,
+      NewRunnableMethod(io_watcher_, &ThreadWatcher::ActivateThreadWatching));
+  io_watcher_->WaitForStateChange(kSleepTime + TimeDelta::FromMinutes(1),
+                                  RECEIVED_PONG);
+
+  // Inject a slow task, and make sure pings keep being sent to the IO thread.
+  BrowserThread::PostTask(
+      io_thread_id,
+      FROM_HERE,
+      NewRunnableMethod(
+          io_watcher_,
+          &CustomThreadWatcher::VeryLongMethod,
+          kUnresponsiveTime * 10));
+  WatchDogThread::PostTask(
+      FROM_HERE,
+      NewRunnableMethod(io_watcher_, &ThreadWatcher::WakeUp));
+
+  // Verify watched thread is not responding for ping messages.
+  io_watcher_->WaitForCheckResponse(
+      kUnresponsiveTime + TimeDelta::FromMinutes(1), FAILED);
+  EXPECT_GT(io_watcher_->failed_response_, static_cast<uint64>(0));
+
+  // The slow task should have been recorded against the IO thread.
+  ThreadWatcherList::SlowTaskList slow_tasks;
+  ThreadWatcherList::GetSlowTasks(&slow_tasks);
+  ASSERT_EQ(1u, slow_tasks.size());
+  EXPECT_EQ(io_thread_name, slow_tasks[0].thread_name);
+  EXPECT_GT(slow_tasks[0].count, 0);
+  EXPECT_GE(slow_tasks[0].max_running_time, kUnresponsiveTime / 2);
+#if defined(TRACK_ALL_TASK_OBJECTS)
+  // Birth places are only recorded when tasks are tracked.
+  EXPECT_EQ(std::string(__FILE__), slow_tasks[0].file_name);
+#endif
+
+  std::string html;
+  ThreadWatcherList::WriteSlowTasksHTML(&html);
+  EXPECT_NE(std::string::npos, html.find(io_thread_name));
+
+  // DeActivate thread watching for shutdown.
+  WatchDogThread::PostTask(
+      FROM_HERE,
+      NewRunnableMethod(io_watcher_, &ThreadWatcher::DeActivateThreadWatching));
+
+  // Wait for the io_watcher_'s VeryLongMethod to finish.
+  io_watcher_->WaitForWaitStateChange(kUnresponsiveTime * 10, ALL_DONE);
+}
@@ -32,6 +32,8 @@ const double Predictor::kPreconnectWorthyExpectedValue = 0.8;
 // static
 const double Predictor::kDNSPreresolutionWorthyExpectedValue = 0.1;
 // static
+const double Predictor::kPreconnectWorthyAccuracy = 0.5;
+// static
 const double Predictor::kDiscardableExpectedValue = 0.05;
 // The goal is of trimming is to to reduce the importance (number of expected
 // subresources needed) by a factor of 2 after about 24 hours of uptime. We will
@@ -281,18 +283,29 @@ void Predictor::PrepareFrameSubresources(const GURL& url) {
     UMA_HISTOGRAM_CUSTOM_COUNTS("Net.PreconnectSubresourceExpectation",
                                 static_cast<int>(connection_expectation * 100),
                                 10, 5000, 50);
+    double prediction_accuracy = future_url->second.prediction_accuracy();
+    UMA_HISTOGRAM_PERCENTAGE("Net.PreconnectSubresourceAccuracy",
+                             static_cast<int>(prediction_accuracy * 100));
     future_url->second.ReferrerWasObserved();
     if (preconnect_enabled_ &&
-        connection_expectation > kPreconnectWorthyExpectedValue) {
+        connection_expectation > kPreconnectWorthyExpectedValue &&
+        prediction_accuracy >= kPreconnectWorthyAccuracy) {
       evalution = PRECONNECTION;
       future_url->second.IncrementPreconnectionCount();
+      future_url->second.PredictionWasMade(true);
       int count = static_cast<int>(std::ceil(connection_expectation));
       if (url.host() == future_url->first.host())
         ++count;
+      // For https subresources, the preconnection also completes the SSL
+      // handshake, so the warmed socket is ready for use.
       PreconnectOnIOThread(future_url->first, motivation, count);
     } else if (connection_expectation > kDNSPreresolutionWorthyExpectedValue) {
       evalution = PRERESOLUTION;
       future_url->second.preresolution_increment();
+      // Keep scoring our predictions while we only pre-resolve, so that a
+      // subresource that becomes predictable again can regain preconnection.
+      if (connection_expectation > kPreconnectWorthyExpectedValue)
+        future_url->second.PredictionWasMade(false);
       UrlInfo* queued_info = AppendToResolutionQueue(future_url->first,
                                                      motivation);
       if (queued_info)
@@ -388,6 +401,9 @@ void Predictor::GetHtmlReferrerLists(std::string* output) {
       "<th>Subresource<br>PreConnects</th>"
       "<th>Subresource<br>PreResolves</th>"
       "<th>Expected<br>Connects</th>"
+      "<th>Prediction<br>Accuracy</th>"
+      "<th>PreConnect<br>Hits</th>"
+      "<th>PreConnect<br>Wasted</th>"
       "<th>Subresource Spec</th></tr>");
 
   for (SortedNames::iterator it = sorted_names.begin();
@@ -407,11 +423,15 @@ void Predictor::GetHtmlReferrerLists(std::string* output) {
       }
       first_set_of_futures = false;
       base::StringAppendF(output,
-          "<td>%d</td><td>%d</td><td>%d</td><td>%2.3f</td><td>%s</td></tr>",
+          "<td>%d</td><td>%d</td><td>%d</td><td>%2.3f</td><td>%2.3f</td>"
+          "<td>%d</td><td>%d</td><td>%s</td></tr>",
           static_cast<int>(future_url->second.navigation_count()),
           static_cast<int>(future_url->second.preconnection_count()),
           static_cast<int>(future_url->second.preresolution_count()),
           static_cast<double>(future_url->second.subresource_use_rate()),
+          static_cast<double>(future_url->second.prediction_accuracy()),
+          static_cast<int>(future_url->second.preconnection_hit_count()),
+          static_cast<int>(future_url->second.preconnection_waste_count()),
           future_url->first.spec().c_str());
     }
   }
@@ -51,7 +51,7 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
  public:
   // A version number for prefs that are saved. This should be incremented when
   // we change the format so that we discard old data.
-  enum { PREDICTOR_REFERRER_VERSION = 2 };
+  enum { PREDICTOR_REFERRER_VERSION = 3 };
 
   // |max_concurrent| specifies how many concurrent (parallel) prefetches will
   // be performed. Host lookups will be issued through |host_resolver|.
@@ -145,6 +145,7 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueuePushPopTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueueReorderTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, ReferrerSerializationTrimTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, ReplayNavigationTraceTest);
   friend class WaitForResolutionHelper;  // For testing.
 
   class LookupRequest;
@@ -186,6 +187,11 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
   // nothing).  The following are the threasholds for taking those actions.
   static const double kPreconnectWorthyExpectedValue;
   static const double kDNSPreresolutionWorthyExpectedValue;
+  // Even when many connections are expected, we only preconnect to a
+  // subresource if past predictions for it were mostly followed by a real need.
+  // Subresources whose predictions are less accurate than this are only
+  // pre-resolved, so that we don't keep wasting connections on them.
+  static const double kPreconnectWorthyAccuracy;
   // Referred hosts with a subresource_use_rate_ that are less than the
   // following threshold will be discarded when we Trim() the list.
   static const double kDiscardableExpectedValue;
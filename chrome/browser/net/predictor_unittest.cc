@@ -288,8 +288,8 @@ static ListValue* NewEmptySerializationList() {
 }
 
 // Add a motivating_url and a subresource_url to a serialized list, using
-// this given latency. This is a helper function for quickly building these
-// lists.
+// this given latency, and a perfect prediction accuracy. This is a helper
+// function for quickly building these lists.
 static void AddToSerializedList(const GURL& motivation,
                                 const GURL& subresource,
                                 double use_rate,
@@ -318,6 +318,7 @@ static void AddToSerializedList(const GURL& motivation,
 
   subresource_list->Append(new StringValue(subresource.spec()));
   subresource_list->Append(new FundamentalValue(use_rate));
+  subresource_list->Append(new FundamentalValue(1.0));
 }
 
 static const int kLatencyNotFound = -1;
@@ -340,6 +341,8 @@ static bool GetDataFromSerialization(const GURL& motivation,
     std::string url_spec;
     EXPECT_TRUE(subresource_list->GetString(i++, &url_spec));
     EXPECT_TRUE(subresource_list->GetDouble(i++, use_rate));
+    double accuracy;
+    EXPECT_TRUE(subresource_list->GetDouble(i++, &accuracy));
     if (subresource == GURL(url_spec)) {
       return true;
     }
@@ -491,6 +494,69 @@ TEST_F(PredictorTest, ReferrerSerializationTrimTest) {
   predictor->Shutdown();
 }
 
+// Replay a recorded navigation trace through the learning and prediction
+// paths, and measure how many of the resulting preconnections were used.
+TEST_F(PredictorTest, ReplayNavigationTraceTest) {
+  scoped_refptr<Predictor> predictor(
+      new Predictor(host_resolver_.get(),
+                    default_max_queueing_delay_,
+                    PredictorInit::kMaxSpeculativeParallelResolves,
+                    true));
+  const GURL page_url("http://www.google.com:80");
+  // Needed on every visit to the page.
+  const GURL stable_url("http://icons.google.com:80");
+  // Needed (with a burst of connections) on only one visit in four.
+  const GURL flaky_url("http://ads.google.com:80");
+  host_resolver_->rules()->AddRule("icons.google.com", "127.0.0.1");
+  host_resolver_->rules()->AddRule("ads.google.com", "127.0.0.1");
+
+  const int kVisits = 200;
+  const int kFlakyPeriod = 4;
+  const int kFlakyConnections = 4;
+  for (int visit = 0; visit < kVisits; ++visit) {
+    predictor->PrepareFrameSubresources(page_url);
+    predictor->LearnFromNavigation(page_url, stable_url);
+    if (visit % kFlakyPeriod == 0) {
+      for (int i = 0; i < kFlakyConnections; ++i)
+        predictor->LearnFromNavigation(page_url, flaky_url);
+    }
+  }
+
+  Referrer* referrer = &predictor->referrers_[page_url];
+  const ReferrerValue& stable = (*referrer)[stable_url];
+  const ReferrerValue& flaky = (*referrer)[flaky_url];
+
+  // The first visit taught us about both subresources, so every later visit
+  // predicted (and preconnected) the stable subresource, and it was always
+  // needed.
+  EXPECT_EQ(kVisits - 1, stable.preconnection_hit_count());
+  EXPECT_EQ(0, stable.preconnection_waste_count());
+  EXPECT_GE(stable.prediction_accuracy(), Predictor::kPreconnectWorthyAccuracy);
+
+  // Connections to the flaky subresource are usually wasted, so we should
+  // have learned to stop preconnecting to it long before the trace ended.
+  EXPECT_LT(flaky.prediction_accuracy(), Predictor::kPreconnectWorthyAccuracy);
+  int64 flaky_preconnections =
+      flaky.preconnection_hit_count() + flaky.preconnection_waste_count();
+  EXPECT_LT(flaky_preconnections, kVisits / kFlakyPeriod);
+
+  // Overall, most speculative connections should have been used.
+  int64 hits = stable.preconnection_hit_count() +
+      flaky.preconnection_hit_count();
+  int64 wasted = stable.preconnection_waste_count() +
+      flaky.preconnection_waste_count();
+  EXPECT_GT(hits, 10 * wasted);
+
+  // The learned accuracy survives a round trip through the persisted format.
+  ListValue referral_list;
+  predictor->SerializeReferrers(&referral_list);
+  predictor->DiscardAllResults();
+  predictor->DeserializeReferrers(referral_list);
+  EXPECT_LT((predictor->referrers_[page_url])[flaky_url].prediction_accuracy(),
+            Predictor::kPreconnectWorthyAccuracy);
+
+  predictor->Shutdown();
+}
 
 TEST_F(PredictorTest, PriorityQueuePushPopTest) {
   Predictor::HostNameQueue queue;
@@ -50,6 +50,15 @@ static const double kWeightingForOldConnectsExpectedValue = 0.66;
 // a starting point.
 static const double kInitialConnectsExpectedValue = 2.0;
 
+// The prediction accuracy is smoothed in the same way as the expected number of
+// connections (see above), but with a longer memory, so that a single surprise
+// does not swing our decision to preconnect.
+static const double kWeightingForOldPredictionAccuracy = 0.8;
+
+// New subresources are optimistically assumed to be perfectly predictable, so
+// that we preconnect to them until we learn otherwise.
+static const double kInitialPredictionAccuracy = 1.0;
+
 Referrer::Referrer() : use_count_(1) {}
 
 void Referrer::SuggestHost(const GURL& url) {
@@ -132,6 +141,9 @@ void Referrer::Deserialize(const Value& value) {
     double rate;
     if (!subresource_list->GetDouble(index++, &rate))
       return;
+    double accuracy;
+    if (!subresource_list->GetDouble(index++, &accuracy))
+      return;
 
     GURL url(url_spec);
     // TODO(jar): We could be more direct, and change birth date or similar to
@@ -141,6 +153,7 @@ void Referrer::Deserialize(const Value& value) {
     // with the same birth date (typically start of process).
     SuggestHost(url);
     (*this)[url].SetSubresourceUseRate(rate);
+    (*this)[url].SetPredictionAccuracy(accuracy);
   }
 }
 
@@ -150,9 +163,12 @@ Value* Referrer::Serialize() const {
     StringValue* url_spec(new StringValue(it->first.spec()));
     FundamentalValue* rate(new FundamentalValue(
         it->second.subresource_use_rate()));
+    FundamentalValue* accuracy(new FundamentalValue(
+        it->second.prediction_accuracy()));
 
     subresource_list->Append(url_spec);
     subresource_list->Append(rate);
+    subresource_list->Append(accuracy);
   }
   return subresource_list;
 }
@@ -164,7 +180,12 @@ ReferrerValue::ReferrerValue()
       navigation_count_(0),
       preconnection_count_(0),
       preresolution_count_(0),
-      subresource_use_rate_(kInitialConnectsExpectedValue) {
+      subresource_use_rate_(kInitialConnectsExpectedValue),
+      prediction_accuracy_(kInitialPredictionAccuracy),
+      preconnection_hit_count_(0),
+      preconnection_waste_count_(0),
+      prediction_pending_(false),
+      preconnection_pending_(false) {
 }
 
 void ReferrerValue::SubresourceIsNeeded() {
@@ -172,9 +193,11 @@ void ReferrerValue::SubresourceIsNeeded() {
   DCHECK_LE(kWeightingForOldConnectsExpectedValue, 1.0);
   ++navigation_count_;
   subresource_use_rate_ += 1 - kWeightingForOldConnectsExpectedValue;
+  ScorePendingPrediction(true);
 }
 
 void ReferrerValue::ReferrerWasObserved() {
+  ScorePendingPrediction(false);
   subresource_use_rate_ *= kWeightingForOldConnectsExpectedValue;
   // Note: the use rate is temporarilly possibly incorect, as we need to find
   // out if we really end up connecting.  This will happen in a few hundred
@@ -182,4 +205,26 @@ void ReferrerValue::ReferrerWasObserved() {
   // Value of subresource_use_rate_ should be sampled before this call.
 }
 
+void ReferrerValue::PredictionWasMade(bool preconnected) {
+  DCHECK(!prediction_pending_);
+  prediction_pending_ = true;
+  preconnection_pending_ = preconnected;
+}
+
+void ReferrerValue::ScorePendingPrediction(bool was_needed) {
+  if (!prediction_pending_)
+    return;
+  prediction_accuracy_ *= kWeightingForOldPredictionAccuracy;
+  if (was_needed)
+    prediction_accuracy_ += 1 - kWeightingForOldPredictionAccuracy;
+  if (preconnection_pending_) {
+    if (was_needed)
+      ++preconnection_hit_count_;
+    else
+      ++preconnection_waste_count_;
+  }
+  prediction_pending_ = false;
+  preconnection_pending_ = false;
+}
+
 }  // namespace chrome_browser_net
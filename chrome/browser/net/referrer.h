@@ -38,6 +38,9 @@ class ReferrerValue {
 
   // Used during deserialization.
   void SetSubresourceUseRate(double rate) { subresource_use_rate_ = rate; }
+  void SetPredictionAccuracy(double accuracy) {
+    prediction_accuracy_ = accuracy;
+  }
 
   base::Time birth_time() const { return birth_time_; }
 
@@ -48,9 +51,28 @@ class ReferrerValue {
   // Record the fact that the referrer of this subresource was observed. This
   // will diminish the expected subresource_use_rate_ (and will only be
   // counteracted later if we really needed this subresource as a consequence
-  // of our associated referrer.)
+  // of our associated referrer.)  Any prediction still outstanding from the
+  // previous observation is scored as a miss.
   void ReferrerWasObserved();
 
+  // Record the fact that we predicted a connection to this subresource would be
+  // needed after the referrer was observed.  |preconnected| indicates whether
+  // we acted on the prediction by opening connections.  The prediction is
+  // scored as a hit by the next call to SubresourceIsNeeded(), or as a miss by
+  // the next call to ReferrerWasObserved().
+  void PredictionWasMade(bool preconnected);
+
+  // A smoothed estimate (between 0 and 1) of how often a predicted connection
+  // to this subresource was really needed.
+  double prediction_accuracy() const { return prediction_accuracy_; }
+
+  // The number of preconnections that were (or were not) followed by a real
+  // need for this subresource.
+  int64 preconnection_hit_count() const { return preconnection_hit_count_; }
+  int64 preconnection_waste_count() const {
+    return preconnection_waste_count_;
+  }
+
   int64 navigation_count() const { return navigation_count_; }
   double subresource_use_rate() const { return subresource_use_rate_; }
 
@@ -65,6 +87,9 @@ class ReferrerValue {
   bool Trim(double reduce_rate, double threshold);
 
  private:
+  // Score the pending prediction (if any) as a hit or a miss.
+  void ScorePendingPrediction(bool was_needed);
+
   const base::Time birth_time_;
 
   // The number of times this item was navigated to with the fixed referrer.
@@ -81,6 +106,20 @@ class ReferrerValue {
   // A smoothed estimate of the expected number of connections that will be made
   // to this subresource.
   double subresource_use_rate_;
+
+  // A smoothed estimate of the fraction of predictions that were followed by a
+  // real need for this subresource.
+  double prediction_accuracy_;
+
+  // The number of preconnections that were followed by a need for this
+  // subresource, and the number that were not (and hence were wasted).
+  int64 preconnection_hit_count_;
+  int64 preconnection_waste_count_;
+
+  // True while a prediction made by PredictionWasMade() has not yet been
+  // scored, and whether connections were opened as part of that prediction.
+  bool prediction_pending_;
+  bool preconnection_pending_;
 };
 
 //------------------------------------------------------------------------------
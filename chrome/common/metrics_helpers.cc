@@ -14,9 +14,11 @@
 #include "base/time.h"
 #include "base/basictypes.h"
 #include "base/file_util.h"
+#include "base/lazy_instance.h"
 #include "base/md5.h"
 #include "base/perftimer.h"
 #include "base/string_number_conversions.h"
+#include "base/synchronization/lock.h"
 #include "base/sys_info.h"
 #include "base/utf_string_conversions.h"
 #include "base/third_party/nspr/prtime.h"
@@ -43,6 +45,40 @@ inline const unsigned char* UnsignedChar(const char* input) {
   return reinterpret_cast<const unsigned char*>(input);
 }
 
+// Every log lists the same (few thousand) histograms by the hash of their
+// names, so we remember the hashes rather than recomputing an MD5 and a base64
+// encoding for each histogram at every log rotation.
+class HistogramNameHashCache {
+ public:
+  HistogramNameHashCache() {}
+
+  std::string GetHash(const std::string& histogram_name) {
+    {
+      base::AutoLock auto_lock(lock_);
+      HashMap::const_iterator it = hashes_.find(histogram_name);
+      if (it != hashes_.end())
+        return it->second;
+    }
+    std::string hash = MetricsLogBase::CreateBase64Hash(histogram_name);
+    if (!hash.empty()) {
+      base::AutoLock auto_lock(lock_);
+      hashes_[histogram_name] = hash;
+    }
+    return hash;
+  }
+
+ private:
+  typedef std::map<std::string, std::string> HashMap;
+
+  base::Lock lock_;
+  HashMap hashes_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramNameHashCache);
+};
+
+base::LazyInstance<HistogramNameHashCache> g_histogram_name_hashes(
+    base::LINKER_INITIALIZED);
+
 }  // namespace
 
 class MetricsLogBase::XmlWrapper {
@@ -398,7 +434,9 @@ void MetricsLogBase::RecordHistogramDelta(
 
   OPEN_ELEMENT_FOR_SCOPE("histogram");
 
-  WriteAttribute("name", CreateBase64Hash(histogram.histogram_name()));
+  WriteAttribute("name",
+                 g_histogram_name_hashes.Get().GetHash(
+                     histogram.histogram_name()));
 
   WriteInt64Attribute("sum", snapshot.sum());
   // TODO(jar): Remove sumsquares when protobuffer accepts this as optional.
@@ -450,20 +488,25 @@ bool MetricsServiceBase::Bzip2Compress(const std::string& input,
     return false;
   }
 
-  output->clear();
-
   stream.next_in = const_cast<char*>(input.data());
   stream.avail_in = static_cast<int>(input.size());
+  // Size the output for bzip2's worst case (1% expansion plus 600 bytes), so
+  // that the whole log is normally compressed in a single pass, without
+  // repeatedly growing (and copying) the output buffer.
+  output->resize(input.size() + input.size() / 100 + 600);
   // NOTE: we don't need a BZ_RUN phase since our input buffer contains
   //       the entire input
   do {
-    output->resize(output->size() + 1024);
+    if (stream.total_out_lo32 == output->size())
+      output->resize(output->size() * 2);
     stream.next_out = &((*output)[stream.total_out_lo32]);
     stream.avail_out = static_cast<int>(output->size()) - stream.total_out_lo32;
     result = BZ2_bzCompress(&stream, BZ_FINISH);
   } while (result == BZ_FINISH_OK);
-  if (result != BZ_STREAM_END)  // unknown failure?
+  if (result != BZ_STREAM_END) {  // unknown failure?
+    BZ2_bzCompressEnd(&stream);
     return false;
+  }
   result = BZ2_bzCompressEnd(&stream);
   DCHECK(result == BZ_OK);
 
@@ -0,0 +1,104 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/metrics/histogram.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "chrome/common/metrics_helpers.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::Histogram;
+using base::StatisticsRecorder;
+
+namespace {
+
+// Number of UMA histograms registered before building logs.  Devices with
+// many features enabled record a few thousand.
+const int kHistogramCount = 3000;
+
+// Number of log rotations to time.
+const int kLogRotations = 20;
+
+// Exposes the log building and compression steps of MetricsServiceBase.
+class TestMetricsService : public MetricsServiceBase {
+ public:
+  TestMetricsService() {}
+  virtual ~TestMetricsService() {}
+
+  // Builds a closed log with the histogram deltas since the previous call, and
+  // returns its uncompressed and compressed sizes.
+  void BuildLog(size_t* text_size, size_t* compressed_size) {
+    DCHECK(!current_log_);
+    current_log_ = new MetricsLogBase("perftest client ID", 0, "0.0.0.0");
+    RecordCurrentHistograms();
+    current_log_->CloseLog();
+
+    std::string text = current_log_->GetEncodedLogString();
+    std::string compressed;
+    ASSERT_TRUE(Bzip2Compress(text, &compressed));
+    *text_size = text.size();
+    *compressed_size = compressed.size();
+
+    delete current_log_;
+    current_log_ = NULL;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TestMetricsService);
+};
+
+class MetricsHelpersPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    for (int i = 0; i < kHistogramCount; ++i) {
+      histograms_[i] = Histogram::FactoryGet(
+          base::StringPrintf("MetricsHelpersPerfTest.Histogram%d", i),
+          1, 10000, 50, Histogram::kUmaTargetedHistogramFlag);
+    }
+  }
+
+  // Adds a few samples to every |stride|th histogram.
+  void AddSamples(int stride) {
+    for (int i = 0; i < kHistogramCount; i += stride) {
+      for (int sample = 1; sample < 10000; sample *= 3)
+        histograms_[i]->Add(sample + i);
+    }
+  }
+
+  StatisticsRecorder recorder_;
+  Histogram* histograms_[kHistogramCount];
+};
+
+}  // namespace
+
+TEST_F(MetricsHelpersPerfTest, BuildAndCompressLogs) {
+  printf("\n");
+  TestMetricsService service;
+  size_t text_size = 0;
+  size_t compressed_size = 0;
+
+  // The first log carries every histogram.
+  AddSamples(1);
+  PerfTimeLogger full_timer("metrics_log_build_full");
+  service.BuildLog(&text_size, &compressed_size);
+  full_timer.Done();
+  LogPerfResult("metrics_log_size_full", static_cast<double>(text_size),
+                "bytes");
+  LogPerfResult("metrics_log_compressed_size_full",
+                static_cast<double>(compressed_size), "bytes");
+
+  // Later logs only carry the histograms that changed since the last log.
+  PerfTimeLogger delta_timer("metrics_log_build_delta");
+  for (int i = 0; i < kLogRotations; ++i) {
+    AddSamples(10);
+    service.BuildLog(&text_size, &compressed_size);
+  }
+  delta_timer.Done();
+  LogPerfResult("metrics_log_size_delta", static_cast<double>(text_size),
+                "bytes");
+  LogPerfResult("metrics_log_compressed_size_delta",
+                static_cast<double>(compressed_size), "bytes");
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "crypto/encryptor.h"
+
+#include "base/logging.h"
+
+namespace crypto {
+
+// static
+const size_t Encryptor::kGCMTagSize = 16;
+
+bool Encryptor::Encrypt(const base::StringPiece& plaintext,
+                        std::string* ciphertext) {
+  // Work on the result in a local variable, and then only transfer it to
+  // |ciphertext| on success to ensure no partial data is returned.
+  std::string result;
+  bool ok = StartEncrypting() &&
+            UpdatePlatform(plaintext, &result) &&
+            FinishPlatform(&result);
+  in_progress_ = false;
+  if (!ok)
+    return false;
+  ciphertext->swap(result);
+  return true;
+}
+
+bool Encryptor::Decrypt(const base::StringPiece& ciphertext,
+                        std::string* plaintext) {
+  if (ciphertext.empty())
+    return false;
+
+  std::string result;
+  bool ok = StartDecrypting() &&
+            UpdatePlatform(ciphertext, &result) &&
+            FinishPlatform(&result);
+  in_progress_ = false;
+  if (!ok)
+    return false;
+  plaintext->swap(result);
+  return true;
+}
+
+bool Encryptor::StartEncrypting() {
+  DCHECK(key_);  // Must call Init() before En/De-crypt.
+  encrypting_ = true;
+  in_progress_ = StartPlatform(true);
+  return in_progress_;
+}
+
+bool Encryptor::StartDecrypting() {
+  DCHECK(key_);  // Must call Init() before En/De-crypt.
+  encrypting_ = false;
+  in_progress_ = StartPlatform(false);
+  return in_progress_;
+}
+
+bool Encryptor::Update(const base::StringPiece& input, std::string* output) {
+  output->clear();
+  if (!in_progress_) {
+    NOTREACHED() << "Update() called without StartEncrypting/Decrypting()";
+    return false;
+  }
+  if (!UpdatePlatform(input, output)) {
+    in_progress_ = false;
+    output->clear();
+    return false;
+  }
+  return true;
+}
+
+bool Encryptor::Finish(std::string* output) {
+  output->clear();
+  if (!in_progress_) {
+    NOTREACHED() << "Finish() called without StartEncrypting/Decrypting()";
+    return false;
+  }
+  in_progress_ = false;
+  if (!FinishPlatform(output)) {
+    output->clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace crypto
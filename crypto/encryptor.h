@@ -8,23 +8,54 @@
 
 #include <string>
 
+#include "base/basictypes.h"
+#include "base/string_piece.h"
 #include "build/build_config.h"
 
 #if defined(USE_NSS)
 #include "crypto/scoped_nss_types.h"
+#elif defined(OS_MACOSX)
+#include <CommonCrypto/CommonCryptor.h>
 #elif defined(OS_WIN)
 #include "crypto/scoped_capi_types.h"
 #endif
 
+#if defined(USE_OPENSSL)
+struct evp_cipher_ctx_st;
+#endif
+
 namespace crypto {
 
 class SymmetricKey;
 
+// Encrypts and decrypts with AES.  An Encryptor is initialized once for a key
+// and can then process any number of messages, either in one call with
+// Encrypt()/Decrypt() or in chunks with the streaming interface:
+//
+//   encryptor.StartEncrypting();
+//   while (...) {
+//     encryptor.Update(chunk, &output);
+//     ... write out |output| ...
+//   }
+//   encryptor.Finish(&output);
+//   ... write out |output| ...
+//
+// The platform cipher context is kept between messages, so the key schedule
+// is only computed once.
 class Encryptor {
  public:
   enum Mode {
-    CBC
+    // CBC with PKCS#7 padding.
+    CBC,
+    // GCM with a 96-bit IV.  The ciphertext is followed by a kGCMTagSize byte
+    // authentication tag, which is checked on decryption.  Not every platform
+    // supports GCM; Init() returns false where it is not available.
+    GCM,
   };
+
+  // Size of the authentication tag appended to the ciphertext in GCM mode.
+  static const size_t kGCMTagSize;
+
   Encryptor();
   virtual ~Encryptor();
 
@@ -32,36 +63,90 @@ class Encryptor {
   // key or the initialization vector cannot be used.
   bool Init(SymmetricKey* key, Mode mode, const std::string& iv);
 
+  // Replaces the initialization vector for the following messages.  In GCM
+  // mode an IV must never be used twice with the same key, so this has to be
+  // called before each message.  Returns false if |iv| cannot be used.
+  bool SetIV(const std::string& iv);
+
   // Encrypts |plaintext| into |ciphertext|.
-  bool Encrypt(const std::string& plaintext, std::string* ciphertext);
+  bool Encrypt(const base::StringPiece& plaintext, std::string* ciphertext);
+
+  // Decrypts |ciphertext| into |plaintext|.  In GCM mode this fails if the
+  // ciphertext has been tampered with.
+  bool Decrypt(const base::StringPiece& ciphertext, std::string* plaintext);
 
-  // Decrypts |ciphertext| into |plaintext|.
-  bool Decrypt(const std::string& ciphertext, std::string* plaintext);
+  // Begins a message.  Any message in progress is abandoned.
+  bool StartEncrypting();
+  bool StartDecrypting();
 
-  // TODO(albertb): Support streaming encryption.
+  // Processes the next chunk of the message, replacing |output| with the data
+  // that became available.  Chunks may have any size; data is held back until
+  // a whole block (and, when decrypting, the padding or tag) can be handled.
+  // When decrypting in GCM mode, the plaintext is not authenticated until
+  // Finish() succeeds.
+  bool Update(const base::StringPiece& input, std::string* output);
+
+  // Ends the message, replacing |output| with the remaining data.  Returns
+  // false if the padding or the GCM tag is invalid.
+  bool Finish(std::string* output);
 
  private:
+  // Platform-specific parts of the streaming interface.  |output| is appended
+  // to.
+  bool StartPlatform(bool do_encrypt);
+  bool UpdatePlatform(const base::StringPiece& input, std::string* output);
+  bool FinishPlatform(std::string* output);
+
   SymmetricKey* key_;
   Mode mode_;
+  std::string iv_;
+
+  // Direction of the message in progress, and whether there is one.
+  bool encrypting_;
+  bool in_progress_;
 
 #if defined(USE_OPENSSL)
-  bool Crypt(bool encrypt,  // Pass true to encrypt, false to decrypt.
-             const std::string& input,
-             std::string* output);
-  std::string iv_;
+  // Contexts keyed for each direction, created on first use.  CBC decryption
+  // needs its own key schedule, so one context cannot serve both.
+  evp_cipher_ctx_st* encrypt_context_;
+  evp_cipher_ctx_st* decrypt_context_;
+
+  // When decrypting in GCM mode, the last kGCMTagSize bytes seen, which may
+  // be the tag.
+  std::string held_back_;
 #elif defined(USE_NSS)
+  // Runs |input| through |context_|, appending the result to |output|.
+  bool CipherOp(const char* input, size_t input_size, std::string* output);
+
   ScopedPK11Slot slot_;
   ScopedSECItem param_;
-#elif defined(OS_MACOSX)
-  bool Crypt(int /*CCOperation*/ op,
-             const std::string& input,
-             std::string* output);
 
-  std::string iv_;
+  // CBC: the context of the last message, which can be restarted for the
+  // next one if it ran to completion in the same direction.
+  ScopedPK11Context context_;
+  bool context_encrypts_;
+  bool context_reusable_;
+
+  // CBC decryption: the trailing partial block, since softoken only takes
+  // whole blocks.  GCM: NSS only does single-part GCM, so the message is
+  // gathered here and processed by Finish().
+  std::string held_back_;
+#elif defined(OS_MACOSX)
+  // Cryptor for each direction, created on first use and reset between
+  // messages.
+  CCCryptorRef encrypt_cryptor_;
+  CCCryptorRef decrypt_cryptor_;
 #elif defined(OS_WIN)
   ScopedHCRYPTKEY capi_key_;
   DWORD block_size_;
+
+  // CryptoAPI only handles the padding of the final call, and in place, so
+  // input is gathered here and processed whole blocks at a time, keeping the
+  // last block for Finish().
+  std::string held_back_;
 #endif
+
+  DISALLOW_COPY_AND_ASSIGN(Encryptor);
 };
 
 }  // namespace crypto
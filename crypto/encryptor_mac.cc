@@ -7,22 +7,31 @@
 #include <CommonCrypto/CommonCryptor.h>
 
 #include "base/logging.h"
-#include "base/string_util.h"
 #include "crypto/symmetric_key.h"
 
 namespace crypto {
 
 Encryptor::Encryptor()
     : key_(NULL),
-      mode_(CBC) {
+      mode_(CBC),
+      encrypting_(false),
+      in_progress_(false),
+      encrypt_cryptor_(NULL),
+      decrypt_cryptor_(NULL) {
 }
 
 Encryptor::~Encryptor() {
+  if (encrypt_cryptor_)
+    CCCryptorRelease(encrypt_cryptor_);
+  if (decrypt_cryptor_)
+    CCCryptorRelease(decrypt_cryptor_);
 }
 
 bool Encryptor::Init(SymmetricKey* key, Mode mode, const std::string& iv) {
   DCHECK(key);
-  DCHECK_EQ(CBC, mode) << "Unsupported mode of operation";
+  // CommonCrypto has no public GCM interface.
+  if (mode != CBC)
+    return false;
   CSSM_DATA raw_key = key->cssm_data();
   if (raw_key.Length != kCCKeySizeAES128 &&
       raw_key.Length != kCCKeySizeAES192 &&
@@ -31,46 +40,90 @@ bool Encryptor::Init(SymmetricKey* key, Mode mode, const std::string& iv) {
   if (iv.size() != kCCBlockSizeAES128)
     return false;
 
+  // Cryptors keyed by a previous Init() are no use.
+  if (encrypt_cryptor_) {
+    CCCryptorRelease(encrypt_cryptor_);
+    encrypt_cryptor_ = NULL;
+  }
+  if (decrypt_cryptor_) {
+    CCCryptorRelease(decrypt_cryptor_);
+    decrypt_cryptor_ = NULL;
+  }
+
   key_ = key;
   mode_ = mode;
   iv_ = iv;
+  in_progress_ = false;
   return true;
 }
 
-bool Encryptor::Crypt(int /*CCOperation*/ op,
-                      const std::string& input,
-                      std::string* output) {
+bool Encryptor::SetIV(const std::string& iv) {
   DCHECK(key_);
+  if (iv.size() != kCCBlockSizeAES128)
+    return false;
+  iv_ = iv;
+  in_progress_ = false;
+  return true;
+}
+
+bool Encryptor::StartPlatform(bool do_encrypt) {
+  CCCryptorRef* cryptor = do_encrypt ? &encrypt_cryptor_ : &decrypt_cryptor_;
+  if (*cryptor) {
+    // Already keyed: only the IV needs to be reset.
+    return CCCryptorReset(*cryptor, iv_.data()) == kCCSuccess;
+  }
+
   CSSM_DATA raw_key = key_->cssm_data();
-  // CommonCryptor.h: "A general rule for the size of the output buffer which
-  // must be provided by the caller is that for block ciphers, the output
-  // length is never larger than the input length plus the block size."
-
-  size_t output_size = input.size() + iv_.size();
-  CCCryptorStatus err = CCCrypt(op,
-                                kCCAlgorithmAES128,
-                                kCCOptionPKCS7Padding,
-                                raw_key.Data, raw_key.Length,
-                                iv_.data(),
-                                input.data(), input.size(),
-                                WriteInto(output, output_size+1),
-                                output_size,
-                                &output_size);
+  CCCryptorStatus err = CCCryptorCreate(do_encrypt ? kCCEncrypt : kCCDecrypt,
+                                        kCCAlgorithmAES128,
+                                        kCCOptionPKCS7Padding,
+                                        raw_key.Data, raw_key.Length,
+                                        iv_.data(),
+                                        cryptor);
   if (err) {
-    output->resize(0);
-    LOG(ERROR) << "CCCrypt returned " << err;
+    *cryptor = NULL;
+    LOG(ERROR) << "CCCryptorCreate returned " << err;
     return false;
   }
-  output->resize(output_size);
   return true;
 }
 
-bool Encryptor::Encrypt(const std::string& plaintext, std::string* ciphertext) {
-  return Crypt(kCCEncrypt, plaintext, ciphertext);
+bool Encryptor::UpdatePlatform(const base::StringPiece& input,
+                               std::string* output) {
+  if (input.empty())
+    return true;
+
+  CCCryptorRef cryptor = encrypting_ ? encrypt_cryptor_ : decrypt_cryptor_;
+  size_t offset = output->size();
+  size_t output_size = CCCryptorGetOutputLength(cryptor, input.size(), false);
+  output->resize(offset + output_size);
+  size_t moved = 0;
+  CCCryptorStatus err = CCCryptorUpdate(cryptor, input.data(), input.size(),
+                                        &(*output)[offset], output_size,
+                                        &moved);
+  if (err) {
+    output->resize(offset);
+    LOG(ERROR) << "CCCryptorUpdate returned " << err;
+    return false;
+  }
+  output->resize(offset + moved);
+  return true;
 }
 
-bool Encryptor::Decrypt(const std::string& ciphertext, std::string* plaintext) {
-  return Crypt(kCCDecrypt, ciphertext, plaintext);
+bool Encryptor::FinishPlatform(std::string* output) {
+  CCCryptorRef cryptor = encrypting_ ? encrypt_cryptor_ : decrypt_cryptor_;
+  size_t offset = output->size();
+  output->resize(offset + kCCBlockSizeAES128);
+  size_t moved = 0;
+  CCCryptorStatus err = CCCryptorFinal(cryptor, &(*output)[offset],
+                                       kCCBlockSizeAES128, &moved);
+  if (err) {
+    output->resize(offset);
+    LOG(ERROR) << "CCCryptorFinal returned " << err;
+    return false;
+  }
+  output->resize(offset + moved);
+  return true;
 }
 
 }  // namespace crypto
@@ -5,17 +5,49 @@
 #include "crypto/encryptor.h"
 
 #include <cryptohi.h>
-#include <vector>
+#include <nss.h>
+
+#include <algorithm>
 
 #include "base/logging.h"
 #include "crypto/nss_util.h"
 #include "crypto/symmetric_key.h"
 
+// Single-part AES-GCM (PK11_Encrypt/PK11_Decrypt) arrived in NSS 3.15.
+#if NSS_VMAJOR > 3 || (NSS_VMAJOR == 3 && NSS_VMINOR >= 15)
+#define ENCRYPTOR_HAS_GCM 1
+#endif
+
 namespace crypto {
 
+namespace {
+
+// Size of the IV in GCM mode.
+const size_t kGCMIVSize = 12;
+
+#if defined(ENCRYPTOR_HAS_GCM)
+// NSS 3.52 renamed the original GCM parameter layout, and gave the old name
+// to the PKCS #11 v3 layout.  Softoken accepts both.
+#if NSS_VMAJOR > 3 || (NSS_VMAJOR == 3 && NSS_VMINOR >= 52)
+typedef CK_NSS_GCM_PARAMS GCMParams;
+#else
+typedef CK_GCM_PARAMS GCMParams;
+#endif
+#endif
+
+bool IsValidIV(Encryptor::Mode mode, const std::string& iv) {
+  return iv.size() == (mode == Encryptor::GCM ? kGCMIVSize : AES_BLOCK_SIZE);
+}
+
+}  // namespace
+
 Encryptor::Encryptor()
     : key_(NULL),
-      mode_(CBC) {
+      mode_(CBC),
+      encrypting_(false),
+      in_progress_(false),
+      context_encrypts_(false),
+      context_reusable_(false) {
   EnsureNSSInit();
 }
 
@@ -24,23 +56,48 @@ Encryptor::~Encryptor() {
 
 bool Encryptor::Init(SymmetricKey* key, Mode mode, const std::string& iv) {
   DCHECK(key);
-  DCHECK_EQ(CBC, mode);
+  DCHECK(mode == CBC || mode == GCM);
+
+  CK_MECHANISM_TYPE mechanism = CKM_AES_CBC_PAD;
+  if (mode == GCM) {
+#if defined(ENCRYPTOR_HAS_GCM)
+    mechanism = CKM_AES_GCM;
+#else
+    return false;
+#endif
+  }
 
   key_ = key;
   mode_ = mode;
+  in_progress_ = false;
 
-  if (iv.size() != AES_BLOCK_SIZE)
+  slot_.reset(PK11_GetBestSlot(mechanism, NULL));
+  if (!slot_.get())
     return false;
 
-  slot_.reset(PK11_GetBestSlot(CKM_AES_CBC_PAD, NULL));
-  if (!slot_.get())
+  return SetIV(iv);
+}
+
+bool Encryptor::SetIV(const std::string& iv) {
+  DCHECK(key_);
+  if (!IsValidIV(mode_, iv))
     return false;
 
+  iv_ = iv;
+  in_progress_ = false;
+  // The IV is part of the context's parameters, so the context cannot be
+  // restarted with a new one.
+  context_.reset();
+  context_reusable_ = false;
+  param_.reset();
+  if (mode_ == GCM)
+    return true;
+
   SECItem iv_item;
   iv_item.type = siBuffer;
   iv_item.data = reinterpret_cast<unsigned char*>(
-      const_cast<char *>(iv.data()));
-  iv_item.len = iv.size();
+      const_cast<char *>(iv_.data()));
+  iv_item.len = iv_.size();
 
   param_.reset(PK11_ParamFromIV(CKM_AES_CBC_PAD, &iv_item));
   if (!param_.get())
@@ -49,76 +106,145 @@ bool Encryptor::Init(SymmetricKey* key, Mode mode, const std::string& iv) {
   return true;
 }
 
-bool Encryptor::Encrypt(const std::string& plaintext, std::string* ciphertext) {
-  ScopedPK11Context context(PK11_CreateContextBySymKey(CKM_AES_CBC_PAD,
-                                                       CKA_ENCRYPT,
-                                                       key_->key(),
-                                                       param_.get()));
-  if (!context.get())
-    return false;
-
-  size_t ciphertext_len = plaintext.size() + AES_BLOCK_SIZE;
-  std::vector<unsigned char> buffer(ciphertext_len);
-
-  int op_len;
-  SECStatus rv = PK11_CipherOp(context.get(),
-                               &buffer[0],
-                               &op_len,
-                               ciphertext_len,
-                               reinterpret_cast<unsigned char*>(
-                                   const_cast<char*>(plaintext.data())),
-                               plaintext.size());
-  if (SECSuccess != rv)
-    return false;
+bool Encryptor::StartPlatform(bool do_encrypt) {
+  held_back_.clear();
+  if (mode_ == GCM)
+    return true;
+
+  // Restarting the previous context skips the key lookup and the context
+  // allocation.  This is only possible if its last message was finished:
+  // PK11_DigestBegin does nothing to a context it already started.
+  if (context_.get() && context_reusable_ && context_encrypts_ == do_encrypt) {
+    context_reusable_ = false;
+    return PK11_DigestBegin(context_.get()) == SECSuccess;
+  }
+
+  context_reusable_ = false;
+  context_encrypts_ = do_encrypt;
+  context_.reset(PK11_CreateContextBySymKey(CKM_AES_CBC_PAD,
+                                            do_encrypt ? CKA_ENCRYPT :
+                                                         CKA_DECRYPT,
+                                            key_->key(),
+                                            param_.get()));
+  return context_.get() != NULL;
+}
 
-  unsigned int digest_len;
-  rv = PK11_DigestFinal(context.get(),
-                        &buffer[op_len],
-                        &digest_len,
-                        ciphertext_len - op_len);
-  if (SECSuccess != rv)
+bool Encryptor::UpdatePlatform(const base::StringPiece& input,
+                               std::string* output) {
+  if (mode_ == GCM) {
+    held_back_.append(input.data(), input.size());
+    return true;
+  }
+
+  if (encrypting_)
+    return CipherOp(input.data(), input.size(), output);
+
+  // Softoken only decrypts whole blocks before the final call, so partial
+  // blocks wait in |held_back_|.
+  base::StringPiece rest = input;
+  if (!held_back_.empty()) {
+    size_t needed = std::min(AES_BLOCK_SIZE - held_back_.size(), rest.size());
+    held_back_.append(rest.data(), needed);
+    rest.remove_prefix(needed);
+    if (held_back_.size() < AES_BLOCK_SIZE)
+      return true;
+    if (!CipherOp(held_back_.data(), held_back_.size(), output))
+      return false;
+    held_back_.clear();
+  }
+  size_t whole_blocks = rest.size() - rest.size() % AES_BLOCK_SIZE;
+  if (!CipherOp(rest.data(), whole_blocks, output))
     return false;
-
-  ciphertext->assign(reinterpret_cast<char *>(&buffer[0]),
-                     op_len + digest_len);
+  held_back_.assign(rest.data() + whole_blocks, rest.size() - whole_blocks);
   return true;
 }
 
-bool Encryptor::Decrypt(const std::string& ciphertext, std::string* plaintext) {
-  if (ciphertext.empty())
-    return false;
-
-  ScopedPK11Context context(PK11_CreateContextBySymKey(CKM_AES_CBC_PAD,
-                                                       CKA_DECRYPT,
-                                                       key_->key(),
-                                                       param_.get()));
-  if (!context.get())
-    return false;
-
-  size_t plaintext_len = ciphertext.size();
-  std::vector<unsigned char> buffer(plaintext_len);
-
-  int op_len;
-  SECStatus rv = PK11_CipherOp(context.get(),
-                               &buffer[0],
+bool Encryptor::CipherOp(const char* input,
+                         size_t input_size,
+                         std::string* output) {
+  if (input_size == 0)
+    return true;
+
+  // The output can hold back or release up to one block.
+  size_t offset = output->size();
+  size_t max_len = input_size + AES_BLOCK_SIZE;
+  output->resize(offset + max_len);
+  int op_len = 0;
+  SECStatus rv = PK11_CipherOp(context_.get(),
+                               reinterpret_cast<unsigned char*>(
+                                   &(*output)[offset]),
                                &op_len,
-                               plaintext_len,
+                               max_len,
                                reinterpret_cast<unsigned char*>(
-                                   const_cast<char*>(ciphertext.data())),
-                               ciphertext.size());
-  if (SECSuccess != rv)
+                                   const_cast<char*>(input)),
+                               input_size);
+  if (SECSuccess != rv) {
+    output->resize(offset);
     return false;
+  }
+  output->resize(offset + op_len);
+  return true;
+}
 
-  unsigned int digest_len;
-  rv = PK11_DigestFinal(context.get(),
-                        &buffer[op_len],
-                        &digest_len,
-                        plaintext_len - op_len);
-  if (SECSuccess != rv)
+bool Encryptor::FinishPlatform(std::string* output) {
+  size_t offset = output->size();
+
+#if defined(ENCRYPTOR_HAS_GCM)
+  if (mode_ == GCM) {
+    if (!encrypting_ && held_back_.size() < kGCMTagSize)
+      return false;
+
+    GCMParams gcm_params;
+    gcm_params.pIv = reinterpret_cast<unsigned char*>(
+        const_cast<char*>(iv_.data()));
+    gcm_params.ulIvLen = iv_.size();
+    gcm_params.pAAD = NULL;
+    gcm_params.ulAADLen = 0;
+    gcm_params.ulTagBits = kGCMTagSize * 8;
+
+    SECItem param;
+    param.type = siBuffer;
+    param.data = reinterpret_cast<unsigned char*>(&gcm_params);
+    param.len = sizeof(gcm_params);
+
+    size_t max_len = held_back_.size() + (encrypting_ ? kGCMTagSize : 0);
+    output->resize(offset + std::max<size_t>(max_len, 1));
+    unsigned char* out = reinterpret_cast<unsigned char*>(&(*output)[offset]);
+    const unsigned char* in =
+        reinterpret_cast<const unsigned char*>(held_back_.data());
+    unsigned int out_len = 0;
+    SECStatus rv = encrypting_ ?
+        PK11_Encrypt(key_->key(), CKM_AES_GCM, &param, out, &out_len,
+                     max_len, in, held_back_.size()) :
+        PK11_Decrypt(key_->key(), CKM_AES_GCM, &param, out, &out_len,
+                     max_len, in, held_back_.size());
+    held_back_.clear();
+    if (SECSuccess != rv) {
+      output->resize(offset);
+      return false;
+    }
+    output->resize(offset + out_len);
+    return true;
+  }
+#endif
+
+  // A partial block left over means the ciphertext was truncated.
+  if (!held_back_.empty())
     return false;
 
-  plaintext->assign(reinterpret_cast<char *>(&buffer[0]),
-                    op_len + digest_len);
+  output->resize(offset + AES_BLOCK_SIZE);
+  unsigned int digest_len = 0;
+  SECStatus rv = PK11_DigestFinal(context_.get(),
+                                  reinterpret_cast<unsigned char*>(
+                                      &(*output)[offset]),
+                                  &digest_len,
+                                  AES_BLOCK_SIZE);
+  if (SECSuccess != rv) {
+    output->resize(offset);
+    return false;
+  }
+  output->resize(offset + digest_len);
+  context_reusable_ = true;
   return true;
 }
 
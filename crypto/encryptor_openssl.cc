@@ -8,15 +8,35 @@
 #include <openssl/evp.h>
 
 #include "base/logging.h"
-#include "base/string_util.h"
 #include "crypto/openssl_util.h"
 #include "crypto/symmetric_key.h"
 
+// GCM arrived in OpenSSL 1.0.1.
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+#define ENCRYPTOR_HAS_GCM 1
+#endif
+
 namespace crypto {
 
 namespace {
 
-const EVP_CIPHER* GetCipherForKey(SymmetricKey* key) {
+// Size of the IV in GCM mode.
+const size_t kGCMIVSize = 12;
+
+const EVP_CIPHER* GetCipherForKey(SymmetricKey* key, Encryptor::Mode mode) {
+  if (mode == Encryptor::GCM) {
+#if defined(ENCRYPTOR_HAS_GCM)
+    switch (key->key().length()) {
+      case 16: return EVP_aes_128_gcm();
+      case 24: return EVP_aes_192_gcm();
+      case 32: return EVP_aes_256_gcm();
+      default: return NULL;
+    }
+#else
+    return NULL;
+#endif
+  }
+
   switch (key->key().length()) {
     case 16: return EVP_aes_128_cbc();
     case 24: return EVP_aes_192_cbc();
@@ -25,102 +45,187 @@ const EVP_CIPHER* GetCipherForKey(SymmetricKey* key) {
   }
 }
 
-// On destruction this class will cleanup the ctx, and also clear the OpenSSL
-// ERR stack as a convenience.
-class ScopedCipherCTX {
- public:
-  explicit ScopedCipherCTX() {
-    EVP_CIPHER_CTX_init(&ctx_);
-  }
-  ~ScopedCipherCTX() {
-    EVP_CIPHER_CTX_cleanup(&ctx_);
-    ClearOpenSSLERRStack(FROM_HERE);
-  }
-  EVP_CIPHER_CTX* get() { return &ctx_; }
+bool IsValidIV(Encryptor::Mode mode, const std::string& iv) {
+  return iv.size() == (mode == Encryptor::GCM ? kGCMIVSize : AES_BLOCK_SIZE);
+}
 
- private:
-  EVP_CIPHER_CTX ctx_;
-};
+// Runs |input| through |context|, appending the result to |output|.
+bool CipherUpdate(EVP_CIPHER_CTX* context,
+                  const char* input,
+                  size_t input_size,
+                  std::string* output) {
+  if (input_size == 0)
+    return true;
+
+  // The output can hold back or release up to one block.
+  size_t offset = output->size();
+  output->resize(offset + input_size + AES_BLOCK_SIZE);
+  int out_len = 0;
+  if (!EVP_CipherUpdate(context,
+                        reinterpret_cast<uint8*>(&(*output)[offset]), &out_len,
+                        reinterpret_cast<const uint8*>(input), input_size)) {
+    output->resize(offset);
+    return false;
+  }
+  DCHECK_LE(out_len, static_cast<int>(input_size + AES_BLOCK_SIZE));
+  output->resize(offset + out_len);
+  return true;
+}
 
 }  // namespace
 
 Encryptor::Encryptor()
     : key_(NULL),
-      mode_(CBC) {
+      mode_(CBC),
+      encrypting_(false),
+      in_progress_(false),
+      encrypt_context_(NULL),
+      decrypt_context_(NULL) {
 }
 
 Encryptor::~Encryptor() {
+  if (encrypt_context_)
+    EVP_CIPHER_CTX_free(encrypt_context_);
+  if (decrypt_context_)
+    EVP_CIPHER_CTX_free(decrypt_context_);
+  ClearOpenSSLERRStack(FROM_HERE);
 }
 
 bool Encryptor::Init(SymmetricKey* key, Mode mode, const std::string& iv) {
   DCHECK(key);
-  DCHECK_EQ(CBC, mode);
+  DCHECK(mode == CBC || mode == GCM);
 
   EnsureOpenSSLInit();
-  if (iv.size() != AES_BLOCK_SIZE)
+  if (!IsValidIV(mode, iv))
     return false;
 
-  if (GetCipherForKey(key) == NULL)
+  if (GetCipherForKey(key, mode) == NULL)
     return false;
 
+  // Contexts keyed by a previous Init() are no use.
+  if (encrypt_context_) {
+    EVP_CIPHER_CTX_free(encrypt_context_);
+    encrypt_context_ = NULL;
+  }
+  if (decrypt_context_) {
+    EVP_CIPHER_CTX_free(decrypt_context_);
+    decrypt_context_ = NULL;
+  }
+
   key_ = key;
   mode_ = mode;
   iv_ = iv;
+  in_progress_ = false;
   return true;
 }
 
-bool Encryptor::Encrypt(const std::string& plaintext, std::string* ciphertext) {
-  return Crypt(true, plaintext, ciphertext);
+bool Encryptor::SetIV(const std::string& iv) {
+  DCHECK(key_);
+  if (!IsValidIV(mode_, iv))
+    return false;
+  iv_ = iv;
+  in_progress_ = false;
+  return true;
 }
 
-bool Encryptor::Decrypt(const std::string& ciphertext, std::string* plaintext) {
-  return Crypt(false, ciphertext, plaintext);
-}
+bool Encryptor::StartPlatform(bool do_encrypt) {
+  OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  held_back_.clear();
 
-bool Encryptor::Crypt(bool do_encrypt,
-                      const std::string& input,
-                      std::string* output) {
-  DCHECK(key_);  // Must call Init() before En/De-crypt.
-  // Work on the result in a local variable, and then only transfer it to
-  // |output| on success to ensure no partial data is returned.
-  std::string result;
-  output->swap(result);
+  EVP_CIPHER_CTX** context = do_encrypt ? &encrypt_context_ : &decrypt_context_;
+  if (*context) {
+    // Already keyed: only the IV needs to be reset.
+    return EVP_CipherInit_ex(*context, NULL, NULL, NULL,
+                             reinterpret_cast<const uint8*>(iv_.data()),
+                             do_encrypt) == 1;
+  }
 
-  const EVP_CIPHER* cipher = GetCipherForKey(key_);
+  const EVP_CIPHER* cipher = GetCipherForKey(key_, mode_);
   DCHECK(cipher);  // Already handled in Init();
 
   const std::string& key = key_->key();
-  DCHECK_EQ(EVP_CIPHER_iv_length(cipher), static_cast<int>(iv_.length()));
   DCHECK_EQ(EVP_CIPHER_key_length(cipher), static_cast<int>(key.length()));
 
-  ScopedCipherCTX ctx;
-  if (!EVP_CipherInit_ex(ctx.get(), cipher, NULL,
+  EVP_CIPHER_CTX* new_context = EVP_CIPHER_CTX_new();
+  if (!new_context)
+    return false;
+  if (!EVP_CipherInit_ex(new_context, cipher, NULL,
                          reinterpret_cast<const uint8*>(key.data()),
                          reinterpret_cast<const uint8*>(iv_.data()),
-                         do_encrypt))
+                         do_encrypt)) {
+    EVP_CIPHER_CTX_free(new_context);
     return false;
+  }
+  *context = new_context;
+  return true;
+}
 
-  // When encrypting, add another block size of space to allow for any padding.
-  const size_t output_size = input.size() + (do_encrypt ? iv_.size() : 0);
-  uint8* out_ptr = reinterpret_cast<uint8*>(WriteInto(&result,
-                                                      output_size + 1));
-  int out_len;
-  if (!EVP_CipherUpdate(ctx.get(), out_ptr, &out_len,
-                        reinterpret_cast<const uint8*>(input.data()),
-                        input.length()))
-    return false;
+bool Encryptor::UpdatePlatform(const base::StringPiece& input,
+                               std::string* output) {
+  OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  EVP_CIPHER_CTX* context = encrypting_ ? encrypt_context_ : decrypt_context_;
+  if (mode_ != GCM || encrypting_)
+    return CipherUpdate(context, input.data(), input.size(), output);
+
+  // The tag is at the end of the ciphertext, so the last kGCMTagSize bytes
+  // seen so far are not deciphered until more input arrives.
+  if (input.size() < kGCMTagSize) {
+    held_back_.append(input.data(), input.size());
+    size_t excess = held_back_.size() > kGCMTagSize ?
+        held_back_.size() - kGCMTagSize : 0;
+    if (!CipherUpdate(context, held_back_.data(), excess, output))
+      return false;
+    held_back_.erase(0, excess);
+    return true;
+  }
 
-  // Write out the final block plus padding (if any) to the end of the data
-  // just written.
-  int tail_len;
-  if (!EVP_CipherFinal_ex(ctx.get(), out_ptr + out_len, &tail_len))
+  size_t body_size = input.size() - kGCMTagSize;
+  if (!CipherUpdate(context, held_back_.data(), held_back_.size(), output) ||
+      !CipherUpdate(context, input.data(), body_size, output)) {
     return false;
+  }
+  held_back_.assign(input.data() + body_size, kGCMTagSize);
+  return true;
+}
 
-  out_len += tail_len;
-  DCHECK_LE(out_len, static_cast<int>(output_size));
-  result.resize(out_len);
-
-  output->swap(result);
+bool Encryptor::FinishPlatform(std::string* output) {
+  OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  EVP_CIPHER_CTX* context = encrypting_ ? encrypt_context_ : decrypt_context_;
+
+#if defined(ENCRYPTOR_HAS_GCM)
+  if (mode_ == GCM && !encrypting_) {
+    if (held_back_.size() != kGCMTagSize)
+      return false;
+    if (!EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, kGCMTagSize,
+                             &held_back_[0])) {
+      return false;
+    }
+  }
+#endif
+
+  // Write out the final block plus padding (if any).
+  size_t offset = output->size();
+  output->resize(offset + AES_BLOCK_SIZE);
+  int tail_len = 0;
+  if (!EVP_CipherFinal_ex(context,
+                          reinterpret_cast<uint8*>(&(*output)[offset]),
+                          &tail_len)) {
+    output->resize(offset);
+    return false;
+  }
+  output->resize(offset + tail_len);
+
+#if defined(ENCRYPTOR_HAS_GCM)
+  if (mode_ == GCM && encrypting_) {
+    offset = output->size();
+    output->resize(offset + kGCMTagSize);
+    if (!EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, kGCMTagSize,
+                             &(*output)[offset])) {
+      output->resize(offset);
+      return false;
+    }
+  }
+#endif
   return true;
 }
 
@@ -4,13 +4,54 @@
 
 #include "crypto/encryptor.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
+#include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/string_number_conversions.h"
+#include "base/time.h"
 #include "crypto/symmetric_key.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
+namespace {
+
+// Runs |input| through |encryptor| with the streaming interface, |chunk_size|
+// bytes at a time.
+bool StreamCrypt(crypto::Encryptor* encryptor,
+                 bool do_encrypt,
+                 const std::string& input,
+                 size_t chunk_size,
+                 std::string* output) {
+  output->clear();
+  if (!(do_encrypt ? encryptor->StartEncrypting() :
+                     encryptor->StartDecrypting())) {
+    return false;
+  }
+  std::string chunk_output;
+  for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+    size_t length = std::min(chunk_size, input.size() - offset);
+    if (!encryptor->Update(base::StringPiece(input.data() + offset, length),
+                           &chunk_output)) {
+      return false;
+    }
+    output->append(chunk_output);
+  }
+  if (!encryptor->Finish(&chunk_output))
+    return false;
+  output->append(chunk_output);
+  return true;
+}
+
+std::string HexDecodeToString(const std::string& hex) {
+  std::vector<uint8> bytes;
+  EXPECT_TRUE(base::HexStringToBytes(hex, &bytes));
+  return std::string(bytes.begin(), bytes.end());
+}
+
+}  // namespace
+
 TEST(EncryptorTest, EncryptDecrypt) {
   scoped_ptr<crypto::SymmetricKey> key(
       crypto::SymmetricKey::DeriveKeyFromPassword(
@@ -231,3 +272,189 @@ TEST(EncryptorTest, EmptyDecrypt) {
   EXPECT_FALSE(encryptor.Decrypt("", &decrypted));
   EXPECT_EQ("", decrypted);
 }
+
+TEST(EncryptorTest, Streaming) {
+  std::string key = "128=SixteenBytes";
+  std::string iv = "Sweet Sixteen IV";
+  scoped_ptr<crypto::SymmetricKey> sym_key(crypto::SymmetricKey::Import(
+      crypto::SymmetricKey::AES, key));
+  ASSERT_TRUE(NULL != sym_key.get());
+
+  crypto::Encryptor encryptor;
+  EXPECT_TRUE(encryptor.Init(sym_key.get(), crypto::Encryptor::CBC, iv));
+
+  const size_t kChunkSizes[] = { 1, 7, 16, 17, 100, 1000 };
+  for (size_t length = 0; length < 300; length += 13) {
+    std::string plaintext;
+    for (size_t i = 0; i < length; ++i)
+      plaintext.push_back(static_cast<char>(i * 7));
+    std::string expected;
+    ASSERT_TRUE(encryptor.Encrypt(plaintext, &expected));
+
+    for (size_t i = 0; i < arraysize(kChunkSizes); ++i) {
+      std::string ciphertext;
+      ASSERT_TRUE(StreamCrypt(&encryptor, true, plaintext, kChunkSizes[i],
+                              &ciphertext));
+      EXPECT_EQ(expected, ciphertext) << length << " " << kChunkSizes[i];
+
+      std::string decrypted;
+      ASSERT_TRUE(StreamCrypt(&encryptor, false, ciphertext, kChunkSizes[i],
+                              &decrypted)) << length << " " << kChunkSizes[i];
+      EXPECT_EQ(plaintext, decrypted) << length << " " << kChunkSizes[i];
+    }
+  }
+
+  // An abandoned message does not affect the next one.
+  std::string output, ciphertext, expected;
+  ASSERT_TRUE(encryptor.Encrypt("next message", &expected));
+  ASSERT_TRUE(encryptor.StartEncrypting());
+  EXPECT_TRUE(encryptor.Update("abandoned message", &output));
+  ASSERT_TRUE(StreamCrypt(&encryptor, true, "next message", 5, &ciphertext));
+  EXPECT_EQ(expected, ciphertext);
+
+  // Bad padding is reported by Finish.
+  std::string decrypted;
+  ciphertext[ciphertext.size() - 1] ^= 1;
+  EXPECT_FALSE(StreamCrypt(&encryptor, false, ciphertext, 5, &decrypted));
+}
+
+TEST(EncryptorTest, SetIV) {
+  std::string key = "128=SixteenBytes";
+  scoped_ptr<crypto::SymmetricKey> sym_key(crypto::SymmetricKey::Import(
+      crypto::SymmetricKey::AES, key));
+  ASSERT_TRUE(NULL != sym_key.get());
+
+  crypto::Encryptor encryptor;
+  EXPECT_TRUE(encryptor.Init(sym_key.get(), crypto::Encryptor::CBC,
+                             "Sweet Sixteen IV"));
+  std::string first;
+  EXPECT_TRUE(encryptor.Encrypt("Small text", &first));
+
+  EXPECT_FALSE(encryptor.SetIV("OnlyForteen :("));
+  EXPECT_TRUE(encryptor.SetIV("Another 16B IV!!"));
+  std::string second;
+  EXPECT_TRUE(encryptor.Encrypt("Small text", &second));
+  EXPECT_NE(first, second);
+
+  // Same as a fresh Encryptor with that IV.
+  crypto::Encryptor fresh;
+  EXPECT_TRUE(fresh.Init(sym_key.get(), crypto::Encryptor::CBC,
+                         "Another 16B IV!!"));
+  std::string expected;
+  EXPECT_TRUE(fresh.Encrypt("Small text", &expected));
+  EXPECT_EQ(expected, second);
+
+  std::string decrypted;
+  EXPECT_TRUE(encryptor.Decrypt(second, &decrypted));
+  EXPECT_EQ("Small text", decrypted);
+}
+
+// GCM is only available with NSS and OpenSSL.
+#if defined(USE_NSS) || defined(USE_OPENSSL)
+// Test case 3 from "The Galois/Counter Mode of Operation (GCM)", McGrew and
+// Viega.
+TEST(EncryptorTest, EncryptAES128GCM) {
+  std::string key = HexDecodeToString("feffe9928665731c6d6a8f9467308308");
+  std::string iv = HexDecodeToString("cafebabefacedbaddecaf888");
+  std::string plaintext = HexDecodeToString(
+      "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+      "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255");
+  std::string expected_ciphertext_hex =
+      "42831EC2217774244B7221B784D0D49CE3AA212F2C02A4E035C17E2329ACA12E"
+      "21D514B25466931C7D8F6A5AAC84AA051BA30B396A0AAC973D58E091473F5985"
+      // Tag.
+      "4D5C2AF327CD64A62CF35ABD2BA6FAB4";
+
+  scoped_ptr<crypto::SymmetricKey> sym_key(crypto::SymmetricKey::Import(
+      crypto::SymmetricKey::AES, key));
+  ASSERT_TRUE(NULL != sym_key.get());
+
+  crypto::Encryptor encryptor;
+  EXPECT_FALSE(encryptor.Init(sym_key.get(), crypto::Encryptor::GCM,
+                              "Sweet Sixteen IV"));
+  ASSERT_TRUE(encryptor.Init(sym_key.get(), crypto::Encryptor::GCM, iv));
+
+  std::string ciphertext;
+  EXPECT_TRUE(encryptor.Encrypt(plaintext, &ciphertext));
+  EXPECT_EQ(expected_ciphertext_hex, base::HexEncode(ciphertext.data(),
+                                                     ciphertext.size()));
+
+  std::string decrypted;
+  EXPECT_TRUE(encryptor.Decrypt(ciphertext, &decrypted));
+  EXPECT_EQ(plaintext, decrypted);
+
+  for (size_t chunk_size = 1; chunk_size < 40; chunk_size += 3) {
+    std::string streamed;
+    EXPECT_TRUE(StreamCrypt(&encryptor, true, plaintext, chunk_size,
+                            &streamed));
+    EXPECT_EQ(ciphertext, streamed);
+    EXPECT_TRUE(StreamCrypt(&encryptor, false, ciphertext, chunk_size,
+                            &decrypted));
+    EXPECT_EQ(plaintext, decrypted);
+  }
+
+  // Any change to the ciphertext or the tag is detected.
+  for (size_t i = 0; i < ciphertext.size(); i += 7) {
+    std::string tampered = ciphertext;
+    tampered[i] ^= 0x80;
+    decrypted = "unchanged";
+    EXPECT_FALSE(encryptor.Decrypt(tampered, &decrypted)) << i;
+    EXPECT_EQ("unchanged", decrypted);
+  }
+  EXPECT_FALSE(encryptor.Decrypt(ciphertext.substr(0, 15), &decrypted));
+
+  // An empty message still has a tag.
+  EXPECT_TRUE(encryptor.Encrypt("", &ciphertext));
+  EXPECT_EQ(crypto::Encryptor::kGCMTagSize, ciphertext.size());
+  EXPECT_TRUE(encryptor.Decrypt(ciphertext, &decrypted));
+  EXPECT_EQ("", decrypted);
+}
+#endif  // defined(USE_NSS) || defined(USE_OPENSSL)
+
+// Encrypts and decrypts 16MB in messages of various sizes.  Run with --v=1 to
+// see the throughput.
+TEST(EncryptorTest, Throughput) {
+  const size_t kBytesPerSize = 16 << 20;
+  const size_t kSizes[] = { 64, 1024, 64 << 10, 1 << 20 };
+  const crypto::Encryptor::Mode kModes[] = {
+    crypto::Encryptor::CBC, crypto::Encryptor::GCM
+  };
+
+  scoped_ptr<crypto::SymmetricKey> sym_key(crypto::SymmetricKey::Import(
+      crypto::SymmetricKey::AES, "128=SixteenBytes"));
+  ASSERT_TRUE(NULL != sym_key.get());
+
+  for (size_t m = 0; m < arraysize(kModes); ++m) {
+    crypto::Encryptor encryptor;
+    std::string iv(kModes[m] == crypto::Encryptor::GCM ? 12 : 16, 'i');
+    if (!encryptor.Init(sym_key.get(), kModes[m], iv)) {
+      VLOG(1) << "mode " << kModes[m] << " is not supported";
+      continue;
+    }
+
+    for (size_t i = 0; i < arraysize(kSizes); ++i) {
+      std::string plaintext(kSizes[i], 'p');
+      std::string ciphertext, decrypted;
+      size_t messages = kBytesPerSize / kSizes[i];
+
+      base::TimeTicks start = base::TimeTicks::Now();
+      for (size_t j = 0; j < messages; ++j)
+        ASSERT_TRUE(encryptor.Encrypt(plaintext, &ciphertext));
+      base::TimeDelta encrypt_time = base::TimeTicks::Now() - start;
+
+      start = base::TimeTicks::Now();
+      for (size_t j = 0; j < messages; ++j)
+        ASSERT_TRUE(encryptor.Decrypt(ciphertext, &decrypted));
+      base::TimeDelta decrypt_time = base::TimeTicks::Now() - start;
+      EXPECT_EQ(plaintext, decrypted);
+
+      int64 encrypt_us = std::max<int64>(encrypt_time.InMicroseconds(), 1);
+      int64 decrypt_us = std::max<int64>(decrypt_time.InMicroseconds(), 1);
+      VLOG(1) << "mode " << kModes[m] << ", " << kSizes[i] << " byte messages: "
+              << kBytesPerSize / encrypt_us << " MB/s ("
+              << messages * 1000000 / encrypt_us << " ops/s) encrypt, "
+              << kBytesPerSize / decrypt_us << " MB/s ("
+              << messages * 1000000 / decrypt_us << " ops/s) decrypt";
+    }
+  }
+}
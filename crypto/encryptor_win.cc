@@ -4,8 +4,7 @@
 
 #include "crypto/encryptor.h"
 
-#include <vector>
-
+#include "base/logging.h"
 #include "crypto/symmetric_key.h"
 
 namespace crypto {
@@ -31,6 +30,8 @@ DWORD GetCipherBlockSize(HCRYPTKEY key) {
 Encryptor::Encryptor()
     : key_(NULL),
       mode_(CBC),
+      encrypting_(false),
+      in_progress_(false),
       block_size_(0) {
 }
 
@@ -39,7 +40,9 @@ Encryptor::~Encryptor() {
 
 bool Encryptor::Init(SymmetricKey* key, Mode mode, const std::string& iv) {
   DCHECK(key);
-  DCHECK_EQ(CBC, mode) << "Unsupported mode of operation";
+  // CryptoAPI has no GCM.
+  if (mode != CBC)
+    return false;
 
   // In CryptoAPI, the IV, padding mode, and feedback register (for a chaining
   // mode) are properties of a key, so we have to create a copy of the key for
@@ -60,55 +63,86 @@ bool Encryptor::Init(SymmetricKey* key, Mode mode, const std::string& iv) {
   if (block_size_ == 0)
     return false;
 
-  if (iv.size() != block_size_)
-    return false;
-
-  ok = CryptSetKeyParam(capi_key_.get(), KP_IV,
-                        reinterpret_cast<const BYTE*>(iv.data()), 0);
-  if (!ok)
-    return false;
-
   DWORD padding_method = PKCS5_PADDING;
   ok = CryptSetKeyParam(capi_key_.get(), KP_PADDING,
                         reinterpret_cast<BYTE*>(&padding_method), 0);
   if (!ok)
     return false;
 
+  key_ = key;
+  mode_ = mode;
+  return SetIV(iv);
+}
+
+bool Encryptor::SetIV(const std::string& iv) {
+  DCHECK(key_);
+  if (iv.size() != block_size_)
+    return false;
+  iv_ = iv;
+  in_progress_ = false;
   return true;
 }
 
-bool Encryptor::Encrypt(const std::string& plaintext, std::string* ciphertext) {
-  DWORD data_len = plaintext.size();
-  DWORD total_len = data_len + block_size_;
+bool Encryptor::StartPlatform(bool do_encrypt) {
+  held_back_.clear();
+  // Setting the IV also resets the feedback register, in case the previous
+  // message was abandoned.
+  return !!CryptSetKeyParam(capi_key_.get(), KP_IV,
+                            reinterpret_cast<const BYTE*>(iv_.data()), 0);
+}
 
-  // CryptoAPI encrypts/decrypts in place.
-  std::vector<BYTE> tmp(total_len);
-  memcpy(&tmp[0], plaintext.data(), data_len);
+bool Encryptor::UpdatePlatform(const base::StringPiece& input,
+                               std::string* output) {
+  held_back_.append(input.data(), input.size());
 
-  BOOL ok = CryptEncrypt(capi_key_.get(), NULL, TRUE, 0, &tmp[0],
-                         &data_len, total_len);
-  if (!ok)
-    return false;
+  // Only whole blocks can be processed before the final call, and when
+  // decrypting the last one must be kept since it holds the padding.
+  DWORD data_len = held_back_.size() - held_back_.size() % block_size_;
+  if (!encrypting_ && data_len == held_back_.size() && data_len > 0)
+    data_len -= block_size_;
+  if (data_len == 0)
+    return true;
 
-  ciphertext->assign(reinterpret_cast<char*>(&tmp[0]), data_len);
+  // CryptoAPI encrypts/decrypts in place.
+  size_t offset = output->size();
+  size_t input_len = data_len;
+  output->append(held_back_.data(), input_len);
+  BYTE* data = reinterpret_cast<BYTE*>(&(*output)[offset]);
+  BOOL ok = encrypting_ ?
+      CryptEncrypt(capi_key_.get(), NULL, FALSE, 0, data, &data_len,
+                   data_len) :
+      CryptDecrypt(capi_key_.get(), NULL, FALSE, 0, data, &data_len);
+  if (!ok) {
+    output->resize(offset);
+    return false;
+  }
+  held_back_.erase(0, input_len);
+  output->resize(offset + data_len);
   return true;
 }
 
-bool Encryptor::Decrypt(const std::string& ciphertext, std::string* plaintext) {
-  DWORD data_len = ciphertext.size();
-  if (data_len == 0)
+bool Encryptor::FinishPlatform(std::string* output) {
+  DWORD data_len = held_back_.size();
+  DWORD total_len = data_len + block_size_;
+  if (!encrypting_ && data_len == 0)
     return false;
 
-  std::vector<BYTE> tmp(data_len);
-  memcpy(&tmp[0], ciphertext.data(), data_len);
-
-  BOOL ok = CryptDecrypt(capi_key_.get(), NULL, TRUE, 0, &tmp[0], &data_len);
-  if (!ok)
+  size_t offset = output->size();
+  output->append(held_back_);
+  output->resize(offset + total_len);
+  BYTE* data = reinterpret_cast<BYTE*>(&(*output)[offset]);
+  BOOL ok = encrypting_ ?
+      CryptEncrypt(capi_key_.get(), NULL, TRUE, 0, data, &data_len,
+                   total_len) :
+      CryptDecrypt(capi_key_.get(), NULL, TRUE, 0, data, &data_len);
+  held_back_.clear();
+  if (!ok) {
+    output->resize(offset);
     return false;
+  }
 
-  DCHECK_GT(tmp.size(), data_len);
-
-  plaintext->assign(reinterpret_cast<char*>(&tmp[0]), data_len);
+  DCHECK_GE(total_len, data_len);
+  output->resize(offset + data_len);
   return true;
 }
 
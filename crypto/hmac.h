@@ -13,6 +13,7 @@
 
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/string_piece.h"
 
 namespace crypto {
 
@@ -44,7 +45,11 @@ class HMAC {
   // Calculates the HMAC for the message in |data| using the algorithm supplied
   // to the constructor and the key supplied to the Init method. The HMAC is
   // returned in |digest|, which has |digest_length| bytes of storage available.
-  bool Sign(const std::string& data, unsigned char* digest, int digest_length);
+  // The keyed state is set up once by Init, so an HMAC object should be kept
+  // around to sign many messages with the same key.
+  bool Sign(const base::StringPiece& data,
+            unsigned char* digest,
+            int digest_length);
 
   // TODO(albertb): Add a Verify method.
 
@@ -5,15 +5,43 @@
 #include "crypto/hmac.h"
 
 #include <CommonCrypto/CommonHMAC.h>
+#include <string.h>
 
 #include "base/logging.h"
 
 namespace crypto {
 
 struct HMACPlatformData {
-  std::string key_;
+  HMACPlatformData() : initialized_(false) {}
+
+  // State after hashing the padded key.  CCHmacContext is a plain struct, so
+  // Sign copies it instead of hashing the key again for every message.
+  CCHmacContext context_;
+  bool initialized_;
 };
 
+namespace {
+
+bool GetAlgorithm(HMAC::HashAlgorithm hash_alg,
+                  CCHmacAlgorithm* algorithm,
+                  int* algorithm_digest_length) {
+  switch (hash_alg) {
+    case HMAC::SHA1:
+      *algorithm = kCCHmacAlgSHA1;
+      *algorithm_digest_length = CC_SHA1_DIGEST_LENGTH;
+      return true;
+    case HMAC::SHA256:
+      *algorithm = kCCHmacAlgSHA256;
+      *algorithm_digest_length = CC_SHA256_DIGEST_LENGTH;
+      return true;
+    default:
+      NOTREACHED();
+      return false;
+  }
+}
+
+}  // namespace
+
 HMAC::HMAC(HashAlgorithm hash_alg)
     : hash_alg_(hash_alg), plat_(new HMACPlatformData()) {
   // Only SHA-1 and SHA-256 hash algorithms are supported now.
@@ -21,51 +49,49 @@ HMAC::HMAC(HashAlgorithm hash_alg)
 }
 
 bool HMAC::Init(const unsigned char *key, int key_length) {
-  if (!plat_->key_.empty()) {
+  if (plat_->initialized_) {
     // Init must not be called more than once on the same HMAC object.
     NOTREACHED();
     return false;
   }
 
-  plat_->key_.assign(reinterpret_cast<const char*>(key), key_length);
+  CCHmacAlgorithm algorithm;
+  int algorithm_digest_length;
+  if (!GetAlgorithm(hash_alg_, &algorithm, &algorithm_digest_length))
+    return false;
 
+  CCHmacInit(&plat_->context_, algorithm, key, key_length);
+  plat_->initialized_ = true;
   return true;
 }
 
 HMAC::~HMAC() {
-  // Zero out key copy.
-  plat_->key_.assign(plat_->key_.length(), std::string::value_type());
-  plat_->key_.clear();
-  plat_->key_.reserve(0);
+  // Zero out the keyed state.
+  memset(&plat_->context_, 0, sizeof(plat_->context_));
 }
 
-bool HMAC::Sign(const std::string& data,
+bool HMAC::Sign(const base::StringPiece& data,
                 unsigned char* digest,
                 int digest_length) {
   CCHmacAlgorithm algorithm;
   int algorithm_digest_length;
-  switch (hash_alg_) {
-    case SHA1:
-      algorithm = kCCHmacAlgSHA1;
-      algorithm_digest_length = CC_SHA1_DIGEST_LENGTH;
-      break;
-    case SHA256:
-      algorithm = kCCHmacAlgSHA256;
-      algorithm_digest_length = CC_SHA256_DIGEST_LENGTH;
-      break;
-    default:
-      NOTREACHED();
-      return false;
-  }
+  if (!GetAlgorithm(hash_alg_, &algorithm, &algorithm_digest_length))
+    return false;
 
   if (digest_length < algorithm_digest_length) {
     NOTREACHED();
     return false;
   }
 
-  CCHmac(algorithm,
-         plat_->key_.data(), plat_->key_.length(), data.data(), data.length(),
-         digest);
+  if (!plat_->initialized_) {
+    NOTREACHED();
+    return false;
+  }
+
+  CCHmacContext context = plat_->context_;
+  CCHmacUpdate(&context, data.data(), data.length());
+  CCHmacFinal(&context, digest);
+  memset(&context, 0, sizeof(context));
 
   return true;
 }
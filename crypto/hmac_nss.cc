@@ -18,6 +18,11 @@ struct HMACPlatformData {
   CK_MECHANISM_TYPE mechanism_;
   ScopedPK11Slot slot_;
   ScopedPK11SymKey sym_key_;
+
+  // Signing context, created by the first Sign and restarted for the
+  // following messages.  It is dropped if a Sign fails half way, since
+  // PK11_DigestBegin does nothing to a context that is already started.
+  ScopedPK11Context context_;
 };
 
 HMAC::HMAC(HashAlgorithm hash_alg)
@@ -73,7 +78,7 @@ bool HMAC::Init(const unsigned char *key, int key_length) {
   return true;
 }
 
-bool HMAC::Sign(const std::string& data,
+bool HMAC::Sign(const base::StringPiece& data,
                 unsigned char* digest,
                 int digest_length) {
   if (!plat_->sym_key_.get()) {
@@ -82,32 +87,38 @@ bool HMAC::Sign(const std::string& data,
     return false;
   }
 
-  SECItem param = { siBuffer, NULL, 0 };
-  ScopedPK11Context context(PK11_CreateContextBySymKey(plat_->mechanism_,
-                                                       CKA_SIGN,
-                                                       plat_->sym_key_.get(),
-                                                       &param));
-  if (!context.get()) {
-    NOTREACHED();
-    return false;
+  if (!plat_->context_.get()) {
+    SECItem param = { siBuffer, NULL, 0 };
+    plat_->context_.reset(PK11_CreateContextBySymKey(plat_->mechanism_,
+                                                     CKA_SIGN,
+                                                     plat_->sym_key_.get(),
+                                                     &param));
+    if (!plat_->context_.get()) {
+      NOTREACHED();
+      return false;
+    }
   }
 
-  if (PK11_DigestBegin(context.get()) != SECSuccess) {
+  PK11Context* context = plat_->context_.get();
+  if (PK11_DigestBegin(context) != SECSuccess) {
     NOTREACHED();
+    plat_->context_.reset();
     return false;
   }
 
-  if (PK11_DigestOp(context.get(),
+  if (PK11_DigestOp(context,
                     reinterpret_cast<const unsigned char*>(data.data()),
                     data.length()) != SECSuccess) {
     NOTREACHED();
+    plat_->context_.reset();
     return false;
   }
 
   unsigned int len = 0;
-  if (PK11_DigestFinal(context.get(),
+  if (PK11_DigestFinal(context,
                        digest, &len, digest_length) != SECSuccess) {
     NOTREACHED();
+    plat_->context_.reset();
     return false;
   }
 
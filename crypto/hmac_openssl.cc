@@ -6,18 +6,30 @@
 
 #include <openssl/hmac.h>
 
-#include <algorithm>
-#include <vector>
-
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
-#include "base/stl_util-inl.h"
 #include "crypto/openssl_util.h"
 
 namespace crypto {
 
 struct HMACPlatformData {
-  std::vector<unsigned char> key;
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+  HMACPlatformData() : ctx(HMAC_CTX_new()), initialized(false) {}
+  ~HMACPlatformData() { HMAC_CTX_free(ctx); }
+  HMAC_CTX* get() { return ctx; }
+
+  HMAC_CTX* ctx;
+#else
+  HMACPlatformData() : initialized(false) { HMAC_CTX_init(&ctx); }
+  ~HMACPlatformData() { HMAC_CTX_cleanup(&ctx); }
+  HMAC_CTX* get() { return &ctx; }
+
+  HMAC_CTX ctx;
+#endif
+
+  // Whether |ctx| holds the padded key, ready to be restarted for each
+  // message.
+  bool initialized;
 };
 
 HMAC::HMAC(HashAlgorithm hash_alg)
@@ -28,30 +40,39 @@ HMAC::HMAC(HashAlgorithm hash_alg)
 
 bool HMAC::Init(const unsigned char* key, int key_length) {
   // Init must not be called more than once on the same HMAC object.
-  DCHECK(plat_->key.empty());
+  DCHECK(!plat_->initialized);
+  if (!plat_->get())
+    return false;
 
-  plat_->key.assign(key, key + key_length);
-  return true;
+  // This hashes the inner and outer padded keys once; Sign() then starts from
+  // copies of those states.
+  OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  plat_->initialized = HMAC_Init_ex(plat_->get(), key, key_length,
+                                    hash_alg_ == SHA1 ? EVP_sha1() :
+                                                        EVP_sha256(),
+                                    NULL) == 1;
+  return plat_->initialized;
 }
 
 HMAC::~HMAC() {
-  // Zero out key copy.
-  plat_->key.assign(plat_->key.size(), 0);
-  STLClearObject(&plat_->key);
+  // The context's key state is cleared when it is freed.
 }
 
-bool HMAC::Sign(const std::string& data,
+bool HMAC::Sign(const base::StringPiece& data,
                 unsigned char* digest,
                 int digest_length) {
   DCHECK_GE(digest_length, 0);
-  DCHECK(!plat_->key.empty());  // Init must be called before Sign.
+  DCHECK(plat_->initialized);  // Init must be called before Sign.
+  if (!plat_->initialized)
+    return false;
 
+  OpenSSLErrStackTracer err_tracer(FROM_HERE);
   ScopedOpenSSLSafeSizeBuffer<EVP_MAX_MD_SIZE> result(digest, digest_length);
-  return ::HMAC(hash_alg_ == SHA1 ? EVP_sha1() : EVP_sha256(),
-                &plat_->key[0], plat_->key.size(),
-                reinterpret_cast<const unsigned char*>(data.data()),
-                data.size(),
-                result.safe_buffer(), NULL);
+  return HMAC_Init_ex(plat_->get(), NULL, 0, NULL, NULL) == 1 &&
+         HMAC_Update(plat_->get(),
+                     reinterpret_cast<const unsigned char*>(data.data()),
+                     data.size()) == 1 &&
+         HMAC_Final(plat_->get(), result.safe_buffer(), NULL) == 1;
 }
 
 }  // namespace crypto
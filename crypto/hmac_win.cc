@@ -29,9 +29,10 @@ enum {
 };
 
 // See FIPS 198: The Keyed-Hash Message Authentication Code (HMAC).
-void ComputeHMACSHA256(const unsigned char* key, size_t key_len,
-                       const unsigned char* text, size_t text_len,
-                       unsigned char* output, size_t output_len) {
+// Computes the SHA-256 states after hashing the inner and outer padded keys,
+// which ComputeHMACSHA256 continues from for every message.
+void InitHMACSHA256(const unsigned char* key, size_t key_len,
+                    SHA256Context* inner, SHA256Context* outer) {
   SHA256Context ctx;
 
   // Pre-process the key, if necessary.
@@ -47,25 +48,37 @@ void ComputeHMACSHA256(const unsigned char* key, size_t key_len,
   }
 
   unsigned char padded_key[SHA256_BLOCK_SIZE];
-  unsigned char inner_hash[SHA256_LENGTH];
 
   // XOR key0 with ipad.
   for (int i = 0; i < SHA256_BLOCK_SIZE; ++i)
     padded_key[i] = key0[i] ^ 0x36;
-
-  // Compute the inner hash.
-  SHA256_Begin(&ctx);
-  SHA256_Update(&ctx, padded_key, SHA256_BLOCK_SIZE);
-  SHA256_Update(&ctx, text, text_len);
-  SHA256_End(&ctx, inner_hash, NULL, SHA256_LENGTH);
+  SHA256_Begin(inner);
+  SHA256_Update(inner, padded_key, SHA256_BLOCK_SIZE);
 
   // XOR key0 with opad.
   for (int i = 0; i < SHA256_BLOCK_SIZE; ++i)
     padded_key[i] = key0[i] ^ 0x5c;
+  SHA256_Begin(outer);
+  SHA256_Update(outer, padded_key, SHA256_BLOCK_SIZE);
+
+  SecureZeroMemory(key0, sizeof(key0));
+  SecureZeroMemory(padded_key, sizeof(padded_key));
+  SecureZeroMemory(&ctx, sizeof(ctx));
+}
+
+void ComputeHMACSHA256(const SHA256Context& inner,
+                       const SHA256Context& outer,
+                       const unsigned char* text, size_t text_len,
+                       unsigned char* output, size_t output_len) {
+  unsigned char inner_hash[SHA256_LENGTH];
+
+  // Compute the inner hash.
+  SHA256Context ctx = inner;
+  SHA256_Update(&ctx, text, text_len);
+  SHA256_End(&ctx, inner_hash, NULL, SHA256_LENGTH);
 
   // Compute the outer hash.
-  SHA256_Begin(&ctx);
-  SHA256_Update(&ctx, padded_key, SHA256_BLOCK_SIZE);
+  ctx = outer;
   SHA256_Update(&ctx, inner_hash, SHA256_LENGTH);
   SHA256_End(&ctx, output, NULL, output_len);
 }
@@ -73,10 +86,11 @@ void ComputeHMACSHA256(const unsigned char* key, size_t key_len,
 }  // namespace
 
 struct HMACPlatformData {
+  HMACPlatformData() : sha256_initialized_(false) {}
+
   ~HMACPlatformData() {
-    if (!raw_key_.empty()) {
-      SecureZeroMemory(&raw_key_[0], raw_key_.size());
-    }
+    SecureZeroMemory(&inner_, sizeof(inner_));
+    SecureZeroMemory(&outer_, sizeof(outer_));
 
     // Destroy the key before releasing the provider.
     key_.reset();
@@ -85,8 +99,11 @@ struct HMACPlatformData {
   ScopedHCRYPTPROV provider_;
   ScopedHCRYPTKEY key_;
 
-  // For HMAC-SHA-256 only.
-  std::vector<unsigned char> raw_key_;
+  // For HMAC-SHA-256 only: the hash states after the inner and outer padded
+  // keys, so the key is only processed once.
+  SHA256Context inner_;
+  SHA256Context outer_;
+  bool sha256_initialized_;
 };
 
 HMAC::HMAC(HashAlgorithm hash_alg)
@@ -96,7 +113,7 @@ HMAC::HMAC(HashAlgorithm hash_alg)
 }
 
 bool HMAC::Init(const unsigned char* key, int key_length) {
-  if (plat_->provider_ || plat_->key_ || !plat_->raw_key_.empty()) {
+  if (plat_->provider_ || plat_->key_ || plat_->sha256_initialized_) {
     // Init must not be called more than once on the same HMAC object.
     NOTREACHED();
     return false;
@@ -105,7 +122,8 @@ bool HMAC::Init(const unsigned char* key, int key_length) {
   if (hash_alg_ == SHA256) {
     if (key_length < SHA256_LENGTH / 2)
       return false;  // Key is too short.
-    plat_->raw_key_.assign(key, key + key_length);
+    InitHMACSHA256(key, key_length, &plat_->inner_, &plat_->outer_);
+    plat_->sha256_initialized_ = true;
     return true;
   }
 
@@ -154,13 +172,13 @@ bool HMAC::Init(const unsigned char* key, int key_length) {
 HMAC::~HMAC() {
 }
 
-bool HMAC::Sign(const std::string& data,
+bool HMAC::Sign(const base::StringPiece& data,
                 unsigned char* digest,
                 int digest_length) {
   if (hash_alg_ == SHA256) {
-    if (plat_->raw_key_.empty())
+    if (!plat_->sha256_initialized_)
       return false;
-    ComputeHMACSHA256(&plat_->raw_key_[0], plat_->raw_key_.size(),
+    ComputeHMACSHA256(plat_->inner_, plat_->outer_,
                       reinterpret_cast<const unsigned char*>(data.data()),
                       data.size(), digest, digest_length);
     return true;
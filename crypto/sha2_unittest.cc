@@ -4,7 +4,13 @@
 
 #include "crypto/sha2.h"
 
+#include <algorithm>
+
 #include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time.h"
+#include "crypto/secure_hash.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 TEST(Sha256Test, Test1) {
@@ -98,3 +104,49 @@ TEST(Sha256Test, Test3) {
   for (size_t i = 0; i < sizeof(output_truncated3); i++)
     EXPECT_EQ(expected3[i], static_cast<int>(output_truncated3[i]));
 }
+
+TEST(Sha256Test, PartialUpdates) {
+  // Feeding a long message in odd-sized pieces must give the same result as
+  // hashing it at once, whether the pieces straddle block boundaries or cover
+  // several blocks.
+  std::string input;
+  for (int i = 0; i < 4096; ++i)
+    input.push_back(static_cast<char>(i * 7));
+  const std::string expected = crypto::SHA256HashString(input);
+
+  const size_t kChunkSizes[] = { 1, 3, 63, 64, 65, 200, 1000 };
+  for (size_t i = 0; i < arraysize(kChunkSizes); ++i) {
+    scoped_ptr<crypto::SecureHash> ctx(
+        crypto::SecureHash::Create(crypto::SecureHash::SHA256));
+    for (size_t offset = 0; offset < input.size(); offset += kChunkSizes[i]) {
+      ctx->Update(input.data() + offset,
+                  std::min(kChunkSizes[i], input.size() - offset));
+    }
+    std::string output(crypto::SHA256_LENGTH, 0);
+    ctx->Finish(&output[0], output.size());
+    EXPECT_EQ(expected, output) << kChunkSizes[i];
+  }
+}
+
+// Hashes messages from 32 bytes to 16MB. Run with --v=1 to see the
+// throughput.
+TEST(Sha256Test, Throughput) {
+  const size_t kBytesPerSize = 16 << 20;
+  const size_t kSizes[] = { 32, 1024, 64 << 10, 1 << 20, 16 << 20 };
+  std::string input(kSizes[arraysize(kSizes) - 1], 'a');
+  uint8 output[crypto::SHA256_LENGTH];
+
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t hashed = 0; hashed < kBytesPerSize; hashed += kSizes[i]) {
+      scoped_ptr<crypto::SecureHash> ctx(
+          crypto::SecureHash::Create(crypto::SecureHash::SHA256));
+      ctx->Update(input.data(), kSizes[i]);
+      ctx->Finish(output, sizeof(output));
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    VLOG(1) << kSizes[i] << " byte messages: "
+            << kBytesPerSize / std::max<int64>(elapsed.InMicroseconds(), 1)
+            << " MB/s";
+  }
+}
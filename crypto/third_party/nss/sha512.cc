@@ -52,6 +52,20 @@
 
 #include <stdlib.h>
 #include <string.h>
+
+#include "base/cpu.h"
+#include "base/lazy_instance.h"
+#include "build/build_config.h"
+
+/* The SHA extension intrinsics need per-function target attributes, which
+ * older compilers lack. */
+#if defined(ARCH_CPU_X86_FAMILY) && (defined(__clang__) || \
+    (defined(COMPILER_GCC) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SHA256_USE_SHA_NI 1
+#include <immintrin.h>
+#endif
+
 #define PORT_New(type) static_cast<type*>(malloc(sizeof(type)))
 #define PORT_ZFree(ptr, len) do { memset(ptr, 0, len); free(ptr); } while (0)
 #define PORT_Strlen(s) static_cast<unsigned int>(strlen(s))
@@ -103,6 +117,129 @@ static const PRUint32 H256[8] = {
     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
 };
 
+#if defined(SHA256_USE_SHA_NI)
+/* Compression function using the SHA extensions, for |num_blocks| 64-byte
+ * blocks at |data|.  The instructions work on the state split as ABEF and
+ * CDGH, two rounds at a time. */
+
+/* Four rounds using message words |msg| and constants K256[k..k+3]. */
+#define SHA256_ROUNDS4(msg, k)                                             \
+  tmp = _mm_add_epi32(msg, _mm_loadu_si128(                                \
+      reinterpret_cast<const __m128i*>(K256 + (k))));                      \
+  cdgh = _mm_sha256rnds2_epu32(cdgh, abef, tmp);                           \
+  tmp = _mm_shuffle_epi32(tmp, 0x0e);                                      \
+  abef = _mm_sha256rnds2_epu32(abef, cdgh, tmp)
+
+/* Message schedule: msg2 finishes the words for the next four rounds, msg1
+ * starts the ones three groups ahead. */
+#define SHA256_MSG2(next, cur, prev)                                       \
+  next = _mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4));               \
+  next = _mm_sha256msg2_epu32(next, cur)
+#define SHA256_MSG1(target, cur) target = _mm_sha256msg1_epu32(target, cur)
+
+__attribute__((target("sha,sse4.1")))
+static void
+SHA256_CompressBlocksSHANI(PRUint32 *state, const unsigned char *data,
+                           size_t num_blocks)
+{
+    const __m128i kByteSwap =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp, abef, cdgh;
+
+    tmp = _mm_shuffle_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xb1);
+    cdgh = _mm_shuffle_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1b);
+    abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+    for (; num_blocks; --num_blocks, data += SHA256_BLOCK_LENGTH) {
+        const __m128i abef_save = abef;
+        const __m128i cdgh_save = cdgh;
+        const __m128i *block = reinterpret_cast<const __m128i*>(data);
+        __m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128(block), kByteSwap);
+        __m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128(block + 1), kByteSwap);
+        __m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128(block + 2), kByteSwap);
+        __m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128(block + 3), kByteSwap);
+
+        SHA256_ROUNDS4(msg0, 0);
+        SHA256_ROUNDS4(msg1, 4);
+        SHA256_MSG1(msg0, msg1);
+        SHA256_ROUNDS4(msg2, 8);
+        SHA256_MSG1(msg1, msg2);
+        SHA256_ROUNDS4(msg3, 12);
+        SHA256_MSG2(msg0, msg3, msg2);
+        SHA256_MSG1(msg2, msg3);
+
+        SHA256_ROUNDS4(msg0, 16);
+        SHA256_MSG2(msg1, msg0, msg3);
+        SHA256_MSG1(msg3, msg0);
+        SHA256_ROUNDS4(msg1, 20);
+        SHA256_MSG2(msg2, msg1, msg0);
+        SHA256_MSG1(msg0, msg1);
+        SHA256_ROUNDS4(msg2, 24);
+        SHA256_MSG2(msg3, msg2, msg1);
+        SHA256_MSG1(msg1, msg2);
+        SHA256_ROUNDS4(msg3, 28);
+        SHA256_MSG2(msg0, msg3, msg2);
+        SHA256_MSG1(msg2, msg3);
+
+        SHA256_ROUNDS4(msg0, 32);
+        SHA256_MSG2(msg1, msg0, msg3);
+        SHA256_MSG1(msg3, msg0);
+        SHA256_ROUNDS4(msg1, 36);
+        SHA256_MSG2(msg2, msg1, msg0);
+        SHA256_MSG1(msg0, msg1);
+        SHA256_ROUNDS4(msg2, 40);
+        SHA256_MSG2(msg3, msg2, msg1);
+        SHA256_MSG1(msg1, msg2);
+        SHA256_ROUNDS4(msg3, 44);
+        SHA256_MSG2(msg0, msg3, msg2);
+        SHA256_MSG1(msg2, msg3);
+
+        SHA256_ROUNDS4(msg0, 48);
+        SHA256_MSG2(msg1, msg0, msg3);
+        SHA256_MSG1(msg3, msg0);
+        SHA256_ROUNDS4(msg1, 52);
+        SHA256_MSG2(msg2, msg1, msg0);
+        SHA256_ROUNDS4(msg2, 56);
+        SHA256_MSG2(msg3, msg2, msg1);
+        SHA256_ROUNDS4(msg3, 60);
+
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(abef, 0x1b);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state),
+                     _mm_blend_epi16(tmp, cdgh, 0xf0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4),
+                     _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+#undef SHA256_ROUNDS4
+#undef SHA256_MSG2
+#undef SHA256_MSG1
+#endif  /* SHA256_USE_SHA_NI */
+
+/* Picks the compression function once per process. */
+struct SHA256Dispatch {
+    SHA256Dispatch() : use_sha_ni(false) {
+#if defined(SHA256_USE_SHA_NI)
+        base::CPU cpu;
+        use_sha_ni = cpu.has_sha() && cpu.has_sse41();
+#endif
+    }
+
+    bool use_sha_ni;
+};
+
+/* Leaky, since hashing may happen without an AtExitManager. */
+static base::LazyInstance<SHA256Dispatch,
+                          base::LeakyLazyInstanceTraits<SHA256Dispatch> >
+    g_sha256_dispatch(base::LINKER_INITIALIZED);
+
 #if defined(_MSC_VER) && defined(_X86_)
 #ifndef FORCEINLINE
 #if (_MSC_VER >= 1200)
@@ -393,6 +530,19 @@ SHA256_Compress(SHA256Context *ctx)
 #undef S0
 #undef S1
 
+/* Compresses the block buffered in the context. */
+static void
+SHA256_CompressBuffer(SHA256Context *ctx)
+{
+#if defined(SHA256_USE_SHA_NI)
+    if (g_sha256_dispatch.Get().use_sha_ni) {
+	SHA256_CompressBlocksSHANI(H, B, 1);
+	return;
+    }
+#endif
+    SHA256_Compress(ctx);
+}
+
 void
 SHA256_Update(SHA256Context *ctx, const unsigned char *input,
 		    unsigned int inputLen)
@@ -414,8 +564,18 @@ SHA256_Update(SHA256Context *ctx, const unsigned char *input,
 	input    += todo;
 	inputLen -= todo;
 	if (inBuf + todo == SHA256_BLOCK_LENGTH)
-	    SHA256_Compress(ctx);
+	    SHA256_CompressBuffer(ctx);
+    }
+
+#if defined(SHA256_USE_SHA_NI)
+    /* with the SHA extensions, hash whole blocks in place. */
+    if (inputLen >= SHA256_BLOCK_LENGTH && g_sha256_dispatch.Get().use_sha_ni) {
+	unsigned int blocks = inputLen / SHA256_BLOCK_LENGTH;
+	SHA256_CompressBlocksSHANI(H, input, blocks);
+	input    += blocks * SHA256_BLOCK_LENGTH;
+	inputLen -= blocks * SHA256_BLOCK_LENGTH;
     }
+#endif
 
     /* if enough data to fill one or more whole buffers, process them. */
     while (inputLen >= SHA256_BLOCK_LENGTH) {
@@ -452,7 +612,7 @@ SHA256_End(SHA256Context *ctx, unsigned char *digest,
     W[14] = hi;
     W[15] = lo;
 #endif
-    SHA256_Compress(ctx);
+    SHA256_CompressBuffer(ctx);
 
     /* now output the answer */
 #if defined(IS_LITTLE_ENDIAN)
@@ -47,6 +47,11 @@ const char kCertificateHeader[] = "CERTIFICATE";
 // The PEM block header used for PKCS#7 data
 const char kPKCS7Header[] = "PKCS7";
 
+// The certificate cache and the handle intern table are split into shards,
+// chosen by the first byte of the fingerprint, each with its own lock, so
+// that threads creating certificates rarely contend.
+const size_t kNumShards = 16;
+
 // A thread-safe cache for X509Certificate objects.
 //
 // The cache does not hold a reference to the certificate objects.  The objects
@@ -64,17 +69,23 @@ class X509CertificateCache {
   typedef std::map<SHA1Fingerprint, scoped_refptr<X509Certificate>, SHA1FingerprintLessThan>
       CertMap;
 
+  struct Shard {
+    // You must acquire this lock before using |cache|.  You must not block
+    // while holding this lock.
+    base::Lock lock;
+    CertMap cache;
+  };
+
   // Obtain an instance of X509CertificateCache via a LazyInstance.
   X509CertificateCache() {}
   ~X509CertificateCache() {}
   friend struct base::DefaultLazyInstanceTraits<X509CertificateCache>;
 
-  // You must acquire this lock before using any private data of this object.
-  // You must not block while holding this lock.
-  base::Lock lock_;
+  Shard* GetShard(const SHA1Fingerprint& fingerprint) {
+    return &shards_[fingerprint.data[0] % kNumShards];
+  }
 
-  // The certificate cache.  You must acquire |lock_| before using |cache_|.
-  CertMap cache_;
+  Shard shards_[kNumShards];
 
   DISALLOW_COPY_AND_ASSIGN(X509CertificateCache);
 };
@@ -86,26 +97,30 @@ base::LazyInstance<X509CertificateCache,
 // Insert |cert| into the cache.  The cache does NOT AddRef |cert|.
 // Any existing certificate with the same fingerprint will be replaced.
 void X509CertificateCache::Insert(X509Certificate* cert) {
-  base::AutoLock lock(lock_);
-
   DCHECK(!IsNullFingerprint(cert->fingerprint())) <<
       "Only insert certs with real fingerprints.";
-  // Sanity test: never cache more than 50 certs
-  while (cache_.size() >= 50)
-    cache_.erase(cache_.begin());
+  Shard* shard = GetShard(cert->fingerprint());
+  base::AutoLock lock(shard->lock);
+  CertMap& cache = shard->cache;
+
+  // Sanity test: never cache more than 32 certs per shard
+  while (cache.size() >= 32)
+    cache.erase(cache.begin());
 
-  cache_[cert->fingerprint()] = cert;
+  cache[cert->fingerprint()] = cert;
 
-  // Trim the cache if there are unused certs remaining. Aim to hold between
-  // 10 and 20 certs in the cache in normal usage.
-  if (cache_.size() <= 20)  // high water mark
+  // Trim the shard if there are unused certs remaining. Aim to hold between
+  // 4 and 8 certs in each shard in normal usage.
+  if (cache.size() <= 8)  // high water mark
     return;
 
-  for (CertMap::iterator it = cache_.begin(); it != cache_.end(); ++it) {
+  for (CertMap::iterator it = cache.begin(); it != cache.end();) {
     if (it->second->HasOneRef()) {
-      cache_.erase(it);
-      if (cache_.size() <= 10)  // low water mark
+      cache.erase(it++);
+      if (cache.size() <= 4)  // low water mark
         return;
+    } else {
+      ++it;
     }
   }
 };
@@ -114,15 +129,53 @@ void X509CertificateCache::Insert(X509Certificate* cert) {
 // not exist, this method returns NULL.
 scoped_refptr<X509Certificate> X509CertificateCache::Find(
     const SHA1Fingerprint& fingerprint) {
-  base::AutoLock lock(lock_);
+  Shard* shard = GetShard(fingerprint);
+  base::AutoLock lock(shard->lock);
 
-  CertMap::iterator pos(cache_.find(fingerprint));
-  if (pos == cache_.end())
+  CertMap::iterator pos(shard->cache.find(fingerprint));
+  if (pos == shard->cache.end())
     return NULL;
 
   return pos->second;
 };
 
+// A thread-safe table of parsed certificates, keyed by the SHA-1 hash of
+// their DER encoding, so that certificates which are seen over and over, like
+// the intermediates sent by busy servers, are only parsed once.  The table
+// holds a reference to each handle; when a shard is full, an arbitrary entry
+// is dropped, which is harmless since the users hold references of their own.
+class OSCertHandleInternTable {
+ public:
+  // Returns a handle for |der_cert|, whose SHA-1 hash is |fingerprint|, or
+  // NULL if it cannot be parsed.  The caller must free the handle.
+  X509Certificate::OSCertHandle Intern(const base::StringPiece& der_cert,
+                                       const SHA1Fingerprint& fingerprint);
+
+ private:
+  typedef std::map<SHA1Fingerprint, X509Certificate::OSCertHandle,
+                   SHA1FingerprintLessThan> HandleMap;
+
+  struct Shard {
+    base::Lock lock;
+    HandleMap handles;
+  };
+
+  OSCertHandleInternTable() {}
+  ~OSCertHandleInternTable() {}
+  friend struct base::DefaultLazyInstanceTraits<OSCertHandleInternTable>;
+
+  Shard shards_[kNumShards];
+
+  DISALLOW_COPY_AND_ASSIGN(OSCertHandleInternTable);
+};
+
+base::LazyInstance<OSCertHandleInternTable,
+                   base::LeakyLazyInstanceTraits<OSCertHandleInternTable> >
+    g_os_cert_handle_intern_table(base::LINKER_INITIALIZED);
+
+// The most handles held by each shard of the intern table.
+const size_t kMaxInternedHandlesPerShard = 64;
+
 // CompareSHA1Hashes is a helper function for using bsearch() with an array of
 // SHA1 hashes.
 static int CompareSHA1Hashes(const void* a, const void* b) {
@@ -149,10 +202,32 @@ X509Certificate::X509Certificate(const std::string& subject,
       valid_start_(start_date),
       valid_expiry_(expiration_date),
       cert_handle_(NULL),
+      dns_names_parsed_(false),
       source_(SOURCE_UNUSED) {
   memset(fingerprint_.data, 0, sizeof(fingerprint_.data));
 }
 
+// static
+scoped_refptr<X509Certificate> X509Certificate::FindCachedCertificate(
+    const SHA1Fingerprint& fingerprint,
+    Source source,
+    const OSCertHandles& intermediates) {
+  scoped_refptr<X509Certificate> cached_cert =
+      g_x509_certificate_cache.Pointer()->Find(fingerprint);
+  if (!cached_cert)
+    return NULL;
+
+  DCHECK(cached_cert->source_ != SOURCE_UNUSED);
+  if (cached_cert->source_ > source ||
+      (cached_cert->source_ == source &&
+       cached_cert->HasIntermediateCertificates(intermediates))) {
+    DHISTOGRAM_COUNTS("X509CertificateReuseCount", 1);
+    return cached_cert;
+  }
+  // Else the new cert is better and will replace the old one in the cache.
+  return NULL;
+}
+
 // static
 scoped_refptr<X509Certificate> X509Certificate::CreateFromHandle(
     OSCertHandle cert_handle,
@@ -162,25 +237,15 @@ scoped_refptr<X509Certificate> X509Certificate::CreateFromHandle(
   DCHECK(source != SOURCE_UNUSED);
 
   // Check if we already have this certificate in memory.
-  X509CertificateCache* cache = g_x509_certificate_cache.Pointer();
-  scoped_refptr<X509Certificate> cached_cert =
-      cache->Find(CalculateFingerprint(cert_handle));
-  if (cached_cert) {
-    DCHECK(cached_cert->source_ != SOURCE_UNUSED);
-    if (cached_cert->source_ > source ||
-        (cached_cert->source_ == source &&
-         cached_cert->HasIntermediateCertificates(intermediates))) {
-      // Return the certificate with the same fingerprint from our cache.
-      DHISTOGRAM_COUNTS("X509CertificateReuseCount", 1);
-      return cached_cert;
-    }
-    // Else the new cert is better and will replace the old one in the cache.
-  }
+  scoped_refptr<X509Certificate> cached_cert = FindCachedCertificate(
+      CalculateFingerprint(cert_handle), source, intermediates);
+  if (cached_cert)
+    return cached_cert;
 
   // Otherwise, allocate and cache a new object.
   scoped_refptr<X509Certificate> cert = new X509Certificate(cert_handle, source,
                                                             intermediates);
-  cache->Insert(cert);
+  g_x509_certificate_cache.Pointer()->Insert(cert);
   return cert;
 }
 
@@ -200,6 +265,58 @@ static X509Certificate::OSCertHandle CreateOSCert(base::StringPiece der_cert) {
 }
 #endif
 
+X509Certificate::OSCertHandle OSCertHandleInternTable::Intern(
+    const base::StringPiece& der_cert,
+    const SHA1Fingerprint& fingerprint) {
+  Shard* shard = &shards_[fingerprint.data[0] % kNumShards];
+  {
+    base::AutoLock lock(shard->lock);
+    HandleMap::iterator pos(shard->handles.find(fingerprint));
+    if (pos != shard->handles.end())
+      return X509Certificate::DupOSCertHandle(pos->second);
+  }
+
+  // Parse without holding the lock.  If another thread interns the same
+  // certificate meanwhile, the first one in is kept.
+  X509Certificate::OSCertHandle cert_handle = CreateOSCert(der_cert);
+  if (!cert_handle)
+    return NULL;
+
+  base::AutoLock lock(shard->lock);
+  std::pair<HandleMap::iterator, bool> inserted = shard->handles.insert(
+      std::make_pair(fingerprint, cert_handle));
+  if (!inserted.second) {
+    X509Certificate::FreeOSCertHandle(cert_handle);
+    return X509Certificate::DupOSCertHandle(inserted.first->second);
+  }
+  if (shard->handles.size() > kMaxInternedHandlesPerShard) {
+    HandleMap::iterator victim = shard->handles.begin();
+    if (victim == inserted.first)
+      ++victim;
+    X509Certificate::FreeOSCertHandle(victim->second);
+    shard->handles.erase(victim);
+  }
+  return X509Certificate::DupOSCertHandle(cert_handle);
+}
+
+// Returns the SHA-1 hash of |der_cert|, which is the fingerprint of the
+// certificate it encodes.
+static SHA1Fingerprint HashDERCert(const base::StringPiece& der_cert) {
+  SHA1Fingerprint fingerprint;
+  base::SHA1HashBytes(reinterpret_cast<const unsigned char*>(der_cert.data()),
+                      der_cert.size(), fingerprint.data);
+  return fingerprint;
+}
+
+// Returns a handle for |der_cert|, which the caller must free, sharing the
+// parsed certificate with earlier calls for the same bytes.
+static X509Certificate::OSCertHandle InternOSCert(
+    const base::StringPiece& der_cert,
+    const SHA1Fingerprint& fingerprint) {
+  return g_os_cert_handle_intern_table.Pointer()->Intern(der_cert,
+                                                         fingerprint);
+}
+
 // static
 scoped_refptr<X509Certificate> X509Certificate::CreateFromDERCertChain(
     const std::vector<base::StringPiece>& der_certs) {
@@ -208,16 +325,22 @@ scoped_refptr<X509Certificate> X509Certificate::CreateFromDERCertChain(
 
   X509Certificate::OSCertHandles intermediate_ca_certs;
   for (size_t i = 1; i < der_certs.size(); i++) {
-    OSCertHandle handle = CreateOSCert(der_certs[i]);
+    OSCertHandle handle = InternOSCert(der_certs[i], HashDERCert(der_certs[i]));
     DCHECK(handle);
     intermediate_ca_certs.push_back(handle);
   }
 
-  OSCertHandle handle = CreateOSCert(der_certs[0]);
-  DCHECK(handle);
-  scoped_refptr<X509Certificate> cert =
-      CreateFromHandle(handle, SOURCE_FROM_NETWORK, intermediate_ca_certs);
-  FreeOSCertHandle(handle);
+  // The fingerprint of a certificate is the hash of its DER encoding, so a
+  // certificate we already have is found without parsing it again.
+  SHA1Fingerprint fingerprint = HashDERCert(der_certs[0]);
+  scoped_refptr<X509Certificate> cert = FindCachedCertificate(
+      fingerprint, SOURCE_FROM_NETWORK, intermediate_ca_certs);
+  if (!cert) {
+    OSCertHandle handle = InternOSCert(der_certs[0], fingerprint);
+    DCHECK(handle);
+    cert = CreateFromHandle(handle, SOURCE_FROM_NETWORK, intermediate_ca_certs);
+    FreeOSCertHandle(handle);
+  }
   for (size_t i = 0; i < intermediate_ca_certs.size(); i++)
     FreeOSCertHandle(intermediate_ca_certs[i]);
 
@@ -227,13 +350,21 @@ scoped_refptr<X509Certificate> X509Certificate::CreateFromDERCertChain(
 // static
 scoped_refptr<X509Certificate> X509Certificate::CreateFromBytes(const char* data,
                                                   int length) {
+  if (length < 0)
+    return NULL;
+  base::StringPiece der_cert(data, length);
+  SHA1Fingerprint fingerprint = HashDERCert(der_cert);
+  scoped_refptr<X509Certificate> cert = FindCachedCertificate(
+      fingerprint, SOURCE_LONE_CERT_IMPORT, OSCertHandles());
+  if (cert)
+    return cert;
+
   OSCertHandle cert_handle = CreateOSCertHandleFromBytes(data, length);
   if (!cert_handle)
     return NULL;
 
-  scoped_refptr<X509Certificate> cert = CreateFromHandle(cert_handle,
-                                           SOURCE_LONE_CERT_IMPORT,
-                                           OSCertHandles());
+  cert = CreateFromHandle(cert_handle, SOURCE_LONE_CERT_IMPORT,
+                          OSCertHandles());
   FreeOSCertHandle(cert_handle);
   return cert;
 }
@@ -523,6 +654,15 @@ bool X509Certificate::VerifyHostname(
   return false;
 }
 
+void X509Certificate::GetDNSNames(std::vector<std::string>* dns_names) const {
+  base::AutoLock lock(dns_names_lock_);
+  if (!dns_names_parsed_) {
+    ParseDNSNames(&dns_names_);
+    dns_names_parsed_ = true;
+  }
+  *dns_names = dns_names_;
+}
+
 #if !defined(USE_NSS)
 bool X509Certificate::VerifyNameMatch(const std::string& hostname) const {
   std::vector<std::string> dns_names;
@@ -535,6 +675,7 @@ X509Certificate::X509Certificate(OSCertHandle cert_handle,
                                  Source source,
                                  const OSCertHandles& intermediates)
     : cert_handle_(DupOSCertHandle(cert_handle)),
+      dns_names_parsed_(false),
       source_(source) {
   // Copy/retain the intermediate cert handles.
   for (size_t i = 0; i < intermediates.size(); ++i)
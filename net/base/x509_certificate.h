@@ -14,6 +14,7 @@
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
 #include "base/string_piece.h"
+#include "base/synchronization/lock.h"
 #include "base/time.h"
 #include "net/base/net_export.h"
 #include "net/base/x509_cert_types.h"
@@ -24,8 +25,6 @@
 #elif defined(OS_MACOSX)
 #include <CoreFoundation/CFArray.h>
 #include <Security/SecBase.h>
-
-#include "base/synchronization/lock.h"
 #elif defined(USE_OPENSSL)
 // Forward declaration; real one in <x509.h>
 struct x509_st;
@@ -222,7 +221,8 @@ class NET_EXPORT X509Certificate : public base::RefCountedThreadSafe<X509Certifi
   // Gets the DNS names in the certificate.  Pursuant to RFC 2818, Section 3.1
   // Server Identity, if the certificate has a subjectAltName extension of
   // type dNSName, this method gets the DNS names in that extension.
-  // Otherwise, it gets the common name in the subject field.
+  // Otherwise, it gets the common name in the subject field.  The names are
+  // extracted on the first call and kept.
   void GetDNSNames(std::vector<std::string>* dns_names) const;
 
   // Convenience method that returns whether this certificate has expired as of
@@ -364,6 +364,17 @@ class NET_EXPORT X509Certificate : public base::RefCountedThreadSafe<X509Certifi
   // Common object initialization code.  Called by the constructors only.
   void Initialize();
 
+  // Returns the certificate with |fingerprint| from the cache if it is at
+  // least as good as one from |source| with |intermediates| would be, or
+  // NULL.
+  static scoped_refptr<X509Certificate> FindCachedCertificate(
+      const SHA1Fingerprint& fingerprint,
+      Source source,
+      const OSCertHandles& intermediates);
+
+  // Extracts the names returned by GetDNSNames() from the certificate.
+  void ParseDNSNames(std::vector<std::string>* dns_names) const;
+
 #if defined(OS_WIN)
   bool CheckEV(PCCERT_CHAIN_CONTEXT chain_context,
                const char* policy_oid) const;
@@ -461,6 +472,12 @@ class NET_EXPORT X509Certificate : public base::RefCountedThreadSafe<X509Certifi
   // that may be needed for chain building.
   OSCertHandles intermediate_ca_certs_;
 
+  // The names returned by GetDNSNames(), once |dns_names_parsed_| is set.
+  // Guarded by |dns_names_lock_|.
+  mutable base::Lock dns_names_lock_;
+  mutable bool dns_names_parsed_;
+  mutable std::vector<std::string> dns_names_;
+
 #if defined(OS_MACOSX)
   // Blocks multiple threads from verifying the cert simultaneously.
   // (Marked mutable because it's used in a const method.)
@@ -773,8 +773,8 @@ X509Certificate* X509Certificate::CreateSelfSigned(
      X509Certificate::OSCertHandles());
 }
 
-void X509Certificate::GetDNSNames(std::vector<std::string>* dns_names) const {
-  dns_names->clear();
+void X509Certificate::ParseDNSNames(
+    std::vector<std::string>* dns_names) const {
 
   GetCertGeneralNamesForOID(cert_handle_, CSSMOID_SubjectAltName, GNT_DNSName,
                             dns_names);
@@ -394,8 +394,8 @@ scoped_refptr<X509Certificate> X509Certificate::CreateSelfSigned(
   return NULL;
 }
 
-void X509Certificate::GetDNSNames(std::vector<std::string>* dns_names) const {
-  dns_names->clear();
+void X509Certificate::ParseDNSNames(
+    std::vector<std::string>* dns_names) const {
 
   ParseSubjectAltNames(cert_handle_, dns_names);
 
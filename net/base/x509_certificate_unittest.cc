@@ -4,11 +4,13 @@
 
 #include "base/file_path.h"
 #include "base/file_util.h"
+#include "base/logging.h"
 #include "base/path_service.h"
 #include "base/pickle.h"
 #include "base/sha1.h"
 #include "base/string_number_conversions.h"
 #include "base/string_split.h"
+#include "base/time.h"
 #include "crypto/rsa_private_key.h"
 #include "net/base/asn1_util.h"
 #include "net/base/cert_status_flags.h"
@@ -742,6 +744,89 @@ TEST(X509CertificateTest, Policy) {
   EXPECT_TRUE(policy.HasDeniedCert());
 }
 
+// Tests that chains created from the same bytes share the parsed
+// certificates, and that a chain seen before comes from the cache.
+TEST(X509CertificateTest, CreateFromDERCertChainSharesCertificates) {
+  base::StringPiece google(reinterpret_cast<const char*>(google_der),
+                           sizeof(google_der));
+  base::StringPiece webkit(reinterpret_cast<const char*>(webkit_der),
+                           sizeof(webkit_der));
+  base::StringPiece thawte(reinterpret_cast<const char*>(thawte_der),
+                           sizeof(thawte_der));
+
+  std::vector<base::StringPiece> chain;
+  chain.push_back(webkit);
+  chain.push_back(thawte);
+  scoped_refptr<X509Certificate> cert1 =
+      X509Certificate::CreateFromDERCertChain(chain);
+  ASSERT_TRUE(cert1);
+  ASSERT_EQ(1u, cert1->GetIntermediateCertificates().size());
+
+  scoped_refptr<X509Certificate> cert2 =
+      X509Certificate::CreateFromDERCertChain(chain);
+  EXPECT_EQ(cert1, cert2);
+
+  // A different leaf with the same intermediate gets the same intermediate.
+  chain[0] = google;
+  scoped_refptr<X509Certificate> cert3 =
+      X509Certificate::CreateFromDERCertChain(chain);
+  ASSERT_TRUE(cert3);
+  EXPECT_NE(cert1, cert3);
+  ASSERT_EQ(1u, cert3->GetIntermediateCertificates().size());
+  EXPECT_EQ(cert1->GetIntermediateCertificates()[0],
+            cert3->GetIntermediateCertificates()[0]);
+
+  // A lone import of a certificate we have from the network gets that one.
+  scoped_refptr<X509Certificate> cert4 =
+      X509Certificate::CreateFromBytes(webkit.data(), webkit.size());
+  EXPECT_EQ(cert1, cert4);
+
+  // The names are extracted once, and the same each time.
+  std::vector<std::string> dns_names;
+  cert1->GetDNSNames(&dns_names);
+  ASSERT_EQ(2u, dns_names.size());
+  EXPECT_EQ("*.webkit.org", dns_names[0]);
+  dns_names.clear();
+  cert1->GetDNSNames(&dns_names);
+  ASSERT_EQ(2u, dns_names.size());
+  EXPECT_EQ("webkit.org", dns_names[1]);
+}
+
+// Measures creating certificates that have been seen before, as happens for
+// every connection to a busy server, and matching them against a host name.
+// Run with --v=1 to see the results.
+TEST(X509CertificateTest, RepeatedChainBenchmark) {
+  const int kIterations = 20000;
+  std::vector<base::StringPiece> chain;
+  chain.push_back(base::StringPiece(reinterpret_cast<const char*>(webkit_der),
+                                    sizeof(webkit_der)));
+  chain.push_back(base::StringPiece(reinterpret_cast<const char*>(thawte_der),
+                                    sizeof(thawte_der)));
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    scoped_refptr<X509Certificate> cert =
+        X509Certificate::CreateFromDERCertChain(chain);
+    ASSERT_TRUE(cert);
+    EXPECT_TRUE(cert->VerifyNameMatch("www.webkit.org"));
+  }
+  base::TimeDelta chain_time = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    scoped_refptr<X509Certificate> cert = X509Certificate::CreateFromBytes(
+        reinterpret_cast<const char*>(google_der), sizeof(google_der));
+    ASSERT_TRUE(cert);
+    EXPECT_TRUE(cert->VerifyNameMatch("www.google.com"));
+  }
+  base::TimeDelta bytes_time = base::TimeTicks::Now() - start;
+
+  VLOG(1) << "CreateFromDERCertChain + VerifyNameMatch: "
+          << chain_time.InMicroseconds() * 1000 / kIterations << " ns";
+  VLOG(1) << "CreateFromBytes + VerifyNameMatch: "
+          << bytes_time.InMicroseconds() * 1000 / kIterations << " ns";
+}
+
 #if defined(OS_MACOSX) || defined(OS_WIN)
 TEST(X509CertificateTest, IntermediateCertificates) {
   scoped_refptr<X509Certificate> webkit_cert(
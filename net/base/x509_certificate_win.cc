@@ -612,8 +612,8 @@ X509Certificate* X509Certificate::CreateSelfSigned(
   return cert;
 }
 
-void X509Certificate::GetDNSNames(std::vector<std::string>* dns_names) const {
-  dns_names->clear();
+void X509Certificate::ParseDNSNames(
+    std::vector<std::string>* dns_names) const {
   if (cert_handle_) {
     scoped_ptr_malloc<CERT_ALT_NAME_INFO> alt_name_info;
     GetCertSubjectAltName(cert_handle_, &alt_name_info);
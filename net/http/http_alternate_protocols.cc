@@ -42,7 +42,7 @@ std::string HttpAlternateProtocols::PortProtocolPair::ToString() const {
 HttpAlternateProtocols::PortProtocolPair*
     HttpAlternateProtocols::forced_alternate_protocol_ = NULL;
 
-HttpAlternateProtocols::HttpAlternateProtocols() {}
+HttpAlternateProtocols::HttpAlternateProtocols() : delegate_(NULL) {}
 HttpAlternateProtocols::~HttpAlternateProtocols() {}
 
 bool HttpAlternateProtocols::HasAlternateProtocolFor(
@@ -95,6 +95,13 @@ void HttpAlternateProtocols::SetAlternateProtocolFor(
     const PortProtocolPair existing_alternate =
         GetAlternateProtocolFor(http_host_port_pair);
 
+    // Servers repeat the header on every response; only tell the delegate
+    // about news.
+    if (existing_alternate.Equals(alternate) &&
+        ContainsKey(protocol_map_, http_host_port_pair)) {
+      return;
+    }
+
     if (existing_alternate.protocol == BROKEN) {
       DVLOG(1) << "Ignore alternate protocol since it's known to be broken.";
       return;
@@ -112,11 +119,15 @@ void HttpAlternateProtocols::SetAlternateProtocolFor(
   }
 
   protocol_map_[http_host_port_pair] = alternate;
+  if (delegate_)
+    delegate_->OnAlternateProtocolChanged(http_host_port_pair);
 }
 
 void HttpAlternateProtocols::MarkBrokenAlternateProtocolFor(
     const HostPortPair& http_host_port_pair) {
   protocol_map_[http_host_port_pair].protocol = BROKEN;
+  if (delegate_)
+    delegate_->OnAlternateProtocolChanged(http_host_port_pair);
 }
 
 // static
@@ -42,6 +42,16 @@ class HttpAlternateProtocols {
 
   typedef std::map<HostPortPair, PortProtocolPair> ProtocolMap;
 
+  // Told about every change to the protocol map, e.g. so that it can be
+  // persisted.
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    virtual void OnAlternateProtocolChanged(
+        const HostPortPair& http_host_port_pair) = 0;
+  };
+
   static const char kHeader[];
   static const char* const kProtocolStrings[NUM_ALTERNATE_PROTOCOLS];
 
@@ -70,6 +80,9 @@ class HttpAlternateProtocols {
 
   const ProtocolMap& protocol_map() const { return protocol_map_; }
 
+  // |delegate| may be NULL.  It must outlive this object or be cleared.
+  void set_delegate(Delegate* delegate) { delegate_ = delegate; }
+
   // Debugging to simulate presence of an AlternateProtocol.
   // If we don't have an alternate protocol in the map for any given host/port
   // pair, force this ProtocolPortPair.
@@ -78,6 +91,7 @@ class HttpAlternateProtocols {
 
  private:
   ProtocolMap protocol_map_;
+  Delegate* delegate_;
 
   static const char* ProtocolToString(Protocol protocol);
 
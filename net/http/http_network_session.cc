@@ -45,6 +45,12 @@ HttpNetworkSession::HttpNetworkSession(const Params& params)
           new HttpStreamFactoryImpl(this))) {
   DCHECK(params.proxy_service);
   DCHECK(params.ssl_config_service);
+  if (params.http_server_properties_store) {
+    http_server_properties_.reset(new HttpServerProperties(
+        params.http_server_properties_store,
+        &alternate_protocols_,
+        spdy_session_pool_.mutable_spdy_settings()));
+  }
 }
 
 HttpNetworkSession::~HttpNetworkSession() {
@@ -8,12 +8,14 @@
 
 #include <set>
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/threading/non_thread_safe.h"
 #include "net/base/host_port_pair.h"
 #include "net/base/host_resolver.h"
 #include "net/base/ssl_client_auth_cache.h"
 #include "net/http/http_alternate_protocols.h"
 #include "net/http/http_auth_cache.h"
+#include "net/http/http_server_properties.h"
 #include "net/http/http_stream_factory.h"
 #include "net/socket/client_socket_pool_manager.h"
 #include "net/spdy/spdy_session_pool.h"
@@ -54,6 +56,7 @@ class HttpNetworkSession : public base::RefCounted<HttpNetworkSession>,
           ssl_config_service(NULL),
           http_auth_handler_factory(NULL),
           network_delegate(NULL),
+          http_server_properties_store(NULL),
           net_log(NULL) {}
 
     ClientSocketFactory* client_socket_factory;
@@ -66,6 +69,8 @@ class HttpNetworkSession : public base::RefCounted<HttpNetworkSession>,
     SSLConfigService* ssl_config_service;
     HttpAuthHandlerFactory* http_auth_handler_factory;
     NetworkDelegate* network_delegate;
+    // If set, alternate protocols and SPDY settings are persisted here.
+    HttpServerProperties::PersistentStore* http_server_properties_store;
     NetLog* net_log;
   };
 
@@ -171,6 +176,9 @@ class HttpNetworkSession : public base::RefCounted<HttpNetworkSession>,
   ClientSocketPoolManager socket_pool_manager_;
   SpdySessionPool spdy_session_pool_;
   scoped_ptr<HttpStreamFactory> http_stream_factory_;
+  // Must come after |alternate_protocols_| and |spdy_session_pool_|, which it
+  // watches.
+  scoped_ptr<HttpServerProperties> http_server_properties_;
   std::set<HttpResponseBodyDrainer*> response_drainers_;
 };
 
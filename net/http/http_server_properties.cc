@@ -0,0 +1,181 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_server_properties.h"
+
+#include "base/compiler_specific.h"
+#include "base/logging.h"
+#include "base/stl_util-inl.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+// static
+const size_t HttpServerProperties::kMaxEntries = 200;
+
+HttpServerProperties::Data::Data() {}
+
+HttpServerProperties::Data::~Data() {}
+
+HttpServerProperties::RecentHosts::RecentHosts() {}
+
+HttpServerProperties::RecentHosts::~RecentHosts() {}
+
+void HttpServerProperties::RecentHosts::Touch(const HostPortPair& host) {
+  IndexMap::iterator it = index_.find(host);
+  if (it != index_.end()) {
+    hosts_.splice(hosts_.begin(), hosts_, it->second);
+    return;
+  }
+
+  hosts_.push_front(host);
+  index_[host] = hosts_.begin();
+  if (hosts_.size() > kMaxEntries) {
+    index_.erase(hosts_.back());
+    hosts_.pop_back();
+  }
+}
+
+void HttpServerProperties::RecentHosts::AddOldest(const HostPortPair& host) {
+  if (hosts_.size() >= kMaxEntries || ContainsKey(index_, host))
+    return;
+  hosts_.push_back(host);
+  index_[host] = --hosts_.end();
+}
+
+HttpServerProperties::HttpServerProperties(
+    PersistentStore* store,
+    HttpAlternateProtocols* alternate_protocols,
+    SpdySettingsStorage* spdy_settings)
+    : store_(store),
+      alternate_protocols_(alternate_protocols),
+      spdy_settings_(spdy_settings),
+      load_pending_(false),
+      changed_while_loading_(false),
+      merging_(false),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          load_callback_(this, &HttpServerProperties::OnLoadComplete)) {
+  DCHECK(store_);
+  alternate_protocols_->set_delegate(this);
+  spdy_settings_->set_delegate(this);
+
+  int rv = store_->Load(&loaded_data_, &load_callback_);
+  if (rv == ERR_IO_PENDING) {
+    load_pending_ = true;
+    return;
+  }
+  if (rv == OK)
+    MergeLoadedData();
+}
+
+HttpServerProperties::~HttpServerProperties() {
+  if (load_pending_)
+    store_->CancelLoad();
+  alternate_protocols_->set_delegate(NULL);
+  spdy_settings_->set_delegate(NULL);
+}
+
+void HttpServerProperties::OnAlternateProtocolChanged(
+    const HostPortPair& http_host_port_pair) {
+  OnChanged(&recent_alternate_protocols_, http_host_port_pair);
+}
+
+void HttpServerProperties::OnSpdySettingsChanged(
+    const HostPortPair& host_port_pair) {
+  OnChanged(&recent_spdy_settings_, host_port_pair);
+}
+
+void HttpServerProperties::OnLoadComplete(int result) {
+  DCHECK(load_pending_);
+  load_pending_ = false;
+  if (result == OK)
+    MergeLoadedData();
+  if (changed_while_loading_) {
+    changed_while_loading_ = false;
+    Save();
+  }
+}
+
+void HttpServerProperties::MergeLoadedData() {
+  merging_ = true;
+
+  const HttpAlternateProtocols::ProtocolMap& protocol_map =
+      alternate_protocols_->protocol_map();
+  for (size_t i = 0; i < loaded_data_.alternate_protocols.size(); ++i) {
+    const AlternateProtocolEntry& entry = loaded_data_.alternate_protocols[i];
+    // Don't trust the store with anything the network stack can't use.
+    HttpAlternateProtocols::Protocol protocol = entry.second.protocol;
+    if (protocol < HttpAlternateProtocols::NPN_SPDY_1 ||
+        protocol >= HttpAlternateProtocols::NUM_ALTERNATE_PROTOCOLS)
+      continue;
+    if (ContainsKey(protocol_map, entry.first))
+      continue;
+    alternate_protocols_->SetAlternateProtocolFor(
+        entry.first, entry.second.port, protocol);
+    recent_alternate_protocols_.AddOldest(entry.first);
+  }
+
+  for (size_t i = 0; i < loaded_data_.spdy_settings.size(); ++i) {
+    const SpdySettingsEntry& entry = loaded_data_.spdy_settings[i];
+    if (!spdy_settings_->Get(entry.first).empty())
+      continue;
+    // SpdySettingsStorage only keeps the settings the server asked to have
+    // persisted, so ask again on behalf of the stored ones.
+    spdy::SpdySettings settings;
+    for (spdy::SpdySettings::const_iterator it = entry.second.begin();
+         it != entry.second.end(); ++it) {
+      spdy::SettingsFlagsAndId id = it->first;
+      id.set_flags(spdy::SETTINGS_FLAG_PLEASE_PERSIST);
+      settings.push_back(std::make_pair(id, it->second));
+    }
+    spdy_settings_->Set(entry.first, settings);
+    recent_spdy_settings_.AddOldest(entry.first);
+  }
+
+  loaded_data_ = Data();
+  merging_ = false;
+}
+
+void HttpServerProperties::OnChanged(RecentHosts* recent,
+                                     const HostPortPair& host) {
+  if (merging_)
+    return;
+  recent->Touch(host);
+  if (load_pending_) {
+    changed_while_loading_ = true;
+    return;
+  }
+  Save();
+}
+
+void HttpServerProperties::Save() {
+  Data data;
+
+  const HttpAlternateProtocols::ProtocolMap& protocol_map =
+      alternate_protocols_->protocol_map();
+  const std::list<HostPortPair>& alternate_hosts =
+      recent_alternate_protocols_.hosts();
+  for (std::list<HostPortPair>::const_iterator it = alternate_hosts.begin();
+       it != alternate_hosts.end(); ++it) {
+    HttpAlternateProtocols::ProtocolMap::const_iterator entry =
+        protocol_map.find(*it);
+    // A broken alternate protocol is given another chance after a restart.
+    if (entry == protocol_map.end() ||
+        entry->second.protocol == HttpAlternateProtocols::BROKEN)
+      continue;
+    data.alternate_protocols.push_back(*entry);
+  }
+
+  const std::list<HostPortPair>& spdy_hosts = recent_spdy_settings_.hosts();
+  for (std::list<HostPortPair>::const_iterator it = spdy_hosts.begin();
+       it != spdy_hosts.end(); ++it) {
+    const spdy::SpdySettings& settings = spdy_settings_->Get(*it);
+    if (!settings.empty())
+      data.spdy_settings.push_back(std::make_pair(*it, settings));
+  }
+
+  store_->Save(data);
+}
+
+}  // namespace net
@@ -0,0 +1,148 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_HTTP_HTTP_SERVER_PROPERTIES_H_
+#define NET_HTTP_HTTP_SERVER_PROPERTIES_H_
+#pragma once
+
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/completion_callback.h"
+#include "net/base/host_port_pair.h"
+#include "net/http/http_alternate_protocols.h"
+#include "net/spdy/spdy_framer.h"
+#include "net/spdy/spdy_settings_storage.h"
+
+namespace net {
+
+// HttpServerProperties keeps what the network stack learns about servers that
+// is worth remembering across restarts: the alternate protocols they advertise
+// and the SPDY settings they ask us to persist.  It watches an
+// HttpAlternateProtocols and a SpdySettingsStorage, and hands the kMaxEntries
+// most recently changed entries of each to a PersistentStore.
+//
+// The stored properties are loaded asynchronously when the object is created.
+// Until the load completes the in-memory tables only hold what has been
+// learned from the network, which takes precedence over the stored values.
+class HttpServerProperties : public HttpAlternateProtocols::Delegate,
+                             public SpdySettingsStorage::Delegate {
+ public:
+  typedef std::pair<HostPortPair, HttpAlternateProtocols::PortProtocolPair>
+      AlternateProtocolEntry;
+  typedef std::pair<HostPortPair, spdy::SpdySettings> SpdySettingsEntry;
+
+  // The persisted properties, most recently changed first.
+  struct Data {
+    Data();
+    ~Data();
+
+    std::vector<AlternateProtocolEntry> alternate_protocols;
+    std::vector<SpdySettingsEntry> spdy_settings;
+  };
+
+  // Keeps the properties between runs, e.g. in a file in the profile.
+  class PersistentStore {
+   public:
+    virtual ~PersistentStore() {}
+
+    // Reads the stored properties into |data|.  Returns OK if they were read
+    // synchronously, or ERR_IO_PENDING and runs |callback| once |data| has
+    // been filled in.  Any other result means there is nothing to load.
+    // |data| and |callback| must remain valid until |callback| is run or
+    // CancelLoad() is called.
+    virtual int Load(Data* data, CompletionCallback* callback) = 0;
+
+    // Cancels a pending Load().
+    virtual void CancelLoad() = 0;
+
+    // Replaces the stored properties with |data|.  This is called on every
+    // change, so the store is expected to batch its writes.
+    virtual void Save(const Data& data) = 0;
+  };
+
+  // The number of entries of each kind that are persisted.
+  static const size_t kMaxEntries;
+
+  // |store|, |alternate_protocols| and |spdy_settings| must outlive this
+  // object, which registers itself as the delegate of the latter two.
+  HttpServerProperties(PersistentStore* store,
+                       HttpAlternateProtocols* alternate_protocols,
+                       SpdySettingsStorage* spdy_settings);
+  virtual ~HttpServerProperties();
+
+  // Whether the stored properties have been merged in yet.
+  bool loaded() const { return !load_pending_; }
+
+  // HttpAlternateProtocols::Delegate methods:
+  virtual void OnAlternateProtocolChanged(
+      const HostPortPair& http_host_port_pair);
+
+  // SpdySettingsStorage::Delegate methods:
+  virtual void OnSpdySettingsChanged(const HostPortPair& host_port_pair);
+
+ private:
+  // Hosts in the order they were last changed, most recent first, holding at
+  // most kMaxEntries.
+  class RecentHosts {
+   public:
+    RecentHosts();
+    ~RecentHosts();
+
+    // Moves |host| to the front.
+    void Touch(const HostPortPair& host);
+
+    // Adds |host| at the back, unless it is already present or the list is
+    // full.
+    void AddOldest(const HostPortPair& host);
+
+    const std::list<HostPortPair>& hosts() const { return hosts_; }
+
+   private:
+    typedef std::map<HostPortPair, std::list<HostPortPair>::iterator> IndexMap;
+
+    std::list<HostPortPair> hosts_;
+    IndexMap index_;
+
+    DISALLOW_COPY_AND_ASSIGN(RecentHosts);
+  };
+
+  void OnLoadComplete(int result);
+
+  // Merges the loaded properties into the in-memory tables.
+  void MergeLoadedData();
+
+  // Records a change to |host| in |recent| and passes it on to the store.
+  void OnChanged(RecentHosts* recent, const HostPortPair& host);
+
+  void Save();
+
+  PersistentStore* const store_;
+  HttpAlternateProtocols* const alternate_protocols_;
+  SpdySettingsStorage* const spdy_settings_;
+
+  RecentHosts recent_alternate_protocols_;
+  RecentHosts recent_spdy_settings_;
+
+  // Filled in by the store.  Nothing is saved while a load is pending, since
+  // it would overwrite the stored properties with the few learned so far.
+  Data loaded_data_;
+  bool load_pending_;
+  bool changed_while_loading_;
+
+  // Set while the loaded properties are merged in, so that doing so does not
+  // count as a change.
+  bool merging_;
+
+  CompletionCallbackImpl<HttpServerProperties> load_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpServerProperties);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_HTTP_SERVER_PROPERTIES_H_
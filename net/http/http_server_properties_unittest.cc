@@ -0,0 +1,255 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_server_properties.h"
+
+#include "base/memory/scoped_ptr.h"
+#include "base/stringprintf.h"
+#include "net/base/cert_verifier.h"
+#include "net/base/mock_host_resolver.h"
+#include "net/base/net_errors.h"
+#include "net/base/ssl_config_service_defaults.h"
+#include "net/http/http_network_session.h"
+#include "net/proxy/proxy_service.h"
+#include "net/socket/socket_test_util.h"
+#include "net/spdy/spdy_session_pool.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// Keeps the properties in memory, across "restarts".  Loads complete when the
+// test says so.
+class MockPersistentStore : public HttpServerProperties::PersistentStore {
+ public:
+  MockPersistentStore()
+      : async_(true),
+        load_data_(NULL),
+        load_callback_(NULL),
+        save_count_(0),
+        cancel_count_(0) {}
+
+  virtual int Load(HttpServerProperties::Data* data,
+                   CompletionCallback* callback) {
+    if (!async_) {
+      *data = stored_;
+      return OK;
+    }
+    load_data_ = data;
+    load_callback_ = callback;
+    return ERR_IO_PENDING;
+  }
+
+  virtual void CancelLoad() {
+    load_data_ = NULL;
+    load_callback_ = NULL;
+    ++cancel_count_;
+  }
+
+  virtual void Save(const HttpServerProperties::Data& data) {
+    stored_ = data;
+    ++save_count_;
+  }
+
+  void CompleteLoad() {
+    ASSERT_TRUE(load_callback_);
+    *load_data_ = stored_;
+    CompletionCallback* callback = load_callback_;
+    load_data_ = NULL;
+    load_callback_ = NULL;
+    callback->Run(OK);
+  }
+
+  void set_async(bool async) { async_ = async; }
+  const HttpServerProperties::Data& stored() const { return stored_; }
+  int save_count() const { return save_count_; }
+  int cancel_count() const { return cancel_count_; }
+
+ private:
+  bool async_;
+  HttpServerProperties::Data stored_;
+  HttpServerProperties::Data* load_data_;
+  CompletionCallback* load_callback_;
+  int save_count_;
+  int cancel_count_;
+};
+
+// One run of the browser: the in-memory tables and what watches them.
+struct Generation {
+  explicit Generation(MockPersistentStore* store)
+      : properties(store, &alternate_protocols, &spdy_settings) {}
+
+  HttpAlternateProtocols alternate_protocols;
+  SpdySettingsStorage spdy_settings;
+  HttpServerProperties properties;
+};
+
+spdy::SpdySettings MakeSettings(uint32 id, uint32 value) {
+  spdy::SettingsFlagsAndId flags_and_id(0);
+  flags_and_id.set_id(id);
+  flags_and_id.set_flags(spdy::SETTINGS_FLAG_PLEASE_PERSIST);
+  spdy::SpdySettings settings;
+  settings.push_back(std::make_pair(flags_and_id, value));
+  return settings;
+}
+
+TEST(HttpServerPropertiesTest, AlternateProtocolSurvivesRestart) {
+  MockPersistentStore store;
+  const HostPortPair host("foo", 80);
+  {
+    Generation first(&store);
+    store.CompleteLoad();
+    first.alternate_protocols.SetAlternateProtocolFor(
+        host, 443, HttpAlternateProtocols::NPN_SPDY_2);
+  }
+  ASSERT_EQ(1u, store.stored().alternate_protocols.size());
+
+  Generation second(&store);
+  EXPECT_FALSE(second.properties.loaded());
+  EXPECT_FALSE(second.alternate_protocols.HasAlternateProtocolFor(host));
+
+  store.CompleteLoad();
+  EXPECT_TRUE(second.properties.loaded());
+  ASSERT_TRUE(second.alternate_protocols.HasAlternateProtocolFor(host));
+  HttpAlternateProtocols::PortProtocolPair alternate =
+      second.alternate_protocols.GetAlternateProtocolFor(host);
+  EXPECT_EQ(443, alternate.port);
+  EXPECT_EQ(HttpAlternateProtocols::NPN_SPDY_2, alternate.protocol);
+}
+
+TEST(HttpServerPropertiesTest, SpdySettingsSurviveRestart) {
+  MockPersistentStore store;
+  store.set_async(false);
+  const HostPortPair host("foo", 443);
+  {
+    Generation first(&store);
+    first.spdy_settings.Set(host, MakeSettings(7, 100));
+  }
+
+  Generation second(&store);
+  const spdy::SpdySettings& settings = second.spdy_settings.Get(host);
+  ASSERT_EQ(1u, settings.size());
+  EXPECT_EQ(7u, settings.front().first.id());
+  EXPECT_EQ(spdy::SETTINGS_FLAG_PERSISTED, settings.front().first.flags());
+  EXPECT_EQ(100u, settings.front().second);
+}
+
+TEST(HttpServerPropertiesTest, LearnedWhileLoadingWins) {
+  MockPersistentStore store;
+  store.set_async(false);
+  const HostPortPair host("foo", 80);
+  {
+    Generation first(&store);
+    first.alternate_protocols.SetAlternateProtocolFor(
+        host, 443, HttpAlternateProtocols::NPN_SPDY_2);
+  }
+  int save_count = store.save_count();
+
+  store.set_async(true);
+  Generation second(&store);
+  second.alternate_protocols.SetAlternateProtocolFor(
+      host, 444, HttpAlternateProtocols::NPN_SPDY_1);
+  // Saving now would lose whatever is still being loaded.
+  EXPECT_EQ(save_count, store.save_count());
+
+  store.CompleteLoad();
+  EXPECT_EQ(444, second.alternate_protocols.GetAlternateProtocolFor(host).port);
+  EXPECT_EQ(save_count + 1, store.save_count());
+  ASSERT_EQ(1u, store.stored().alternate_protocols.size());
+  EXPECT_EQ(444, store.stored().alternate_protocols[0].second.port);
+}
+
+TEST(HttpServerPropertiesTest, KeepsMostRecentEntries) {
+  MockPersistentStore store;
+  store.set_async(false);
+  const size_t kCount = HttpServerProperties::kMaxEntries + 10;
+  {
+    Generation first(&store);
+    for (size_t i = 0; i < kCount; ++i) {
+      first.alternate_protocols.SetAlternateProtocolFor(
+          HostPortPair(base::StringPrintf("host%d", static_cast<int>(i)), 80),
+          443, HttpAlternateProtocols::NPN_SPDY_2);
+    }
+    // Hearing from the oldest remaining host again makes it the newest.
+    first.alternate_protocols.SetAlternateProtocolFor(
+        HostPortPair("host10", 80), 444, HttpAlternateProtocols::NPN_SPDY_2);
+  }
+
+  const std::vector<HttpServerProperties::AlternateProtocolEntry>& stored =
+      store.stored().alternate_protocols;
+  ASSERT_EQ(HttpServerProperties::kMaxEntries, stored.size());
+  EXPECT_EQ("host10", stored.front().first.host());
+  EXPECT_EQ(base::StringPrintf("host%d", static_cast<int>(kCount - 1)),
+            stored[1].first.host());
+  EXPECT_EQ("host11", stored.back().first.host());
+
+  Generation second(&store);
+  EXPECT_FALSE(second.alternate_protocols.HasAlternateProtocolFor(
+      HostPortPair("host9", 80)));
+  EXPECT_TRUE(second.alternate_protocols.HasAlternateProtocolFor(
+      HostPortPair("host11", 80)));
+}
+
+TEST(HttpServerPropertiesTest, BrokenIsNotPersisted) {
+  MockPersistentStore store;
+  store.set_async(false);
+  const HostPortPair host("foo", 80);
+  {
+    Generation first(&store);
+    first.alternate_protocols.SetAlternateProtocolFor(
+        host, 443, HttpAlternateProtocols::NPN_SPDY_2);
+    first.alternate_protocols.MarkBrokenAlternateProtocolFor(host);
+  }
+  EXPECT_TRUE(store.stored().alternate_protocols.empty());
+}
+
+TEST(HttpServerPropertiesTest, DestroyWhileLoading) {
+  MockPersistentStore store;
+  {
+    Generation first(&store);
+  }
+  EXPECT_EQ(1, store.cancel_count());
+  EXPECT_EQ(0, store.save_count());
+}
+
+// The first request after a restart should find what the previous session
+// learned, without having to hear from the server again.
+TEST(HttpServerPropertiesTest, HttpNetworkSessionRestart) {
+  MockPersistentStore store;
+  MockHostResolver host_resolver;
+  CertVerifier cert_verifier;
+  scoped_refptr<ProxyService> proxy_service(ProxyService::CreateDirect());
+  scoped_refptr<SSLConfigService> ssl_config_service(
+      new SSLConfigServiceDefaults);
+  MockClientSocketFactory socket_factory;
+
+  HttpNetworkSession::Params params;
+  params.host_resolver = &host_resolver;
+  params.cert_verifier = &cert_verifier;
+  params.proxy_service = proxy_service;
+  params.ssl_config_service = ssl_config_service;
+  params.client_socket_factory = &socket_factory;
+  params.http_server_properties_store = &store;
+
+  const HostPortPair host("www.google.com", 80);
+  {
+    scoped_refptr<HttpNetworkSession> session(new HttpNetworkSession(params));
+    store.CompleteLoad();
+    session->mutable_alternate_protocols()->SetAlternateProtocolFor(
+        host, 443, HttpAlternateProtocols::NPN_SPDY_2);
+    session->spdy_session_pool()->mutable_spdy_settings()->Set(
+        host, MakeSettings(4, 10));
+  }
+
+  scoped_refptr<HttpNetworkSession> session(new HttpNetworkSession(params));
+  store.CompleteLoad();
+  EXPECT_TRUE(session->alternate_protocols().HasAlternateProtocolFor(host));
+  EXPECT_EQ(1u,
+            session->spdy_session_pool()->spdy_settings().Get(host).size());
+}
+
+}  // namespace
+
+}  // namespace net
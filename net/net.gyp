@@ -520,6 +520,8 @@
         'http/http_response_headers.h',
         'http/http_response_info.cc',
         'http/http_response_info.h',
+        'http/http_server_properties.cc',
+        'http/http_server_properties.h',
         'http/http_stream.h',
         'http/http_stream_factory.cc',
         'http/http_stream_factory.h',
@@ -973,6 +975,7 @@
         'http/http_request_headers_unittest.cc',
         'http/http_response_body_drainer_unittest.cc',
         'http/http_response_headers_unittest.cc',
+        'http/http_server_properties_unittest.cc',
         'http/http_stream_factory_impl_unittest.cc',
         'http/http_transaction_unittest.cc',
         'http/http_transaction_unittest.h',
@@ -8,7 +8,7 @@
 
 namespace net {
 
-SpdySettingsStorage::SpdySettingsStorage() {
+SpdySettingsStorage::SpdySettingsStorage() : delegate_(NULL) {
 }
 
 SpdySettingsStorage::~SpdySettingsStorage() {
@@ -44,6 +44,8 @@ void SpdySettingsStorage::Set(const HostPortPair& host_port_pair,
     return;
 
   settings_map_[host_port_pair] = persistent_settings;
+  if (delegate_)
+    delegate_->OnSpdySettingsChanged(host_port_pair);
 }
 
 }  // namespace net
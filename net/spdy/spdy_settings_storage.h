@@ -17,6 +17,15 @@ namespace net {
 // endpoints for the SPDY SETTINGS frame.
 class SpdySettingsStorage {
  public:
+  // Told whenever the settings stored for a host change, e.g. so that they
+  // can be persisted.
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    virtual void OnSpdySettingsChanged(const HostPortPair& host_port_pair) = 0;
+  };
+
   SpdySettingsStorage();
   ~SpdySettingsStorage();
 
@@ -28,10 +37,14 @@ class SpdySettingsStorage {
   void Set(const HostPortPair& host_port_pair,
            const spdy::SpdySettings& settings);
 
+  // |delegate| may be NULL.  It must outlive this object or be cleared.
+  void set_delegate(Delegate* delegate) { delegate_ = delegate; }
+
  private:
   typedef std::map<HostPortPair, spdy::SpdySettings> SettingsMap;
 
   SettingsMap settings_map_;
+  Delegate* delegate_;
 
   DISALLOW_COPY_AND_ASSIGN(SpdySettingsStorage);
 };
@@ -38,18 +38,35 @@ namespace talk_base {
 
 static const int DEFAULT_SIZE = 4096;
 
+struct ByteBuffer::Storage {
+  explicit Storage(size_t size)
+      : ref_count(1), used(0), bytes(new char[size]) {
+  }
+  ~Storage() {
+    delete[] bytes;
+  }
+
+  int ref_count;
+  // The end of the bytes written by any of the buffers sharing this storage.
+  size_t used;
+  char* bytes;
+};
+
 ByteBuffer::ByteBuffer() {
   start_ = 0;
   end_   = 0;
   size_  = DEFAULT_SIZE;
-  bytes_ = new char[size_];
+  storage_ = new Storage(size_);
+  bytes_ = storage_->bytes;
 }
 
 ByteBuffer::ByteBuffer(const char* bytes, size_t len) {
   start_ = 0;
   end_   = len;
   size_  = len;
-  bytes_ = new char[size_];
+  storage_ = new Storage(size_);
+  storage_->used = end_;
+  bytes_ = storage_->bytes;
   memcpy(bytes_, bytes, end_);
 }
 
@@ -57,12 +74,26 @@ ByteBuffer::ByteBuffer(const char* bytes) {
   start_ = 0;
   end_   = strlen(bytes);
   size_  = end_;
-  bytes_ = new char[size_];
+  storage_ = new Storage(size_);
+  storage_->used = end_;
+  bytes_ = storage_->bytes;
   memcpy(bytes_, bytes, end_);
 }
 
 ByteBuffer::~ByteBuffer() {
-  delete[] bytes_;
+  Release();
+}
+
+void ByteBuffer::Release() {
+  if (--storage_->ref_count == 0)
+    delete storage_;
+  storage_ = NULL;
+  bytes_ = NULL;
+}
+
+bool ByteBuffer::CanAppend() const {
+  // Another buffer may have written past our end, but never before it.
+  return storage_->ref_count == 1 || storage_->used == end_;
 }
 
 bool ByteBuffer::ReadUInt8(uint8* val) {
@@ -141,6 +172,21 @@ bool ByteBuffer::ReadBytes(char* val, size_t len) {
   }
 }
 
+bool ByteBuffer::ReadSlice(ByteBuffer* slice, size_t len) {
+  if (!slice || slice == this || len > Length())
+    return false;
+
+  ++storage_->ref_count;
+  slice->Release();
+  slice->storage_ = storage_;
+  slice->bytes_ = bytes_;
+  slice->size_ = size_;
+  slice->start_ = start_;
+  slice->end_ = start_ + len;
+  start_ += len;
+  return true;
+}
+
 void ByteBuffer::WriteUInt8(uint8 val) {
   WriteBytes(reinterpret_cast<const char*>(&val), 1);
 }
@@ -170,11 +216,12 @@ void ByteBuffer::WriteString(const std::string& val) {
 }
 
 void ByteBuffer::WriteBytes(const char* val, size_t len) {
-  if (Length() + len > Capacity())
+  if (Length() + len > Capacity() || !CanAppend())
     Resize(Length() + len);
 
   memcpy(bytes_ + end_, val, len);
   end_ += len;
+  storage_->used = end_;
 }
 
 void ByteBuffer::Resize(size_t size) {
@@ -182,14 +229,16 @@ void ByteBuffer::Resize(size_t size) {
     size = _max(size, 3 * size_ / 2);
 
   size_t len = _min(end_ - start_, size);
-  char* new_bytes = new char[size];
-  memcpy(new_bytes, bytes_ + start_, len);
-  delete [] bytes_;
+  Storage* storage = new Storage(size);
+  memcpy(storage->bytes, bytes_ + start_, len);
+  Release();
 
   start_ = 0;
   end_   = len;
   size_  = size;
-  bytes_ = new_bytes;
+  storage_ = storage;
+  storage_->used = end_;
+  bytes_ = storage_->bytes;
 }
 
 void ByteBuffer::Consume(size_t size) {
@@ -203,9 +252,17 @@ void ByteBuffer::Shift(size_t size) {
   if (size > Length())
     return;
 
+  if (storage_->ref_count > 1) {
+    // Moving the bytes would disturb the other buffers.
+    start_ += size;
+    Resize(size_);
+    return;
+  }
+
   end_ = Length() - size;
   memmove(bytes_, bytes_ + start_ + size, end_);
   start_ = 0;
+  storage_->used = end_;
 }
 
 }  // namespace talk_base
@@ -35,6 +35,11 @@
 
 namespace talk_base {
 
+// A buffer for reading and writing bytes in network order.  The storage is
+// reference counted, so that ReadSlice() can hand out part of the buffer
+// without copying it; a buffer copies its storage only when a change would
+// disturb another buffer sharing it.  Buffers sharing storage must be used on
+// the same thread.
 class ByteBuffer {
  public:
   ByteBuffer();
@@ -53,6 +58,8 @@ class ByteBuffer {
   bool ReadUInt64(uint64* val);
   bool ReadString(std::string* val, size_t len);  // append to val
   bool ReadBytes(char* val, size_t len);
+  // Makes |slice| refer to the next |len| bytes, without copying them.
+  bool ReadSlice(ByteBuffer* slice, size_t len);
 
   void WriteUInt8(uint8 val);
   void WriteUInt16(uint16 val);
@@ -67,6 +74,14 @@ class ByteBuffer {
   void Shift(size_t size);
 
  private:
+  struct Storage;
+
+  // Drops this buffer's reference to |storage_|.
+  void Release();
+  // Whether bytes can be written in place after |end_|.
+  bool CanAppend() const;
+
+  Storage* storage_;
   char* bytes_;
   size_t size_;
   size_t start_;
@@ -40,6 +40,11 @@
 #include <signal.h>
 #endif
 
+#ifdef LINUX
+#include <poll.h>
+#include <sys/epoll.h>
+#endif
+
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -139,7 +144,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     udp_ = (SOCK_DGRAM == type);
     UpdateLastError();
     if (udp_)
-      enabled_events_ = DE_READ | DE_WRITE;
+      SetEnabledEvents(DE_READ | DE_WRITE);
     return s_ != INVALID_SOCKET;
   }
 
@@ -219,12 +224,12 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       state_ = CS_CONNECTED;
     } else if (IsBlockingError(error_)) {
       state_ = CS_CONNECTING;
-      enabled_events_ |= DE_CONNECT;
+      EnableEvents(DE_CONNECT);
     } else {
       return SOCKET_ERROR;
     }
 
-    enabled_events_ |= DE_READ | DE_WRITE;
+    EnableEvents(DE_READ | DE_WRITE);
     return 0;
   }
 
@@ -285,7 +290,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     // We have seen minidumps where this may be false.
     ASSERT(sent <= static_cast<int>(cb));
     if ((sent < 0) && IsBlockingError(error_)) {
-      enabled_events_ |= DE_WRITE;
+      EnableEvents(DE_WRITE);
     }
     return sent;
   }
@@ -306,7 +311,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     // We have seen minidumps where this may be false.
     ASSERT(sent <= static_cast<int>(cb));
     if ((sent < 0) && IsBlockingError(error_)) {
-      enabled_events_ |= DE_WRITE;
+      EnableEvents(DE_WRITE);
     }
     return sent;
   }
@@ -320,14 +325,14 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       LOG(LS_WARNING) << "EOF from socket; deferring close event";
       // Must turn this back on so that the select() loop will notice the close
       // event.
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
       error_ = EWOULDBLOCK;
       return SOCKET_ERROR;
     }
     UpdateLastError();
     bool success = (received >= 0) || IsBlockingError(error_);
     if (udp_ || success) {
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
     }
     if (!success) {
       LOG_F(LS_VERBOSE) << "Error = " << error_;
@@ -345,7 +350,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
       paddr->FromSockAddr(saddr);
     bool success = (received >= 0) || IsBlockingError(error_);
     if (udp_ || success) {
-      enabled_events_ |= DE_READ;
+      EnableEvents(DE_READ);
     }
     if (!success) {
       LOG_F(LS_VERBOSE) << "Error = " << error_;
@@ -358,7 +363,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     UpdateLastError();
     if (err == 0) {
       state_ = CS_CONNECTING;
-      enabled_events_ |= DE_ACCEPT;
+      EnableEvents(DE_ACCEPT);
 #ifdef _DEBUG
       dbg_addr_ = "Listening @ ";
       dbg_addr_.append(GetLocalAddress().ToString());
@@ -374,7 +379,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     UpdateLastError();
     if (s == INVALID_SOCKET)
       return NULL;
-    enabled_events_ |= DE_ACCEPT;
+    EnableEvents(DE_ACCEPT);
     if (paddr != NULL)
       paddr->FromSockAddr(saddr);
     return ss_->WrapSocket(s);
@@ -387,7 +392,7 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     UpdateLastError();
     s_ = INVALID_SOCKET;
     state_ = CS_CLOSED;
-    enabled_events_ = 0;
+    SetEnabledEvents(0);
     if (resolver_) {
       resolver_->Destroy(false);
       resolver_ = NULL;
@@ -472,6 +477,18 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     error_ = LAST_SYSTEM_ERROR;
   }
 
+  void EnableEvents(uint8 events) {
+    SetEnabledEvents(enabled_events_ | events);
+  }
+
+  void DisableEvents(uint8 events) {
+    SetEnabledEvents(enabled_events_ & ~events);
+  }
+
+  virtual void SetEnabledEvents(uint8 events) {
+    enabled_events_ = events;
+  }
+
   static int TranslateOption(Option opt, int* slevel, int* sopt) {
     switch (opt) {
       case OPT_DONTFRAGMENT:
@@ -836,6 +853,13 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
     return enabled_events_;
   }
 
+  virtual void SetEnabledEvents(uint8 events) {
+    if (events == enabled_events_)
+      return;
+    enabled_events_ = events;
+    ss_->Update(this);
+  }
+
   virtual void OnPreEvent(uint32 ff) {
     if ((ff & DE_CONNECT) != 0)
       state_ = CS_CONNECTED;
@@ -845,24 +869,24 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
 
   virtual void OnEvent(uint32 ff, int err) {
     if ((ff & DE_READ) != 0) {
-      enabled_events_ &= ~DE_READ;
+      DisableEvents(DE_READ);
       SignalReadEvent(this);
     }
     if ((ff & DE_WRITE) != 0) {
-      enabled_events_ &= ~DE_WRITE;
+      DisableEvents(DE_WRITE);
       SignalWriteEvent(this);
     }
     if ((ff & DE_CONNECT) != 0) {
-      enabled_events_ &= ~DE_CONNECT;
+      DisableEvents(DE_CONNECT);
       SignalConnectEvent(this);
     }
     if ((ff & DE_ACCEPT) != 0) {
-      enabled_events_ &= ~DE_ACCEPT;
+      DisableEvents(DE_ACCEPT);
       SignalReadEvent(this);
     }
     if ((ff & DE_CLOSE) != 0) {
       // The socket is now dead to us, so stop checking it.
-      enabled_events_ = 0;
+      SetEnabledEvents(0);
       SignalCloseEvent(this, err);
     }
   }
@@ -878,7 +902,8 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
 
 class FileDispatcher: public Dispatcher, public AsyncFile {
  public:
-  FileDispatcher(int fd, PhysicalSocketServer *ss) : ss_(ss), fd_(fd) {
+  FileDispatcher(int fd, PhysicalSocketServer *ss)
+      : ss_(ss), fd_(fd), flags_(0) {
     set_readable(true);
 
     ss_->Add(this);
@@ -922,6 +947,7 @@ class FileDispatcher: public Dispatcher, public AsyncFile {
 
   virtual void set_readable(bool value) {
     flags_ = value ? (flags_ | DE_READ) : (flags_ & ~DE_READ);
+    ss_->Update(this);
   }
 
   virtual bool writable() {
@@ -930,6 +956,7 @@ class FileDispatcher: public Dispatcher, public AsyncFile {
 
   virtual void set_writable(bool value) {
     flags_ = value ? (flags_ | DE_WRITE) : (flags_ & ~DE_WRITE);
+    ss_->Update(this);
   }
 
  private:
@@ -1073,17 +1100,17 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
   virtual void OnEvent(uint32 ff, int err) {
     int cache_id = id_;
     if ((ff & DE_READ) != 0) {
-      enabled_events_ &= ~DE_READ;
+      DisableEvents(DE_READ);
       SignalReadEvent(this);
     }
     if (((ff & DE_WRITE) != 0) && (id_ == cache_id)) {
-      enabled_events_ &= ~DE_WRITE;
+      DisableEvents(DE_WRITE);
       SignalWriteEvent(this);
     }
     if (((ff & DE_CONNECT) != 0) && (id_ == cache_id)) {
       if (ff != DE_CONNECT)
         LOG(LS_VERBOSE) << "Signalled with DE_CONNECT: " << ff;
-      enabled_events_ &= ~DE_CONNECT;
+      DisableEvents(DE_CONNECT);
 #ifdef _DEBUG
       dbg_addr_ = "Connected @ ";
       dbg_addr_.append(GetRemoteAddress().ToString());
@@ -1091,7 +1118,7 @@ class SocketDispatcher : public Dispatcher, public PhysicalSocket {
       SignalConnectEvent(this);
     }
     if (((ff & DE_ACCEPT) != 0) && (id_ == cache_id)) {
-      enabled_events_ &= ~DE_ACCEPT;
+      DisableEvents(DE_ACCEPT);
       SignalReadEvent(this);
     }
     if (((ff & DE_CLOSE) != 0) && (id_ == cache_id)) {
@@ -1144,10 +1171,45 @@ class Signaler : public EventDispatcher {
   bool *pf_;
 };
 
-PhysicalSocketServer::PhysicalSocketServer()
-    : fWait_(false),
-      last_tick_tracked_(0),
-      last_tick_dispatch_count_(0) {
+#ifdef LINUX
+// The most ready descriptors handled by one pass of WaitEpoll().
+static const int kMaxEpollEvents = 128;
+
+static uint32 EventsToEpoll(uint32 events) {
+  uint32 epoll_events = 0;
+  if (events & (DE_READ | DE_ACCEPT))
+    epoll_events |= EPOLLIN;
+  if (events & (DE_WRITE | DE_CONNECT))
+    epoll_events |= EPOLLOUT;
+  return epoll_events;
+}
+#endif
+
+PhysicalSocketServer::PhysicalSocketServer() {
+  Construct(WAIT_SELECT);
+}
+
+PhysicalSocketServer::PhysicalSocketServer(WaitMode mode) {
+  Construct(mode);
+}
+
+void PhysicalSocketServer::Construct(WaitMode mode) {
+  fWait_ = false;
+  last_tick_tracked_ = 0;
+  last_tick_dispatch_count_ = 0;
+#ifdef LINUX
+  epoll_fd_ = -1;
+  if (mode == WAIT_EPOLL) {
+    // The size is only a hint, and ignored by newer kernels.
+    epoll_fd_ = epoll_create(kMaxEpollEvents);
+    if (epoll_fd_ < 0) {
+      LOG_ERR(LS_WARNING) << "epoll_create failed, using select";
+      epoll_fd_ = -1;
+    } else {
+      fcntl(epoll_fd_, F_SETFD, FD_CLOEXEC);
+    }
+  }
+#endif
   signal_wakeup_ = new Signaler(this, &fWait_);
 #ifdef WIN32
   socket_ev_ = WSACreateEvent();
@@ -1163,6 +1225,10 @@ PhysicalSocketServer::~PhysicalSocketServer() {
 #endif
   delete signal_wakeup_;
   ASSERT(dispatchers_.empty());
+#ifdef LINUX
+  if (epoll_fd_ != -1)
+    close(epoll_fd_);
+#endif
 }
 
 void PhysicalSocketServer::WakeUp() {
@@ -1208,6 +1274,12 @@ void PhysicalSocketServer::Add(Dispatcher *pdispatcher) {
   if (pos != dispatchers_.end())
     return;
   dispatchers_.push_back(pdispatcher);
+#ifdef LINUX
+  if (epoll_fd_ != -1) {
+    registered_[pdispatcher] = 0;
+    SyncEpoll(pdispatcher);
+  }
+#endif
 }
 
 void PhysicalSocketServer::Remove(Dispatcher *pdispatcher) {
@@ -1224,10 +1296,118 @@ void PhysicalSocketServer::Remove(Dispatcher *pdispatcher) {
       --**it;
     }
   }
+#ifdef LINUX
+  if (epoll_fd_ != -1) {
+    RegisteredMap::iterator reg = registered_.find(pdispatcher);
+    if (reg != registered_.end()) {
+      if (reg->second != 0) {
+        // The descriptor may already be closed, in which case the kernel has
+        // dropped it by itself.
+        epoll_event event = { 0 };
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, pdispatcher->GetDescriptor(),
+                  &event);
+      }
+      registered_.erase(reg);
+    }
+    for (EventBatchList::iterator it = batches_.begin(); it != batches_.end();
+         ++it) {
+      for (int i = 0; i < it->second; ++i) {
+        if (it->first[i].data.ptr == pdispatcher)
+          it->first[i].data.ptr = NULL;
+      }
+    }
+  }
+#endif
+}
+
+void PhysicalSocketServer::Update(Dispatcher *pdispatcher) {
+#ifdef LINUX
+  if (epoll_fd_ == -1)
+    return;
+  // Registrations are brought up to date at the start of the next pass, so
+  // that an event which is turned off and on again while it is handled costs
+  // no system calls.
+  CritScope cs(&crit_);
+  updated_.push_back(pdispatcher);
+#endif
 }
 
+#ifdef LINUX
+void PhysicalSocketServer::SyncEpoll(Dispatcher *pdispatcher) {
+  RegisteredMap::iterator reg = registered_.find(pdispatcher);
+  if (reg == registered_.end())
+    return;  // Removed since it was updated.
+
+  uint32 events = EventsToEpoll(pdispatcher->GetRequestedEvents());
+  if (events == reg->second)
+    return;
+
+  // A descriptor with nothing requested is taken out of the set altogether,
+  // since epoll reports hangups and errors whatever the interest is.
+  int fd = pdispatcher->GetDescriptor();
+  epoll_event event = { 0 };
+  event.events = events;
+  event.data.ptr = pdispatcher;
+  int op = (events == 0) ? EPOLL_CTL_DEL :
+           (reg->second == 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  if (epoll_ctl(epoll_fd_, op, fd, &event) < 0) {
+    LOG_ERR(LS_WARNING) << "epoll_ctl failed, fd=" << fd;
+    if (op != EPOLL_CTL_DEL)
+      return;
+  }
+  reg->second = events;
+}
+#endif
+
 #ifdef POSIX
+// static
+uint32 PhysicalSocketServer::ReadyEvents(Dispatcher* pdispatcher,
+                                         bool readable, bool writable,
+                                         int* errcode) {
+  uint32 ff = 0;
+
+  // Reap any error code, which can be signaled through reads or writes.
+  // TODO: Should we set errcode if getsockopt fails?
+  int fd = pdispatcher->GetDescriptor();
+  socklen_t len = sizeof(*errcode);
+  ::getsockopt(fd, SOL_SOCKET, SO_ERROR, errcode, &len);
+
+  // Check readable descriptors. If we're waiting on an accept, signal
+  // that. Otherwise we're waiting for data, check to see if we're
+  // readable or really closed.
+  // TODO: Only peek at TCP descriptors.
+  if (readable) {
+    if (pdispatcher->GetRequestedEvents() & DE_ACCEPT) {
+      ff |= DE_ACCEPT;
+    } else if (*errcode || pdispatcher->IsDescriptorClosed()) {
+      ff |= DE_CLOSE;
+    } else {
+      ff |= DE_READ;
+    }
+  }
+
+  // Check writable descriptors. If we're waiting on a connect, detect
+  // success versus failure by the reaped error code.
+  if (writable) {
+    if (pdispatcher->GetRequestedEvents() & DE_CONNECT) {
+      if (!*errcode) {
+        ff |= DE_CONNECT;
+      } else {
+        ff |= DE_CLOSE;
+      }
+    } else {
+      ff |= DE_WRITE;
+    }
+  }
+  return ff;
+}
+
 bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
+#ifdef LINUX
+  if (epoll_fd_ != -1)
+    return WaitEpoll(cmsWait, process_io);
+#endif
+
   // Calculate timing information
 
   struct timeval *ptvWait = NULL;
@@ -1306,47 +1486,16 @@ bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
       for (size_t i = 0; i < dispatchers_.size(); ++i) {
         Dispatcher *pdispatcher = dispatchers_[i];
         int fd = pdispatcher->GetDescriptor();
-        uint32 ff = 0;
-        int errcode = 0;
-
-        // Reap any error code, which can be signaled through reads or writes.
-        // TODO: Should we set errcode if getsockopt fails?
-        if (FD_ISSET(fd, &fdsRead) || FD_ISSET(fd, &fdsWrite)) {
-          socklen_t len = sizeof(errcode);
-          ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &errcode, &len);
-        }
-
-        // Check readable descriptors. If we're waiting on an accept, signal
-        // that. Otherwise we're waiting for data, check to see if we're
-        // readable or really closed.
-        // TODO: Only peek at TCP descriptors.
-        if (FD_ISSET(fd, &fdsRead)) {
-          FD_CLR(fd, &fdsRead);
-          if (pdispatcher->GetRequestedEvents() & DE_ACCEPT) {
-            ff |= DE_ACCEPT;
-          } else if (errcode || pdispatcher->IsDescriptorClosed()) {
-            ff |= DE_CLOSE;
-          } else {
-            ff |= DE_READ;
-          }
-        }
-
-        // Check writable descriptors. If we're waiting on a connect, detect
-        // success versus failure by the reaped error code.
-        if (FD_ISSET(fd, &fdsWrite)) {
-          FD_CLR(fd, &fdsWrite);
-          if (pdispatcher->GetRequestedEvents() & DE_CONNECT) {
-            if (!errcode) {
-              ff |= DE_CONNECT;
-            } else {
-              ff |= DE_CLOSE;
-            }
-          } else {
-            ff |= DE_WRITE;
-          }
-        }
+        bool readable = FD_ISSET(fd, &fdsRead);
+        bool writable = FD_ISSET(fd, &fdsWrite);
+        if (!readable && !writable)
+          continue;
+        FD_CLR(fd, &fdsRead);
+        FD_CLR(fd, &fdsWrite);
 
         // Tell the descriptor about the event.
+        int errcode = 0;
+        uint32 ff = ReadyEvents(pdispatcher, readable, writable, &errcode);
         if (ff != 0) {
           pdispatcher->OnPreEvent(ff);
           pdispatcher->OnEvent(ff, errcode);
@@ -1379,6 +1528,83 @@ bool PhysicalSocketServer::Wait(int cmsWait, bool process_io) {
   return true;
 }
 
+#ifdef LINUX
+bool PhysicalSocketServer::WaitEpoll(int cmsWait, bool process_io) {
+  uint32 stop = (cmsWait != kForever) ? TimeAfter(cmsWait) : 0;
+  int timeout = cmsWait;
+  epoll_event events[kMaxEpollEvents];
+
+  fWait_ = true;
+
+  while (fWait_) {
+    int n;
+    if (process_io) {
+      {
+        CritScope cr(&crit_);
+        for (size_t i = 0; i < updated_.size(); ++i)
+          SyncEpoll(updated_[i]);
+        updated_.clear();
+      }
+      n = epoll_wait(epoll_fd_, events, kMaxEpollEvents, timeout);
+    } else {
+      // Only the wakeup matters, and the other registered descriptors would
+      // keep epoll_wait() from blocking, so poll that one alone.
+      pollfd wakeup = { signal_wakeup_->GetDescriptor(), POLLIN, 0 };
+      n = poll(&wakeup, 1, timeout);
+      if (n > 0) {
+        events[0].events = EPOLLIN;
+        events[0].data.ptr = static_cast<Dispatcher*>(signal_wakeup_);
+      }
+    }
+
+    if (n < 0) {
+      if (errno != EINTR) {
+        LOG_E(LS_ERROR, EN, errno) << "epoll_wait";
+        return false;
+      }
+      // Else ignore the error and keep going, as in Wait().
+    } else if (n == 0) {
+      // If timeout, return success
+      return true;
+    } else {
+      CritScope cr(&crit_);
+      batches_.push_back(std::make_pair(events, n));
+      for (int i = 0; i < n; ++i) {
+        // The dispatcher is cleared if an earlier handler removed it.
+        Dispatcher* pdispatcher =
+            static_cast<Dispatcher*>(events[i].data.ptr);
+        if (!pdispatcher)
+          continue;
+
+        // Hangups and errors are reported the way select() reports them, as
+        // readiness.
+        uint32 ev = events[i].events;
+        bool readable = (ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+        bool writable = (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0;
+        uint32 registered = EventsToEpoll(pdispatcher->GetRequestedEvents());
+        readable = readable && (registered & EPOLLIN);
+        writable = writable && (registered & EPOLLOUT);
+        if (!readable && !writable)
+          continue;
+
+        int errcode = 0;
+        uint32 ff = ReadyEvents(pdispatcher, readable, writable, &errcode);
+        if (ff != 0) {
+          pdispatcher->OnPreEvent(ff);
+          pdispatcher->OnEvent(ff, errcode);
+        }
+      }
+      batches_.pop_back();
+    }
+
+    if (cmsWait != kForever)
+      timeout = _max(TimeUntil(stop), 0);
+  }
+
+  return true;
+}
+#endif
+
 static void GlobalSignalHandler(int signum) {
   PosixSignalHandler::Instance()->OnPosixSignalReceived(signum);
 }
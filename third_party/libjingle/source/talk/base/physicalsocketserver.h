@@ -28,6 +28,7 @@
 #ifndef TALK_BASE_PHYSICALSOCKETSERVER_H__
 #define TALK_BASE_PHYSICALSOCKETSERVER_H__
 
+#include <map>
 #include <vector>
 
 #include "talk/base/asyncfile.h"
@@ -39,6 +40,10 @@
 typedef int SOCKET;
 #endif // POSIX
 
+#ifdef LINUX
+struct epoll_event;
+#endif
+
 namespace talk_base {
 
 // Event constants for the Dispatcher class.
@@ -55,6 +60,8 @@ class Signaler;
 class PosixSignalDispatcher;
 #endif
 
+// A dispatcher whose requested events change after it has been added to a
+// PhysicalSocketServer must tell the server with Update().
 class Dispatcher {
  public:
   virtual ~Dispatcher() {}
@@ -74,7 +81,17 @@ class Dispatcher {
 // A socket server that provides the real sockets of the underlying OS.
 class PhysicalSocketServer : public SocketServer {
 public:
+  // How Wait() waits for I/O.  WAIT_SELECT is limited to FD_SETSIZE
+  // descriptors and scans every dispatcher on each pass.  WAIT_EPOLL keeps the
+  // descriptors registered with the kernel and only looks at the ready ones;
+  // it is only available on Linux, elsewhere WAIT_SELECT is used instead.
+  enum WaitMode {
+    WAIT_SELECT,
+    WAIT_EPOLL,
+  };
+
   PhysicalSocketServer();
+  explicit PhysicalSocketServer(WaitMode mode);
   virtual ~PhysicalSocketServer();
 
   // SocketFactory:
@@ -90,6 +107,8 @@ public:
 
   void Add(Dispatcher* dispatcher);
   void Remove(Dispatcher* dispatcher);
+  // Called when the events requested by |dispatcher| have changed.
+  void Update(Dispatcher* dispatcher);
 
 #ifdef POSIX
   AsyncFile* CreateFile(int fd);
@@ -111,9 +130,17 @@ private:
   typedef std::vector<Dispatcher*> DispatcherList;
   typedef std::vector<size_t*> IteratorList;
 
+  void Construct(WaitMode mode);
+
 #ifdef POSIX
   static bool InstallSignal(int signum, void (*handler)(int));
 
+  // Works out which events to deliver to |dispatcher|, given whether its
+  // descriptor is readable and writable.  Sets |errcode| to any pending
+  // socket error.
+  static uint32 ReadyEvents(Dispatcher* dispatcher, bool readable,
+                            bool writable, int* errcode);
+
   scoped_ptr<PosixSignalDispatcher> signal_dispatcher_;
 #endif
   DispatcherList dispatchers_;
@@ -126,6 +153,26 @@ private:
 #ifdef WIN32
   WSAEVENT socket_ev_;
 #endif
+#ifdef LINUX
+  typedef std::map<Dispatcher*, uint32> RegisteredMap;
+  typedef std::vector<std::pair<epoll_event*, int> > EventBatchList;
+
+  bool WaitEpoll(int cms, bool process_io);
+  // Brings the epoll registration of |dispatcher| in line with the events it
+  // requests.
+  void SyncEpoll(Dispatcher* dispatcher);
+
+  // -1 unless in WAIT_EPOLL mode.
+  int epoll_fd_;
+  // The epoll interest of each dispatcher, as DE_* flags, or 0 when it is not
+  // registered.
+  RegisteredMap registered_;
+  // Dispatchers that have called Update() since the last pass.
+  DispatcherList updated_;
+  // The ready events of the passes being dispatched, so that Remove() can
+  // drop the events of dispatchers that go away.
+  EventBatchList batches_;
+#endif
 };
 
 } // namespace talk_base
@@ -57,12 +57,17 @@ struct SerializeObject {
 // 8: Adds support for file range and modification time
 // 9: Adds support for itemSequenceNumbers
 // 10: Adds support for blob
+// 11: Switches from Pickle to the compact format described below.  Versions
+//     1 to 10 are still read.
 // Should be const, but unit tests may modify it.
 //
 // NOTE: If the version is -1, then the pickle contains only a URL string.
 // See CreateHistoryStateForURL.
 //
-int kVersion = 10;
+int kVersion = 11;
+
+// The last version written with Pickle.
+const int kLastPickleVersion = 10;
 
 // A bunch of convenience functions to read/write to SerializeObjects.
 // The serializers assume the input data is in the correct format and so does
@@ -357,7 +362,7 @@ static WebHistoryItem ReadHistoryItem(
     return item;
   }
 
-  if (obj->version > kVersion || obj->version < 1)
+  if (obj->version > kLastPickleVersion || obj->version < 1)
     return WebHistoryItem();
 
   WebHistoryItem item;
@@ -413,14 +418,640 @@ static WebHistoryItem ReadHistoryItem(
   return item;
 }
 
+// The compact format (version 11 and up) is about half the size of the Pickle
+// one, and can be read and rewritten without building a WebHistoryItem:
+//
+//   - it starts with kCompactMarker, which cannot begin a Pickle of less than
+//     4GB, followed by the version;
+//   - integers are varints, zigzag-encoded when signed; doubles are 8 raw
+//     bytes and booleans one byte;
+//   - a string is a varint (length << 2 | kind), where kind says whether the
+//     string is null, ASCII (one byte per character) or UTF-16 (two bytes per
+//     character, preceded by a zero byte if needed to align them to the
+//     start of the buffer, so they can be used in place);
+//   - each child item is preceded by its size in bytes, as a 32-bit integer,
+//     so subtrees can be skipped or copied without being decoded.
+//
+// The item fields are written in the same order as in the Pickle format,
+// without the second copy of the referrer.
+const char kCompactMarker[] = { '\xff', '\xff', '\xff', '\xff' };
+
+enum CompactStringKind {
+  COMPACT_STRING_NULL = 0,
+  COMPACT_STRING_ASCII = 1,
+  COMPACT_STRING_UTF16 = 2,
+};
+
+// Appends the compact encoding of values to a string.
+class CompactWriter {
+ public:
+  explicit CompactWriter(std::string* output) : output_(output) {}
+
+  void WriteVarint(uint64 value) {
+    while (value >= 0x80) {
+      output_->push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    output_->push_back(static_cast<char>(value));
+  }
+
+  void WriteSignedVarint(int64 value) {
+    // Zigzag encoding, so small negative numbers stay short.
+    WriteVarint((static_cast<uint64>(value) << 1) ^
+                static_cast<uint64>(value >> 63));
+  }
+
+  void WriteBoolean(bool value) {
+    output_->push_back(value ? 1 : 0);
+  }
+
+  void WriteReal(double value) {
+    output_->append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void WriteBytes(const char* data, size_t length) {
+    WriteVarint(length);
+    output_->append(data, length);
+  }
+
+  void WriteString(const WebString& str) {
+    if (str.isNull()) {
+      WriteVarint(COMPACT_STRING_NULL);
+      return;
+    }
+
+    const WebUChar* data = str.data();
+    size_t length = str.length();
+    bool ascii = true;
+    for (size_t i = 0; i < length && ascii; ++i)
+      ascii = data[i] < 0x80;
+
+    if (ascii) {
+      WriteVarint(static_cast<uint64>(length) << 2 | COMPACT_STRING_ASCII);
+      size_t offset = output_->size();
+      output_->resize(offset + length);
+      for (size_t i = 0; i < length; ++i)
+        (*output_)[offset + i] = static_cast<char>(data[i]);
+      return;
+    }
+
+    WriteVarint(static_cast<uint64>(length) << 2 | COMPACT_STRING_UTF16);
+    WriteUTF16Padding();
+    output_->append(reinterpret_cast<const char*>(data),
+                    length * sizeof(WebUChar));
+  }
+
+  void WriteRaw(const char* data, size_t length) {
+    output_->append(data, length);
+  }
+
+  // Aligns the output for UTF-16 data.
+  void WriteUTF16Padding() {
+    if (output_->size() % sizeof(WebUChar))
+      output_->push_back(0);
+  }
+
+  // Leaves room for a 32-bit size, and returns its offset for PatchSize().
+  size_t ReserveSize() {
+    size_t offset = output_->size();
+    output_->append(sizeof(uint32), 0);
+    return offset;
+  }
+
+  // Stores the number of bytes written since ReserveSize() returned |offset|.
+  void PatchSize(size_t offset) {
+    uint32 size = output_->size() - offset - sizeof(uint32);
+    memcpy(&(*output_)[offset], &size, sizeof(size));
+  }
+
+ private:
+  std::string* output_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompactWriter);
+};
+
+// Reads values in the compact encoding from a buffer, pointing into it rather
+// than copying where possible.  Any read past the end or malformed value puts
+// the reader in a failed state, where all further reads return zero, null or
+// empty values.
+class CompactReader {
+ public:
+  CompactReader(const char* begin, const char* end)
+      : begin_(begin), pos_(begin), end_(end), failed_(false) {}
+
+  bool failed() const { return failed_; }
+  const char* pos() const { return pos_; }
+  size_t remaining() const { return end_ - pos_; }
+
+  // Puts the reader in the failed state, and returns 0 for convenience.
+  int Fail() {
+    failed_ = true;
+    pos_ = end_;
+    return 0;
+  }
+
+  uint64 ReadVarint() {
+    uint64 value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos_ == end_)
+        break;
+      uint8 byte = static_cast<uint8>(*pos_++);
+      value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    return Fail();
+  }
+
+  int64 ReadSignedVarint() {
+    uint64 value = ReadVarint();
+    return static_cast<int64>(value >> 1) ^ -static_cast<int64>(value & 1);
+  }
+
+  int ReadInteger() {
+    int64 value = ReadSignedVarint();
+    if (value < kint32min || value > kint32max)
+      return Fail();
+    return static_cast<int>(value);
+  }
+
+  bool ReadBoolean() {
+    if (pos_ == end_)
+      return Fail();
+    return *pos_++ != 0;
+  }
+
+  double ReadReal() {
+    double value = 0.0;
+    if (end_ - pos_ < static_cast<ptrdiff_t>(sizeof(value)))
+      return Fail();
+    memcpy(&value, pos_, sizeof(value));
+    pos_ += sizeof(value);
+    return value;
+  }
+
+  // Returns a pointer to |length| bytes of the buffer, or NULL.
+  const char* ReadRaw(uint64 length) {
+    if (static_cast<uint64>(end_ - pos_) < length) {
+      Fail();
+      return NULL;
+    }
+    const char* data = pos_;
+    pos_ += length;
+    return data;
+  }
+
+  // Reads a size written by CompactWriter::PatchSize(), which must fit in
+  // the rest of the buffer.
+  uint32 ReadSize() {
+    uint32 size = 0;
+    const char* data = ReadRaw(sizeof(size));
+    if (data)
+      memcpy(&size, data, sizeof(size));
+    if (size > remaining())
+      return Fail();
+    return size;
+  }
+
+  // Reads a length-prefixed run of bytes.
+  bool ReadBytes(const char** data, size_t* length) {
+    uint64 size = ReadVarint();
+    *data = ReadRaw(size);
+    *length = static_cast<size_t>(size);
+    return *data != NULL;
+  }
+
+  WebString ReadString() {
+    uint64 header = ReadVarint();
+    uint64 length = header >> 2;
+    switch (header & 3) {
+      case COMPACT_STRING_NULL:
+        return WebString();
+      case COMPACT_STRING_ASCII: {
+        const char* data = ReadRaw(length);
+        if (!data)
+          return WebString();
+        // Widening is much cheaper than UTF-8 decoding.
+        scratch_.assign(data, data + length);
+        return WebString(scratch_.data(), scratch_.size());
+      }
+      case COMPACT_STRING_UTF16: {
+        SkipUTF16Padding();
+        if (length > kuint32max) {
+          Fail();
+          return WebString();
+        }
+        const char* data = ReadRaw(length * sizeof(WebUChar));
+        if (!data)
+          return WebString();
+        return WebString(reinterpret_cast<const WebUChar*>(data),
+                         static_cast<size_t>(length));
+      }
+      default:
+        Fail();
+        return WebString();
+    }
+  }
+
+  // Moves past the padding written by CompactWriter::WriteUTF16Padding().
+  void SkipUTF16Padding() {
+    if ((pos_ - begin_) % sizeof(WebUChar))
+      ReadRaw(1);
+  }
+
+  // Moves past a string without decoding it.
+  void SkipString() {
+    uint64 header = ReadVarint();
+    uint64 length = header >> 2;
+    switch (header & 3) {
+      case COMPACT_STRING_NULL:
+        break;
+      case COMPACT_STRING_ASCII:
+        ReadRaw(length);
+        break;
+      case COMPACT_STRING_UTF16:
+        SkipUTF16Padding();
+        if (length > kuint32max)
+          Fail();
+        else
+          ReadRaw(length * sizeof(WebUChar));
+        break;
+      default:
+        Fail();
+        break;
+    }
+  }
+
+ private:
+  const char* begin_;
+  const char* pos_;
+  const char* end_;
+  bool failed_;
+
+  // Reused to widen ASCII strings.
+  string16 scratch_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompactReader);
+};
+
+static void WriteCompactFormData(const WebHTTPBody& http_body,
+                                 CompactWriter* writer) {
+  writer->WriteBoolean(!http_body.isNull());
+  if (http_body.isNull())
+    return;
+
+  writer->WriteVarint(http_body.elementCount());
+  WebHTTPBody::Element element;
+  for (size_t i = 0; http_body.elementAt(i, element); ++i) {
+    writer->WriteVarint(element.type);
+    if (element.type == WebHTTPBody::Element::TypeData) {
+      writer->WriteBytes(element.data.data(), element.data.size());
+    } else if (element.type == WebHTTPBody::Element::TypeFile) {
+      writer->WriteString(element.filePath);
+      writer->WriteSignedVarint(element.fileStart);
+      writer->WriteSignedVarint(element.fileLength);
+      writer->WriteReal(element.modificationTime);
+    } else {
+      const std::string& spec = GURL(element.blobURL).possibly_invalid_spec();
+      writer->WriteBytes(spec.data(), spec.size());
+    }
+  }
+  writer->WriteSignedVarint(http_body.identifier());
+}
+
+static WebHTTPBody ReadCompactFormData(CompactReader* reader) {
+  if (!reader->ReadBoolean())
+    return WebHTTPBody();
+
+  WebHTTPBody http_body;
+  http_body.initialize();
+
+  uint64 num_elements = reader->ReadVarint();
+  for (uint64 i = 0; i < num_elements && !reader->failed(); ++i) {
+    uint64 type = reader->ReadVarint();
+    if (type == WebHTTPBody::Element::TypeData) {
+      const char* data;
+      size_t length;
+      if (reader->ReadBytes(&data, &length))
+        http_body.appendData(WebData(data, length));
+    } else if (type == WebHTTPBody::Element::TypeFile) {
+      WebString file_path = reader->ReadString();
+      long long file_start = reader->ReadSignedVarint();
+      long long file_length = reader->ReadSignedVarint();
+      double modification_time = reader->ReadReal();
+      http_body.appendFileRange(file_path, file_start, file_length,
+                                modification_time);
+    } else {
+      const char* spec;
+      size_t length;
+      if (reader->ReadBytes(&spec, &length))
+        http_body.appendBlob(GURL(std::string(spec, length)));
+    }
+  }
+  http_body.setIdentifier(reader->ReadSignedVarint());
+  return http_body;
+}
+
+// Moves past form data without decoding it.
+static void SkipCompactFormData(CompactReader* reader) {
+  if (!reader->ReadBoolean())
+    return;
+
+  const char* data;
+  size_t length;
+  uint64 num_elements = reader->ReadVarint();
+  for (uint64 i = 0; i < num_elements && !reader->failed(); ++i) {
+    uint64 type = reader->ReadVarint();
+    if (type == WebHTTPBody::Element::TypeFile) {
+      reader->SkipString();
+      reader->ReadSignedVarint();
+      reader->ReadSignedVarint();
+      reader->ReadReal();
+    } else {
+      reader->ReadBytes(&data, &length);
+    }
+  }
+  reader->ReadSignedVarint();
+}
+
+// Writes |item| and its children, without the header.
+static void WriteCompactHistoryItem(const WebHistoryItem& item,
+                                    CompactWriter* writer) {
+  // WARNING: see the note in WriteHistoryItem.  The children come last and
+  // are size-prefixed, so new fields must go just before them.
+  writer->WriteString(item.urlString());
+  writer->WriteString(item.originalURLString());
+  writer->WriteString(item.target());
+  writer->WriteString(item.parent());
+  writer->WriteString(item.title());
+  writer->WriteString(item.alternateTitle());
+  writer->WriteReal(item.lastVisitedTime());
+  writer->WriteSignedVarint(item.scrollOffset().x);
+  writer->WriteSignedVarint(item.scrollOffset().y);
+  writer->WriteBoolean(item.isTargetItem());
+  writer->WriteSignedVarint(item.visitCount());
+  writer->WriteString(item.referrer());
+
+  const WebVector<WebString>& document_state = item.documentState();
+  writer->WriteVarint(document_state.size());
+  for (size_t i = 0, c = document_state.size(); i < c; ++i)
+    writer->WriteString(document_state[i]);
+
+  writer->WriteSignedVarint(item.itemSequenceNumber());
+  writer->WriteSignedVarint(item.documentSequenceNumber());
+  bool has_state_object = !item.stateObject().isNull();
+  writer->WriteBoolean(has_state_object);
+  if (has_state_object)
+    writer->WriteString(item.stateObject().toString());
+
+  WriteCompactFormData(item.httpBody(), writer);
+  writer->WriteString(item.httpContentType());
+
+  // Each child is preceded by its size, patched in once the child has been
+  // written in place.
+  const WebVector<WebHistoryItem>& children = item.children();
+  writer->WriteVarint(children.size());
+  for (size_t i = 0, c = children.size(); i < c; ++i) {
+    size_t size_offset = writer->ReserveSize();
+    WriteCompactHistoryItem(children[i], writer);
+    writer->PatchSize(size_offset);
+  }
+}
+
+static WebHistoryItem ReadCompactHistoryItem(
+    CompactReader* reader,
+    bool include_form_data,
+    bool include_scroll_offset) {
+  WebHistoryItem item;
+  item.initialize();
+
+  item.setURLString(reader->ReadString());
+  item.setOriginalURLString(reader->ReadString());
+  item.setTarget(reader->ReadString());
+  item.setParent(reader->ReadString());
+  item.setTitle(reader->ReadString());
+  item.setAlternateTitle(reader->ReadString());
+  item.setLastVisitedTime(reader->ReadReal());
+
+  int x = reader->ReadInteger();
+  int y = reader->ReadInteger();
+  if (include_scroll_offset)
+    item.setScrollOffset(WebPoint(x, y));
+
+  item.setIsTargetItem(reader->ReadBoolean());
+  item.setVisitCount(reader->ReadInteger());
+  item.setReferrer(reader->ReadString());
+
+  // Every string takes at least one byte, which bounds the allocation below
+  // when the count is corrupt.
+  uint64 num_states = reader->ReadVarint();
+  if (num_states > reader->remaining())
+    return WebHistoryItem();
+  WebVector<WebString> document_state(static_cast<size_t>(num_states));
+  for (size_t i = 0; i < document_state.size(); ++i)
+    document_state[i] = reader->ReadString();
+  item.setDocumentState(document_state);
+
+  item.setItemSequenceNumber(reader->ReadSignedVarint());
+  item.setDocumentSequenceNumber(reader->ReadSignedVarint());
+  if (reader->ReadBoolean()) {
+    item.setStateObject(
+        WebSerializedScriptValue::fromString(reader->ReadString()));
+  }
+
+  if (include_form_data) {
+    item.setHTTPBody(ReadCompactFormData(reader));
+    item.setHTTPContentType(reader->ReadString());
+  } else {
+    SkipCompactFormData(reader);
+    reader->SkipString();
+  }
+
+  uint64 num_children = reader->ReadVarint();
+  for (uint64 i = 0; i < num_children && !reader->failed(); ++i) {
+    uint32 size = reader->ReadSize();
+    const char* child_end = reader->pos() + size;
+    if (reader->failed())
+      return WebHistoryItem();
+    const WebHistoryItem& child = ReadCompactHistoryItem(
+        reader, include_form_data, include_scroll_offset);
+    if (reader->pos() != child_end)
+      return WebHistoryItem();
+    item.appendToChildren(child);
+  }
+
+  if (reader->failed())
+    return WebHistoryItem();
+  return item;
+}
+
+// Copies a string from |reader| to |writer| without decoding it, re-aligning
+// UTF-16 data to its new position.
+static void CopyCompactString(CompactReader* reader, CompactWriter* writer) {
+  uint64 header = reader->ReadVarint();
+  uint64 length = header >> 2;
+  const char* data = NULL;
+  switch (header & 3) {
+    case COMPACT_STRING_NULL:
+      writer->WriteVarint(header);
+      return;
+    case COMPACT_STRING_ASCII:
+      data = reader->ReadRaw(length);
+      if (data) {
+        writer->WriteVarint(header);
+        writer->WriteRaw(data, static_cast<size_t>(length));
+      }
+      return;
+    case COMPACT_STRING_UTF16:
+      reader->SkipUTF16Padding();
+      if (length <= kuint32max)
+        data = reader->ReadRaw(length * sizeof(WebUChar));
+      if (data) {
+        writer->WriteVarint(header);
+        writer->WriteUTF16Padding();
+        writer->WriteRaw(data, static_cast<size_t>(length) * sizeof(WebUChar));
+      }
+      return;
+    default:
+      reader->Fail();
+      return;
+  }
+}
+
+static void CopyCompactFormData(CompactReader* reader, CompactWriter* writer) {
+  bool has_form_data = reader->ReadBoolean();
+  writer->WriteBoolean(has_form_data);
+  if (!has_form_data)
+    return;
+
+  const char* data;
+  size_t length;
+  uint64 num_elements = reader->ReadVarint();
+  writer->WriteVarint(num_elements);
+  for (uint64 i = 0; i < num_elements && !reader->failed(); ++i) {
+    uint64 type = reader->ReadVarint();
+    writer->WriteVarint(type);
+    if (type == WebHTTPBody::Element::TypeFile) {
+      CopyCompactString(reader, writer);
+      writer->WriteSignedVarint(reader->ReadSignedVarint());
+      writer->WriteSignedVarint(reader->ReadSignedVarint());
+      writer->WriteReal(reader->ReadReal());
+    } else if (reader->ReadBytes(&data, &length)) {
+      writer->WriteBytes(data, length);
+    }
+  }
+  writer->WriteSignedVarint(reader->ReadSignedVarint());
+}
+
+// Copies an item and its children from |reader| to |writer|, dropping the
+// form data and scroll offsets unless asked to keep them.  Strings and form
+// data are copied as bytes, so this does not need WebKit.
+static void RewriteCompactHistoryItem(CompactReader* reader,
+                                      CompactWriter* writer,
+                                      bool include_form_data,
+                                      bool include_scroll_offset) {
+  for (int i = 0; i < 6; ++i)
+    CopyCompactString(reader, writer);
+  writer->WriteReal(reader->ReadReal());
+
+  int64 x = reader->ReadSignedVarint();
+  int64 y = reader->ReadSignedVarint();
+  writer->WriteSignedVarint(include_scroll_offset ? x : 0);
+  writer->WriteSignedVarint(include_scroll_offset ? y : 0);
+
+  writer->WriteBoolean(reader->ReadBoolean());
+  writer->WriteSignedVarint(reader->ReadSignedVarint());
+  CopyCompactString(reader, writer);
+
+  uint64 num_states = reader->ReadVarint();
+  writer->WriteVarint(num_states);
+  for (uint64 i = 0; i < num_states && !reader->failed(); ++i)
+    CopyCompactString(reader, writer);
+
+  writer->WriteSignedVarint(reader->ReadSignedVarint());
+  writer->WriteSignedVarint(reader->ReadSignedVarint());
+  bool has_state_object = reader->ReadBoolean();
+  writer->WriteBoolean(has_state_object);
+  if (has_state_object)
+    CopyCompactString(reader, writer);
+
+  if (include_form_data) {
+    CopyCompactFormData(reader, writer);
+    CopyCompactString(reader, writer);
+  } else {
+    SkipCompactFormData(reader);
+    reader->SkipString();
+    writer->WriteBoolean(false);
+    writer->WriteVarint(COMPACT_STRING_NULL);
+  }
+
+  uint64 num_children = reader->ReadVarint();
+  writer->WriteVarint(num_children);
+  for (uint64 i = 0; i < num_children && !reader->failed(); ++i) {
+    uint32 size = reader->ReadSize();
+    const char* child_end = reader->pos() + size;
+    size_t size_offset = writer->ReserveSize();
+    RewriteCompactHistoryItem(reader, writer, include_form_data,
+                              include_scroll_offset);
+    writer->PatchSize(size_offset);
+    if (reader->pos() != child_end)
+      reader->Fail();
+  }
+}
+
+static bool IsCompactHistoryState(const std::string& serialized_item) {
+  return serialized_item.size() >= sizeof(kCompactMarker) &&
+         memcmp(serialized_item.data(), kCompactMarker,
+                sizeof(kCompactMarker)) == 0;
+}
+
+static std::string HistoryItemToCompactString(const WebHistoryItem& item,
+                                              int version) {
+  std::string output;
+  CompactWriter writer(&output);
+  writer.WriteRaw(kCompactMarker, sizeof(kCompactMarker));
+  writer.WriteVarint(version);
+  WriteCompactHistoryItem(item, &writer);
+  return output;
+}
+
+// Moves |reader| past the header to the top-level item.  Returns false if the
+// header is not one this code can read.
+static bool ReadCompactHeader(CompactReader* reader) {
+  reader->ReadRaw(sizeof(kCompactMarker));
+  uint64 version = reader->ReadVarint();
+  return !reader->failed() &&
+         version > static_cast<uint64>(kLastPickleVersion) &&
+         version <= static_cast<uint64>(kVersion);
+}
+
+// Rewrites compact |content_state| without the parts not asked for, or
+// returns an empty string if it cannot be parsed.
+static std::string RewriteCompactHistoryState(const std::string& content_state,
+                                              bool include_form_data,
+                                              bool include_scroll_offset) {
+  CompactReader reader(content_state.data(),
+                       content_state.data() + content_state.size());
+  if (!ReadCompactHeader(&reader))
+    return std::string();
+
+  std::string output;
+  output.reserve(content_state.size());
+  CompactWriter writer(&output);
+  writer.WriteRaw(content_state.data(), reader.pos() - content_state.data());
+  RewriteCompactHistoryItem(&reader, &writer, include_form_data,
+                            include_scroll_offset);
+  if (reader.failed())
+    return std::string();
+  return output;
+}
+
 // Serialize a HistoryItem to a string, using our JSON Value serializer.
 std::string HistoryItemToString(const WebHistoryItem& item) {
   if (item.isNull())
     return std::string();
 
-  SerializeObject obj;
-  WriteHistoryItem(item, &obj);
-  return obj.GetAsString();
+  return HistoryItemToCompactString(item, kVersion);
 }
 
 // Reconstruct a HistoryItem from a string, using our JSON Value deserializer.
@@ -435,6 +1066,15 @@ static WebHistoryItem HistoryItemFromString(
   if (serialized_item.empty())
     return WebHistoryItem();
 
+  if (IsCompactHistoryState(serialized_item)) {
+    CompactReader reader(serialized_item.data(),
+                         serialized_item.data() + serialized_item.size());
+    if (!ReadCompactHeader(&reader))
+      return WebHistoryItem();
+    return ReadCompactHistoryItem(&reader, include_form_data,
+                                  include_scroll_offset);
+  }
+
   SerializeObject obj(serialized_item.data(),
                       static_cast<int>(serialized_item.length()));
   return ReadHistoryItem(&obj, include_form_data, include_scroll_offset);
@@ -453,6 +1093,11 @@ void HistoryItemToVersionedString(const WebHistoryItem& item, int version,
     return;
   }
 
+  if (version > kLastPickleVersion) {
+    *serialized_item = HistoryItemToCompactString(item, version);
+    return;
+  }
+
   // Temporarily change the version.
   int real_version = kVersion;
   kVersion = version;
@@ -477,6 +1122,9 @@ std::string CreateHistoryStateForURL(const GURL& url) {
 }
 
 std::string RemoveFormDataFromHistoryState(const std::string& content_state) {
+  if (IsCompactHistoryState(content_state))
+    return RewriteCompactHistoryState(content_state, false, true);
+
   // TODO(darin): We should avoid using the WebKit API here, so that we do not
   // need to have WebKit initialized before calling this method.
   const WebHistoryItem& item =
@@ -491,6 +1139,9 @@ std::string RemoveFormDataFromHistoryState(const std::string& content_state) {
 
 std::string RemoveScrollOffsetFromHistoryState(
     const std::string& content_state) {
+  if (IsCompactHistoryState(content_state))
+    return RewriteCompactHistoryState(content_state, true, false);
+
   // TODO(darin): We should avoid using the WebKit API here, so that we do not
   // need to have WebKit initialized before calling this method.
   const WebHistoryItem& item =
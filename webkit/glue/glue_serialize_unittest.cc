@@ -4,24 +4,34 @@
 
 #include <string>
 
+#include "base/logging.h"
 #include "base/pickle.h"
 #include "base/string_util.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebHTTPBody.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebPoint.h"
+#include "third_party/WebKit/Source/WebKit/chromium/public/WebSerializedScriptValue.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebVector.h"
 #include "webkit/glue/glue_serialize.h"
 #include "webkit/glue/web_io_operators.h"
+#include "webkit/glue/webkit_glue.h"
 
 using WebKit::WebData;
 using WebKit::WebHistoryItem;
 using WebKit::WebHTTPBody;
 using WebKit::WebPoint;
+using WebKit::WebSerializedScriptValue;
 using WebKit::WebString;
 using WebKit::WebUChar;
 using WebKit::WebVector;
 
 namespace {
+
+// The last version written with Pickle.
+const int kLastPickleVersion = 10;
+
 class GlueSerializeTest : public testing::Test {
  public:
   // Makes a FormData with some random data.
@@ -79,6 +89,47 @@ class GlueSerializeTest : public testing::Test {
     return item;
   }
 
+  // Constructs a HistoryItem exercising the less common parts of the
+  // format: null and empty strings, non-ASCII text, file ranges, state
+  // objects and nested children.
+  WebHistoryItem MakeUnusualHistoryItem(int depth) {
+    WebHistoryItem item;
+    item.initialize();
+
+    item.setURLString(WebString::fromUTF8("http://example.com/\xe2\x98\x83"));
+    item.setOriginalURLString(WebString::fromUTF8(""));
+    item.setTitle(WebString::fromUTF8("\xd0\x9f\xd1\x80\xd0\xb8"));
+    item.setAlternateTitle(WebString::fromUTF8("x"));
+    item.setLastVisitedTime(-1.5);
+    item.setScrollOffset(WebPoint(0x7fffffff, -0x7fffffff - 1));
+    item.setVisitCount(-1);
+    item.setItemSequenceNumber(GG_INT64_C(0x123456789abcdef));
+    item.setDocumentSequenceNumber(-GG_INT64_C(0x123456789abcdef));
+    item.setStateObject(WebSerializedScriptValue::fromString(
+        WebString::fromUTF8("\xe6\x97\xa5")));
+
+    WebVector<WebString> document_state(size_t(3));
+    document_state[0] = WebString::fromUTF8("a");
+    document_state[2] = WebString::fromUTF8("\xc3\xa9t\xc3\xa9");
+    item.setDocumentState(document_state);
+
+    WebHTTPBody http_body;
+    http_body.initialize();
+    http_body.appendFileRange(WebString::fromUTF8("\xc3\xa9.txt"),
+                              GG_INT64_C(1) << 40, 7, 1234.5);
+    const char data[] = "\0\xff";
+    http_body.appendData(WebData(data, sizeof(data)));
+    http_body.setIdentifier(-GG_INT64_C(5000000000));
+    item.setHTTPBody(http_body);
+    item.setHTTPContentType(WebString::fromUTF8("multipart/form-data"));
+    item.setReferrer(WebString::fromUTF8("r"));
+
+    for (int i = 0; i < depth; ++i)
+      item.appendToChildren(MakeUnusualHistoryItem(depth - 1));
+
+    return item;
+  }
+
   // Checks that a == b.
   void HistoryItemExpectEqual(const WebHistoryItem& a,
                               const WebHistoryItem& b) {
@@ -100,6 +151,14 @@ class GlueSerializeTest : public testing::Test {
     for (size_t i = 0, c = a_docstate.size(); i < c; ++i)
       EXPECT_EQ(string16(a_docstate[i]), string16(b_docstate[i]));
 
+    EXPECT_EQ(a.itemSequenceNumber(), b.itemSequenceNumber());
+    EXPECT_EQ(a.documentSequenceNumber(), b.documentSequenceNumber());
+    EXPECT_EQ(a.stateObject().isNull(), b.stateObject().isNull());
+    if (!a.stateObject().isNull() && !b.stateObject().isNull()) {
+      EXPECT_EQ(string16(a.stateObject().toString()),
+                string16(b.stateObject().toString()));
+    }
+
     // Form Data
     const WebHTTPBody& a_body = a.httpBody();
     const WebHTTPBody& b_body = b.httpBody();
@@ -115,8 +174,12 @@ class GlueSerializeTest : public testing::Test {
                     std::string(b_elem.data.data(), b_elem.data.size()));
         } else {
           EXPECT_EQ(string16(a_elem.filePath), string16(b_elem.filePath));
+          EXPECT_EQ(a_elem.fileStart, b_elem.fileStart);
+          EXPECT_EQ(a_elem.fileLength, b_elem.fileLength);
+          EXPECT_EQ(a_elem.modificationTime, b_elem.modificationTime);
         }
       }
+      EXPECT_EQ(a_body.identifier(), b_body.identifier());
     }
     EXPECT_EQ(string16(a.httpContentType()), string16(b.httpContentType()));
 
@@ -159,6 +222,69 @@ TEST_F(GlueSerializeTest, HistoryItemSerializeTest) {
   HistoryItemExpectEqual(item, deserialized_item);
 }
 
+// Makes sure that the last Pickle version can still be read.
+TEST_F(GlueSerializeTest, PickleVersionTest) {
+  const WebHistoryItem& item = MakeHistoryItem(true, true);
+  std::string serialized_item;
+  webkit_glue::HistoryItemToVersionedString(item, kLastPickleVersion,
+                                            &serialized_item);
+  const WebHistoryItem& deserialized_item =
+      webkit_glue::HistoryItemFromString(serialized_item);
+
+  ASSERT_FALSE(deserialized_item.isNull());
+  HistoryItemExpectEqual(item, deserialized_item);
+  EXPECT_NE(webkit_glue::HistoryItemToString(item), serialized_item);
+}
+
+// Checks the parts of the format that MakeHistoryItem() does not use.
+TEST_F(GlueSerializeTest, UnusualHistoryItemSerializeTest) {
+  const WebHistoryItem& item = MakeUnusualHistoryItem(2);
+  const std::string& serialized_item = webkit_glue::HistoryItemToString(item);
+  const WebHistoryItem& deserialized_item =
+      webkit_glue::HistoryItemFromString(serialized_item);
+
+  ASSERT_FALSE(deserialized_item.isNull());
+  HistoryItemExpectEqual(item, deserialized_item);
+  EXPECT_FALSE(deserialized_item.originalURLString().isNull());
+  EXPECT_TRUE(deserialized_item.originalURLString().isEmpty());
+  EXPECT_TRUE(deserialized_item.target().isNull());
+  EXPECT_TRUE(deserialized_item.documentState()[1].isNull());
+  ASSERT_EQ(1u, deserialized_item.children()[0].children().size());
+  EXPECT_EQ(item.children()[0].children()[0].scrollOffset(),
+            deserialized_item.children()[0].children()[0].scrollOffset());
+}
+
+// Checks that form data and scroll offsets are removed from the whole tree.
+TEST_F(GlueSerializeTest, RemoveFromHistoryStateTest) {
+  const WebHistoryItem& item = MakeUnusualHistoryItem(2);
+  const std::string& serialized_item = webkit_glue::HistoryItemToString(item);
+
+  const WebHistoryItem& without_form_data =
+      webkit_glue::HistoryItemFromString(
+          webkit_glue::RemoveFormDataFromHistoryState(serialized_item));
+  ASSERT_FALSE(without_form_data.isNull());
+  EXPECT_TRUE(without_form_data.httpBody().isNull());
+  EXPECT_TRUE(without_form_data.httpContentType().isNull());
+  EXPECT_TRUE(without_form_data.children()[1].children()[0].httpBody().isNull());
+  EXPECT_EQ(item.scrollOffset(), without_form_data.scrollOffset());
+  EXPECT_EQ(string16(item.children()[1].title()),
+            string16(without_form_data.children()[1].title()));
+
+  const WebHistoryItem& without_scroll_offset =
+      webkit_glue::HistoryItemFromString(
+          webkit_glue::RemoveScrollOffsetFromHistoryState(serialized_item));
+  ASSERT_FALSE(without_scroll_offset.isNull());
+  EXPECT_EQ(WebPoint(), without_scroll_offset.scrollOffset());
+  EXPECT_EQ(WebPoint(),
+            without_scroll_offset.children()[1].children()[0].scrollOffset());
+
+  // Apart from the scroll offsets, nothing is lost.
+  WebHistoryItem leaf = MakeUnusualHistoryItem(0);
+  leaf.setScrollOffset(WebPoint());
+  HistoryItemExpectEqual(leaf,
+                         without_scroll_offset.children()[0].children()[0]);
+}
+
 // Checks that broken messages don't take out our process.
 TEST_F(GlueSerializeTest, BadMessagesTest) {
   {
@@ -195,6 +321,68 @@ TEST_F(GlueSerializeTest, BadMessagesTest) {
     std::string s(static_cast<const char*>(p.data()), p.size());
     webkit_glue::HistoryItemFromString(s);
   }
+  {
+    // Every truncation and a corrupted byte at every offset of the current
+    // format.
+    const std::string& serialized_item =
+        webkit_glue::HistoryItemToString(MakeUnusualHistoryItem(1));
+    for (size_t i = 0; i < serialized_item.size(); ++i) {
+      const std::string& truncated = serialized_item.substr(0, i);
+      EXPECT_TRUE(webkit_glue::HistoryItemFromString(truncated).isNull());
+      EXPECT_EQ(std::string(),
+                webkit_glue::RemoveFormDataFromHistoryState(truncated));
+
+      std::string corrupted = serialized_item;
+      corrupted[i] ^= 0xa5;
+      webkit_glue::HistoryItemFromString(corrupted);
+      webkit_glue::RemoveScrollOffsetFromHistoryState(corrupted);
+    }
+  }
+}
+
+// Compares the old Pickle format with the current one.
+// Run with --v=1 to see the results.
+TEST_F(GlueSerializeTest, Benchmark) {
+  WebHistoryItem item = MakeHistoryItem(true, false);
+  for (int i = 0; i < 8; ++i)
+    item.appendToChildren(MakeHistoryItem(true, true));
+
+  const int kIterations = 2000;
+  std::string formats[2];
+  webkit_glue::HistoryItemToVersionedString(item, kLastPickleVersion,
+                                            &formats[0]);
+  formats[1] = webkit_glue::HistoryItemToString(item);
+  EXPECT_LT(formats[1].size(), formats[0].size());
+
+  for (int f = 0; f < 2; ++f) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i) {
+      if (f == 0) {
+        webkit_glue::HistoryItemToVersionedString(item, kLastPickleVersion,
+                                                  &formats[0]);
+      } else {
+        formats[1] = webkit_glue::HistoryItemToString(item);
+      }
+    }
+    base::TimeDelta write_time = base::TimeTicks::Now() - start;
+
+    start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i)
+      EXPECT_FALSE(webkit_glue::HistoryItemFromString(formats[f]).isNull());
+    base::TimeDelta read_time = base::TimeTicks::Now() - start;
+
+    start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i)
+      webkit_glue::RemoveFormDataFromHistoryState(formats[f]);
+    base::TimeDelta remove_time = base::TimeTicks::Now() - start;
+
+    VLOG(1) << (f == 0 ? "Pickle" : "Compact") << ": "
+            << formats[f].size() << " bytes, write "
+            << write_time.InMicroseconds() / kIterations << "us, read "
+            << read_time.InMicroseconds() / kIterations << "us, "
+            << "remove form data "
+            << remove_time.InMicroseconds() / kIterations << "us";
+  }
 }
 
 }  // namespace
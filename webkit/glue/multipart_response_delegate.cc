@@ -4,6 +4,14 @@
 
 #include "webkit/glue/multipart_response_delegate.h"
 
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "base/logging.h"
 #include "base/string_number_conversions.h"
 #include "base/string_util.h"
@@ -63,16 +71,15 @@ MultipartResponseDelegate::MultipartResponseDelegate(
       loader_(loader),
       original_response_(response),
       encoded_data_length_(0),
-      boundary_("--"),
       first_received_data_(true),
       processing_headers_(false),
       stop_sending_(false),
       has_sent_first_response_(false) {
   // Some servers report a boundary prefixed with "--".  See bug 5786.
   if (StartsWithASCII(boundary, "--", true)) {
-    boundary_.assign(boundary);
+    SetBoundary(boundary);
   } else {
-    boundary_.append(boundary);
+    SetBoundary("--" + boundary);
   }
 }
 
@@ -85,104 +92,124 @@ void MultipartResponseDelegate::OnReceivedData(const char* data,
   if (stop_sending_)
     return;
 
-  data_.append(data, data_len);
   encoded_data_length_ += encoded_data_length;
-  if (first_received_data_) {
-    // Some servers don't send a boundary token before the first chunk of
-    // data.  We handle this case anyway (Gecko does too).
-    first_received_data_ = false;
 
-    // Eat leading \r\n
-    int pos = PushOverLine(data_, 0);
-    if (pos)
-      data_ = data_.substr(pos);
-
-    if (data_.length() < boundary_.length() + 2) {
-      // We don't have enough data yet to make a boundary token.  Just wait
-      // until the next chunk of data arrives.
-      first_received_data_ = true;
-      return;
-    }
+  // Only a partial boundary or header is ever left over from the previous
+  // chunk, so usually there is nothing buffered and |data| can be parsed and
+  // passed on in place.
+  const char* buffer = data;
+  size_t length = data_len;
+  if (!data_.empty() || first_received_data_) {
+    data_.append(data, data_len);
+    if (first_received_data_) {
+      // Some servers don't send a boundary token before the first chunk of
+      // data.  We handle this case anyway (Gecko does too).
+      first_received_data_ = false;
+
+      // Eat leading \r\n
+      data_.erase(0, PushOverLine(data_.data(), data_.length(), 0));
+
+      if (data_.length() < boundary_.length() + 2) {
+        // We don't have enough data yet to make a boundary token.  Just wait
+        // until the next chunk of data arrives.
+        first_received_data_ = true;
+        return;
+      }
 
-    if (0 != data_.compare(0, boundary_.length(), boundary_)) {
-      data_ = boundary_ + "\n" + data_;
+      if (0 != data_.compare(0, boundary_.length(), boundary_))
+        data_.insert(0, boundary_ + "\n");
     }
+    buffer = data_.data();
+    length = data_.length();
   }
   DCHECK(!first_received_data_);
 
+  size_t consumed = ParseData(buffer, length);
+
+  // Keep what could not be handled yet for the next chunk.
+  if (stop_sending_)
+    data_.clear();
+  else if (buffer == data_.data())
+    data_.erase(0, consumed);
+  else
+    data_.assign(buffer + consumed, length - consumed);
+}
+
+size_t MultipartResponseDelegate::ParseData(const char* data, size_t length) {
+  size_t pos = 0;
+
   // Headers
   if (processing_headers_) {
     // Eat leading \r\n
-    int pos = PushOverLine(data_, 0);
-    if (pos)
-      data_ = data_.substr(pos);
+    pos += PushOverLine(data, length, 0);
 
-    if (ParseHeaders()) {
-      // Successfully parsed headers.
-      processing_headers_ = false;
-    } else {
+    size_t headers_length = ParseHeaders(data + pos, length - pos);
+    if (headers_length == std::string::npos) {
       // Get more data before trying again.
-      return;
+      return pos;
     }
+    // Successfully parsed headers.
+    pos += headers_length;
+    processing_headers_ = false;
   }
-  DCHECK(!processing_headers_);
 
   size_t boundary_pos;
-  while ((boundary_pos = FindBoundary()) != std::string::npos) {
+  while ((boundary_pos = FindBoundary(data + pos, length - pos)) !=
+         std::string::npos) {
+    boundary_pos += pos;
     if (client_) {
       // Strip out trailing \n\r characters in the buffer preceding the
       // boundary on the same lines as Firefox.
-      size_t data_length = boundary_pos;
-      if (boundary_pos > 0 && data_[boundary_pos - 1] == '\n') {
-        data_length--;
-        if (boundary_pos > 1 && data_[boundary_pos - 2] == '\r') {
-          data_length--;
-        }
+      size_t data_end = boundary_pos;
+      if (data_end > pos && data[data_end - 1] == '\n') {
+        data_end--;
+        if (data_end > pos && data[data_end - 1] == '\r')
+          data_end--;
       }
-      if (data_length > 0) {
+      if (data_end > pos) {
         // Send the last data chunk.
         client_->didReceiveData(loader_,
-                                data_.data(),
-                                static_cast<int>(data_length),
+                                data + pos,
+                                static_cast<int>(data_end - pos),
                                 encoded_data_length_);
         encoded_data_length_ = 0;
       }
     }
     size_t boundary_end_pos = boundary_pos + boundary_.length();
-    if (boundary_end_pos < data_.length() && '-' == data_[boundary_end_pos]) {
+    if (boundary_end_pos < length && '-' == data[boundary_end_pos]) {
       // This was the last boundary so we can stop processing.
       stop_sending_ = true;
-      data_.clear();
-      return;
+      return length;
     }
 
     // We can now throw out data up through the boundary
-    int offset = PushOverLine(data_, boundary_end_pos);
-    data_ = data_.substr(boundary_end_pos + offset);
+    pos = boundary_end_pos + PushOverLine(data, length, boundary_end_pos);
 
     // Ok, back to parsing headers
-    if (!ParseHeaders()) {
+    size_t headers_length = ParseHeaders(data + pos, length - pos);
+    if (headers_length == std::string::npos) {
       processing_headers_ = true;
-      break;
+      return pos;
     }
+    pos += headers_length;
   }
 
-  // At this point, we should send over any data we have, but keep enough data
-  // buffered to handle a boundary that may have been truncated.
-  if (!processing_headers_ && data_.length() > boundary_.length()) {
-    // If the last character is a new line character, go ahead and just send
-    // everything we have buffered.  This matches an optimization in Gecko.
-    int send_length = data_.length() - boundary_.length();
-    if (data_[data_.length() - 1] == '\n')
-      send_length = data_.length();
-    if (client_)
+  // At this point, we should send over any data we have, but keep back
+  // anything that could be the start of a boundary truncated by the end of
+  // the chunk.  If the data ends with a new line, nothing is kept back, which
+  // matches an optimization in Gecko.
+  size_t send_length = length - pos - BoundaryPrefixLength(data + pos,
+                                                           length - pos);
+  if (send_length > 0) {
+    if (client_) {
       client_->didReceiveData(loader_,
-                              data_.data(),
-                              send_length,
+                              data + pos,
+                              static_cast<int>(send_length),
                               encoded_data_length_);
-    data_ = data_.substr(send_length);
+    }
     encoded_data_length_ = 0;
   }
+  return pos + send_length;
 }
 
 void MultipartResponseDelegate::OnCompletedRequest() {
@@ -197,26 +224,30 @@ void MultipartResponseDelegate::OnCompletedRequest() {
   }
 }
 
-int MultipartResponseDelegate::PushOverLine(const std::string& data,
+int MultipartResponseDelegate::PushOverLine(const char* data,
+                                            size_t length,
                                             size_t pos) {
   int offset = 0;
-  if (pos < data.length() && (data[pos] == '\r' || data[pos] == '\n')) {
+  if (pos < length && (data[pos] == '\r' || data[pos] == '\n')) {
     ++offset;
-    if (pos + 1 < data.length() && data[pos + 1] == '\n')
+    if (pos + 1 < length && data[pos + 1] == '\n')
       ++offset;
   }
   return offset;
 }
 
-bool MultipartResponseDelegate::ParseHeaders() {
+size_t MultipartResponseDelegate::ParseHeaders(const char* data,
+                                               size_t length) {
   int line_feed_increment = 1;
 
   // Grab the headers being liberal about line endings.
+  const char* end = data + length;
   size_t line_start_pos = 0;
-  size_t line_end_pos = data_.find('\n');
+  const char* line_end = static_cast<const char*>(memchr(data, '\n', length));
+  size_t line_end_pos = line_end ? line_end - data : std::string::npos;
   while (line_end_pos != std::string::npos) {
     // Handle CRLF
-    if (line_end_pos > line_start_pos && data_[line_end_pos - 1] == '\r') {
+    if (line_end_pos > line_start_pos && data[line_end_pos - 1] == '\r') {
       line_feed_increment = 2;
       --line_end_pos;
     } else {
@@ -229,16 +260,17 @@ bool MultipartResponseDelegate::ParseHeaders() {
     }
     // Find the next header line.
     line_start_pos = line_end_pos + line_feed_increment;
-    line_end_pos = data_.find('\n', line_start_pos);
+    line_end = static_cast<const char*>(
+        memchr(data + line_start_pos, '\n', end - (data + line_start_pos)));
+    line_end_pos = line_end ? line_end - data : std::string::npos;
   }
   // Truncated in the middle of a header, stop parsing.
   if (line_end_pos == std::string::npos)
-    return false;
+    return std::string::npos;
 
   // Eat headers
   std::string headers("\n");
-  headers.append(data_, 0, line_end_pos);
-  data_ = data_.substr(line_end_pos);
+  headers.append(data, line_end_pos);
 
   // Create a WebURLResponse based on the original set of headers + the
   // replacement headers.  We only replace the same few headers that gecko
@@ -274,27 +306,108 @@ bool MultipartResponseDelegate::ParseHeaders() {
   if (client_)
     client_->didReceiveResponse(loader_, response);
 
-  return true;
+  return line_end_pos;
+}
+
+void MultipartResponseDelegate::SetBoundary(const std::string& boundary) {
+  boundary_ = boundary;
+
+  // Horspool's shift for each byte: how far the last byte of a window can be
+  // from the end of the boundary.  Shifts are capped to fit a byte, which
+  // only means very long boundaries advance more slowly.
+  size_t last = boundary_.length() - 1;
+  memset(boundary_shift_, static_cast<uint8>(std::min<size_t>(last + 1, 255)),
+         sizeof(boundary_shift_));
+  for (size_t i = 0; i < last; ++i) {
+    boundary_shift_[static_cast<uint8>(boundary_[i])] =
+        static_cast<uint8>(std::min<size_t>(last - i, 255));
+  }
 }
 
 // Boundaries are supposed to be preceeded with --, but it looks like gecko
 // doesn't require the dashes to exist.  See nsMultiMixedConv::FindToken.
-size_t MultipartResponseDelegate::FindBoundary() {
-  size_t boundary_pos = data_.find(boundary_);
+size_t MultipartResponseDelegate::FindBoundary(const char* data,
+                                               size_t length) {
+  const size_t boundary_length = boundary_.length();
+  if (length < boundary_length)
+    return std::string::npos;
+
+  const char* boundary = boundary_.data();
+  const char boundary_last = boundary[boundary_length - 1];
+  size_t boundary_pos = std::string::npos;
+  size_t pos = 0;
+
+#if defined(__SSE2__)
+  // Check 16 windows at a time for the boundary's first and last bytes, and
+  // compare the rest only where both match.  Unlike the skip loop below, this
+  // is not slowed down by data full of dashes.
+  const __m128i first = _mm_set1_epi8(boundary[0]);
+  const __m128i last = _mm_set1_epi8(boundary_last);
+  for (; pos + boundary_length - 1 + 16 <= length &&
+         boundary_pos == std::string::npos; pos += 16) {
+    __m128i window_starts = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(data + pos));
+    __m128i window_ends = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(data + pos + boundary_length - 1));
+    int mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(window_starts, first),
+                      _mm_cmpeq_epi8(window_ends, last)));
+    while (mask) {
+      int offset = __builtin_ctz(mask);
+      if (memcmp(data + pos + offset, boundary, boundary_length) == 0) {
+        boundary_pos = pos + offset;
+        break;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  // Boyer-Moore-Horspool: compare windows from their last byte, and skip
+  // ahead by the shift of that byte.  Data rarely contains the boundary's
+  // bytes, so most windows are skipped after a single comparison.
+  for (; boundary_pos == std::string::npos &&
+         pos <= length - boundary_length; ) {
+    char last = data[pos + boundary_length - 1];
+    if (last == boundary_last &&
+        memcmp(data + pos, boundary, boundary_length - 1) == 0) {
+      boundary_pos = pos;
+      break;
+    }
+    pos += boundary_shift_[static_cast<uint8>(last)];
+  }
+
   if (boundary_pos != std::string::npos) {
     // Back up over -- for backwards compat
     // TODO(tc): Don't we only want to do this once?  Gecko code doesn't seem
     // to care.
     if (boundary_pos >= 2) {
-      if ('-' == data_[boundary_pos - 1] && '-' == data_[boundary_pos - 2]) {
+      if ('-' == data[boundary_pos - 1] && '-' == data[boundary_pos - 2]) {
         boundary_pos -= 2;
-        boundary_ = "--" + boundary_;
+        SetBoundary("--" + boundary_);
       }
     }
   }
   return boundary_pos;
 }
 
+size_t MultipartResponseDelegate::BoundaryPrefixLength(const char* data,
+                                                       size_t length) {
+  // Find the longest end of |data| that the boundary starts with.  Candidates
+  // have to begin with the boundary's first byte, which rules out nearly all
+  // of them with a single comparison.
+  size_t max_prefix = std::min(length, boundary_.length() - 1);
+  for (size_t prefix = max_prefix; prefix > 0; --prefix) {
+    const char* start = data + length - prefix;
+    if (*start == boundary_[0] && memcmp(start, boundary_.data(), prefix) == 0) {
+      // Also keep the two bytes before it, which may be a line break that is
+      // stripped or dashes that are backed over once the boundary is found.
+      return std::min(length, prefix + 2);
+    }
+  }
+  return 0;
+}
+
 bool MultipartResponseDelegate::ReadMultipartBoundary(
     const WebURLResponse& response,
     std::string* multipart_boundary) {
@@ -107,29 +107,46 @@ class MultipartResponseDelegate {
   // starting point for each parts response.
   WebKit::WebURLResponse original_response_;
 
+  // Parses |data|, sending responses and data to the client.  Returns the
+  // number of bytes consumed; the rest has to be passed in again, followed by
+  // more data.
+  size_t ParseData(const char* data, size_t length);
+
   // Checks to see if data[pos] character is a line break; handles crlf, lflf,
   // lf, or cr. Returns the number of characters to skip over (0, 1 or 2).
-  int PushOverLine(const std::string& data, size_t pos);
+  int PushOverLine(const char* data, size_t length, size_t pos);
+
+  // Tries to parse http headers from the start of |data|.  Returns the length
+  // of the headers if it succeeds and sends a didReceiveResponse to m_client.
+  // Returns std::string::npos if the header is incomplete (in which case we
+  // just wait for more data).
+  size_t ParseHeaders(const char* data, size_t length);
 
-  // Tries to parse http headers from the start of data_.  Returns true if it
-  // succeeds and sends a didReceiveResponse to m_client.  Returns false if
-  // the header is incomplete (in which case we just wait for more data).
-  bool ParseHeaders();
+  // Sets |boundary_| and the search table derived from it.
+  void SetBoundary(const std::string& boundary);
 
-  // Find the next boundary in data_.  Returns std::string::npos if there's no
-  // full token.
-  size_t FindBoundary();
+  // Find the next boundary in |data|.  Returns std::string::npos if there's
+  // no full token.
+  size_t FindBoundary(const char* data, size_t length);
+
+  // Returns how many bytes at the end of |data| have to be kept back because
+  // they could be the start of a boundary.
+  size_t BoundaryPrefixLength(const char* data, size_t length);
 
   // Transferred data size accumulated between client callbacks.
   int encoded_data_length_;
 
   // A temporary buffer to hold data between reads for multipart data that
-  // gets split in the middle of a header.
+  // gets split in the middle of a header or boundary.
   std::string data_;
 
   // Multipart boundary token
   std::string boundary_;
 
+  // For each byte value, how far FindBoundary() can skip ahead when it ends
+  // a window that does not match.
+  uint8 boundary_shift_[256];
+
   // true until we get our first on received data call
   bool first_received_data_;
 
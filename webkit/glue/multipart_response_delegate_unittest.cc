@@ -2,9 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/time.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebString.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebURL.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebURLLoaderClient.h"
@@ -32,12 +35,26 @@ class MultipartResponseDelegateTester {
   }
 
   int PushOverLine(const std::string& data, size_t pos) {
-    return delegate_->PushOverLine(data, pos);
+    return delegate_->PushOverLine(data.data(), data.length(), pos);
   }
 
-  bool ParseHeaders() { return delegate_->ParseHeaders(); }
-  size_t FindBoundary() { return delegate_->FindBoundary(); }
-  std::string& boundary() { return delegate_->boundary_; }
+  // Parses headers from data(), and removes them from it.
+  bool ParseHeaders() {
+    std::string& data = delegate_->data_;
+    size_t headers_length = delegate_->ParseHeaders(data.data(), data.length());
+    if (headers_length == std::string::npos)
+      return false;
+    data.erase(0, headers_length);
+    return true;
+  }
+
+  size_t FindBoundary() {
+    return delegate_->FindBoundary(delegate_->data_.data(),
+                                   delegate_->data_.length());
+  }
+  void set_boundary(const std::string& boundary) {
+    delegate_->SetBoundary(boundary);
+  }
   std::string& data() { return delegate_->data_; }
 
  private:
@@ -65,6 +82,7 @@ class MockWebURLLoaderClient : public WebURLLoaderClient {
     ++received_response_;
     response_ = response;
     data_.clear();
+    parts_.push_back(string());
   }
   virtual void didReceiveData(
       WebKit::WebURLLoader* loader,
@@ -73,6 +91,8 @@ class MockWebURLLoaderClient : public WebURLLoaderClient {
       int encoded_data_length) {
     ++received_data_;
     data_.append(data, data_length);
+    if (!parts_.empty())
+      parts_.back().append(data, data_length);
     total_encoded_data_length_ += encoded_data_length;
   }
   virtual void didFinishLoading(WebURLLoader*, double finishTime) {}
@@ -81,6 +101,7 @@ class MockWebURLLoaderClient : public WebURLLoaderClient {
   void Reset() {
     received_response_ = received_data_ = total_encoded_data_length_ = 0;
     data_.clear();
+    parts_.clear();
     response_.reset();
   }
 
@@ -90,6 +111,8 @@ class MockWebURLLoaderClient : public WebURLLoaderClient {
 
   int received_response_, received_data_, total_encoded_data_length_;
   string data_;
+  // The data of each part received so far.
+  std::vector<string> parts_;
   WebURLResponse response_;
 };
 
@@ -194,7 +217,7 @@ TEST(MultipartResponseTest, Functions) {
     { "bound", "--boundbound", 0 },
   };
   for (size_t i = 0; i < ARRAYSIZE_UNSAFE(boundary_tests); ++i) {
-    delegate_tester.boundary().assign(boundary_tests[i].boundary);
+    delegate_tester.set_boundary(boundary_tests[i].boundary);
     delegate_tester.data().assign(boundary_tests[i].data);
     EXPECT_EQ(boundary_tests[i].position,
               delegate_tester.FindBoundary());
@@ -369,7 +392,7 @@ TEST(MultipartResponseTest, BreakInBoundary) {
   // Break in first and second
   const TestChunk bound2[] = {
     { 0, 4, 0, 0, "", 0 },
-    { 4, 55, 1, 1, "datadatadatadat", 55 },
+    { 4, 55, 1, 1, "datadatadatadatada", 55 },
     { 55, 65, 1, 2, "datadatadatadatadata", 65 },
     { 65, 110, 2, 3, "foofoofoofoofoo", 110 },
   };
@@ -378,7 +401,7 @@ TEST(MultipartResponseTest, BreakInBoundary) {
 
   // Break in second only
   const TestChunk bound3[] = {
-    { 0, 55, 1, 1, "datadatadatadat", 55 },
+    { 0, 55, 1, 1, "datadatadatadatada", 55 },
     { 55, 110, 2, 3, "foofoofoofoofoo", 110 },
   };
   VariousChunkSizesTest(bound3, arraysize(bound3),
@@ -389,11 +412,11 @@ TEST(MultipartResponseTest, BreakInHeaders) {
   // Break in first header
   const TestChunk header1[] = {
     { 0, 10, 0, 0, "", 0 },
-    { 10, 35, 1, 0, "", 0 },
-    { 35, 110, 2, 2, "foofoofoofoofoo", 110 },
+    { 10, 35, 1, 1, "da", 35 },
+    { 35, 110, 2, 3, "foofoofoofoofoo", 110 },
   };
   VariousChunkSizesTest(header1, arraysize(header1),
-                        2, 2, "foofoofoofoofoo", 110);
+                        2, 3, "foofoofoofoofoo", 110);
 
   // Break in both headers
   const TestChunk header2[] = {
@@ -424,21 +447,21 @@ TEST(MultipartResponseTest, BreakInData) {
 
   // breaks in data segment
   const TestChunk data2[] = {
-    { 0, 35, 1, 0, "", 0 },
-    { 35, 65, 1, 1, "datadatadatadatadata", 65 },
-    { 65, 90, 2, 1, "", 65 },
-    { 90, 110, 2, 2, "foofoofoofoofoo", 110 },
+    { 0, 35, 1, 1, "da", 35 },
+    { 35, 65, 1, 2, "datadatadatadatadata", 65 },
+    { 65, 90, 2, 3, "foof", 90 },
+    { 90, 110, 2, 4, "foofoofoofoofoo", 110 },
   };
   VariousChunkSizesTest(data2, arraysize(data2),
-                        2, 2, "foofoofoofoofoo", 110);
+                        2, 4, "foofoofoofoofoo", 110);
 
   // Incomplete send
   const TestChunk data3[] = {
-    { 0, 35, 1, 0, "", 0 },
-    { 35, 90, 2, 1, "", 90 },
+    { 0, 35, 1, 1, "da", 35 },
+    { 35, 90, 2, 3, "foof", 90 },
   };
   VariousChunkSizesTest(data3, arraysize(data3),
-                        2, 2, "foof", 90);
+                        2, 3, "foof", 90);
 }
 
 TEST(MultipartResponseTest, SmallChunk) {
@@ -669,4 +692,112 @@ TEST(MultipartResponseTest, MultipartPayloadSet) {
   EXPECT_TRUE(client.response_.isMultipartPayload());
 }
 
+// Makes a multipart stream of |num_parts| parts of |part_size| bytes, which
+// contain dashes and line breaks but not the boundary "--bound".
+string MakeMultipartStream(int num_parts, size_t part_size,
+                           std::vector<string>* parts) {
+  string stream;
+  uint32 seed = 1;
+  for (int i = 0; i < num_parts; ++i) {
+    string part(part_size, '\0');
+    for (size_t j = 0; j < part_size; ++j) {
+      seed = seed * 1103515245 + 12345;
+      part[j] = static_cast<char>(seed >> 24);
+      // Throw in some near misses.
+      if (j % 97 == 0)
+        part[j] = '-';
+    }
+    part[part_size - 1] = '.';
+    stream.append("--bound\r\nContent-type: image/jpeg\r\n\r\n");
+    stream.append(part);
+    stream.append("\r\n");
+    parts->push_back(part);
+  }
+  stream.append("--bound--\r\n");
+  return stream;
+}
+
+// Checks that every chunking of the data gives the same parts.  The line
+// break before a boundary is only stripped if it arrives with the boundary,
+// so it may be left at the end of a part.
+TEST(MultipartResponseTest, ChunkSizes) {
+  WebURLResponse response;
+  response.initialize();
+  response.setMIMEType("multipart/x-mixed-replace");
+
+  std::vector<string> parts;
+  const string data = MakeMultipartStream(4, 300, &parts);
+  for (size_t chunk_size = 1; chunk_size < 64; ++chunk_size) {
+    MockWebURLLoaderClient client;
+    MultipartResponseDelegate delegate(&client, NULL, response, "bound");
+    for (size_t pos = 0; pos < data.length(); pos += chunk_size) {
+      size_t length = std::min(chunk_size, data.length() - pos);
+      delegate.OnReceivedData(data.data() + pos,
+                              static_cast<int>(length),
+                              static_cast<int>(length));
+    }
+    delegate.OnCompletedRequest();
+    ASSERT_EQ(parts.size(), client.parts_.size()) << chunk_size;
+    for (size_t i = 0; i < parts.size(); ++i) {
+      const string& part = client.parts_[i];
+      ASSERT_GE(part.length(), parts[i].length());
+      EXPECT_TRUE(part.compare(0, parts[i].length(), parts[i]) == 0)
+          << chunk_size << " " << i;
+      EXPECT_EQ(0u, string("\r\n").find(part.substr(parts[i].length())))
+          << chunk_size << " " << i;
+    }
+  }
+}
+
+// Only counts what it receives, so that Throughput measures the parsing.
+class CountingWebURLLoaderClient : public MockWebURLLoaderClient {
+ public:
+  CountingWebURLLoaderClient() : received_bytes_(0) {}
+
+  virtual void didReceiveResponse(WebURLLoader* loader,
+                                  const WebURLResponse& response) {
+    ++received_response_;
+  }
+  virtual void didReceiveData(
+      WebKit::WebURLLoader* loader,
+      const char* data,
+      int data_length,
+      int encoded_data_length) {
+    ++received_data_;
+    received_bytes_ += data_length;
+  }
+
+  size_t received_bytes_;
+};
+
+// Measures parsing speed on a camera-like stream.
+// Run with --v=1 to see the results.
+TEST(MultipartResponseTest, Throughput) {
+  WebURLResponse response;
+  response.initialize();
+  response.setMIMEType("multipart/x-mixed-replace");
+
+  std::vector<string> parts;
+  const string data = MakeMultipartStream(64, 64 * 1024, &parts);
+  const size_t kChunkSize = 32 * 1024;
+  const int kIterations = 20;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    CountingWebURLLoaderClient client;
+    MultipartResponseDelegate delegate(&client, NULL, response, "bound");
+    for (size_t pos = 0; pos < data.length(); pos += kChunkSize) {
+      size_t length = std::min(kChunkSize, data.length() - pos);
+      delegate.OnReceivedData(data.data() + pos,
+                              static_cast<int>(length),
+                              static_cast<int>(length));
+    }
+    ASSERT_EQ(static_cast<int>(parts.size()), client.received_response_);
+    EXPECT_EQ(parts.size() * parts[0].length(), client.received_bytes_);
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  VLOG(1) << "Parsed " << data.length() * kIterations / (1024 * 1024)
+          << " MB in " << elapsed.InMilliseconds() << " ms";
+}
+
 }  // namespace